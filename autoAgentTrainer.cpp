@@ -13,7 +13,8 @@ dkirkpatrick2001@my.fit.edu
 
 *Note, this program is not generally called on it's own,
 I use it with a training script to handle the randomized training.
-This script is called trainScript
+This script is called trainScript, and has aiTrainer run all the
+randomized cycles in one process (see -cycles).
 *******************************************************************/
 
 
@@ -21,10 +22,18 @@ This script is called trainScript
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstring>
+#include <vector>
 using namespace std;
 
 #include <signal.h>
+#include <dirent.h>
+#include <algorithm>
 #include "neuralNet.h"
+#include "parallelTrainer.h"
+#include "hogwildTrainer.h"
+#include "epochTrainer.h"
+#include "trainingSet.h"
 #include "math.h"
 #include "timer.h"
 #include "mathVector.h"
@@ -50,10 +59,82 @@ string brainFilename;
 #define OUTPUTNEURONS 1
 
 // Number of neurons in
-// the hidden layer is
+// each hidden layer is
 // passed in as a commandline
-// argument
-int HIDDENNEURONS;
+// argument, e.g. "8" for one
+// hidden layer or "8,4" for two
+vector<int> hiddenLayerSizes;
+
+
+// Number of samples per weight update when
+// training in mini-batch mode. Zero means the
+// original one sample at a time training.
+int batchSize = 0;
+
+
+// Number of threads to train on. Zero means
+// the original single threaded training, any
+// other count trains in mini-batches split
+// across that many threads, with the same
+// result whatever the count.
+int numThreads = 0;
+
+
+// Number of threads to train on asynchronously,
+// without locks. Zero means not to.
+int hogwildThreads = 0;
+
+
+// Number of training cycles to run in one go,
+// instead of trainScript starting aiTrainer once
+// per cycle. Zero means a single ordinary run.
+// With cycles, the training data set argument is
+// a directory of data sets, one picked at random
+// for each cycle.
+int scheduleCycles = 0;
+
+
+// Most epochs to train for with the epoch
+// trainer. Zero means not to use it.
+int maxEpochs = 0;
+
+
+// Share of the samples the epoch trainer holds
+// back to score the brain on, and how many epochs
+// without that score improving it stops after.
+double validationFraction = 0.1;
+int    patience		  = 10;
+
+
+// How many cycles to go between saving the brain
+// while running cycles. Zero means only at the end.
+int checkpointInterval = 0;
+
+
+// Seed for everything random in a run: the
+// weights of a new brain and the data sets
+// -cycles picks. The same seed gives the
+// same brain. Taken from the clock unless
+// given on the command line.
+unsigned long long randomSeed = time(NULL);
+
+
+// Train in single rather than double
+// precision. The brain file is the same
+// either way.
+bool useFloat = false;
+
+
+// How the sigmoid is evaluated while training.
+// Exact unless asked otherwise on the command line.
+SigmoidMode sigmoidMode = SIGMOID_EXACT;
+
+
+// How the weights are updated, and how fast.
+// Zero means the usual rate for the optimizer:
+// 0.2 for SGD, 0.001 for RMSProp and Adam.
+OptimizerMode optimizerMode = OPTIMIZER_SGD;
+double	      learningRate  = 0;
 
 
 // The structure of the 
@@ -81,7 +162,27 @@ void printUsageInfo()
 {
   cout<<"Usage: "<<endl<<endl;
   cout<<"For training:"<<endl;
-  cout<<"aiTrainer [trainingDataSetFilename] [numHiddenNodes] [brainFilename]"<<endl;
+  cout<<"aiTrainer [trainingDataSetFilename] [numHiddenNodes] [brainFilename] [options]"<<endl<<endl;
+  cout<<"numHiddenNodes can be a comma separated list, one size per hidden layer."<<endl<<endl;
+  cout<<"Options:"<<endl;
+  cout<<"  -batch N    Train in mini-batches of N samples, one weight update per batch"<<endl;
+  cout<<"  -threads N  Train mini-batches on N threads (the whole data set per batch"<<endl;
+  cout<<"              unless -batch is given). Any N gives the same result."<<endl;
+  cout<<"  -hogwild N  Train online on N threads sharing the weights without locks,"<<endl;
+  cout<<"              and print each thread's samples/sec (N = 1 for a baseline)"<<endl;
+  cout<<"  -cycles N   Run N trainScript style cycles in this one process, each on a"<<endl;
+  cout<<"              random data set from the directory given as trainingDataSetFilename"<<endl;
+  cout<<"  -checkpoint N  With -cycles, save the brain every N cycles as well as at the end"<<endl;
+  cout<<"  -epochs N   Train for up to N epochs, each sample once per epoch in a random"<<endl;
+  cout<<"              order, stopping early once the validation error stops improving"<<endl;
+  cout<<"              (with -batch and -threads, in mini-batches)"<<endl;
+  cout<<"  -validation F  With -epochs, hold back fraction F of the samples (default 0.1)"<<endl;
+  cout<<"  -patience N    With -epochs, stop after N epochs without improving (default 10)"<<endl;
+  cout<<"  -seed N     Seed the random weights and data set picks with N, for a repeatable run"<<endl;
+  cout<<"  -float      Train in single precision instead of double"<<endl;
+  cout<<"  -sigmoid M  Evaluate the sigmoid as M: exact (default), table or rational"<<endl;
+  cout<<"  -optimizer M  Update the weights with M: sgd (default, with momentum), rmsprop or adam"<<endl;
+  cout<<"  -rate R     Learning rate (default 0.2 for sgd, 0.001 for rmsprop and adam)"<<endl;
 }
 
 
@@ -89,76 +190,159 @@ void printUsageInfo()
 
 
 
-// Use the training data set to create or
-// modify a neural network. 
-void trainBrain()
+// Turns a comma separated list of hidden layer
+// sizes into one entry per hidden layer
+vector<int> parseLayerSizes(const char* list)
 {
-  bool   existingBrain = false;
-  int    i             = 0;
-  double error         = 1;
-  int    counter       = 0;
-  int    lineCounter   = 0;
+  vector<int> sizes;
+  const char* next = list;
+
+  while (*next != '\0')
+    {
+      sizes.push_back(atoi(next));
+
+      next = strchr(next, ',');
+      if (next == NULL)
+	break;
+      next++;
+    }
+
+  return sizes;
+}
 
-  // The neural network to use 
-  // for training
-  NeuralNetwork trainerBrain;
 
-  ifstream trainingData(trainingDataSetFilename.c_str(), ios::in);
+
+
+
+
+// Opens the brain file if it exists, otherwise
+// starts a brand new neural net, and sets up
+// the training parameters either way.
+template <typename Real>
+void loadTrainerBrain(NeuralNetworkT<Real>& trainerBrain)
+{
   ifstream testBrainFile;
 
   testBrainFile.open(brainFilename.c_str(), ios::in);
   testBrainFile.close();
 
-  
   if(testBrainFile.fail())
     {
       cout<<"Starting a new neural net."<<endl;
-      existingBrain = false;
+
+      // Initialize the new neural network
+      vector<int> layerSizes;
+
+      layerSizes.push_back(INPUTNEURONS);
+      layerSizes.insert(layerSizes.end(), hiddenLayerSizes.begin(), hiddenLayerSizes.end());
+      layerSizes.push_back(OUTPUTNEURONS);
+
+      cout<<"Random seed: "<<randomSeed<<endl;
+
+      trainerBrain.SetRandomSeed(randomSeed);
+      trainerBrain.Initialize(layerSizes.size(), &layerSizes[0]);
     }
   else
     {
       cout<<"Modifying an existing neural net."<<endl;
-      existingBrain = true;
-    }
-
-  if (!trainingData)
-    {
-      cout<<"Failed to open "<<trainingDataSetFilename<<endl;
-      exit(1);
-    }
-
-  brainInputs  neuralInputData;
-  brainOutputs neuralOutputData;
 
-  if (existingBrain)
-    {
       // Read in the existing neural net
       trainerBrain.ReadData(brainFilename);
     }
+
+  if (learningRate > 0)
+    trainerBrain.SetLearningRate(learningRate);
+  else if (optimizerMode == OPTIMIZER_SGD)
+    trainerBrain.SetLearningRate(0.2);
   else
-    {
-      // Initialize the new neural network
-      trainerBrain.Initialize(INPUTNEURONS,
-			      HIDDENNEURONS,
-			      OUTPUTNEURONS);
-    }
+    trainerBrain.SetLearningRate(0.001);
 
-  trainerBrain.SetLearningRate(0.2);
+  trainerBrain.SetOptimizer(optimizerMode);
 
   // Use momentum, can help sometimes avoid
   // local minima and maxima
   trainerBrain.SetMomentum(true, 0.9);
 
-  while (!trainingData.eof())
+  trainerBrain.SetSigmoidMode(sigmoidMode);
+}
+
+
+
+
+
+
+// Loads a training data set, either a binary one packed by
+// datasetPacker or a text one, and makes sure it's the right
+// shape for the brain, with at least one sample in it.
+template <typename Real>
+void loadTrainingSet(string filename, TrainingSetT<Real>& trainingSet)
+{
+  if (IsBinaryTrainingSet(filename))
+    {
+      trainingSet.ReadData(filename);
+    }
+  else
+    {
+      trainingSet.Initialize(INPUTNEURONS, OUTPUTNEURONS);
+      trainingSet.ImportText(filename);
+    }
+
+  if ((trainingSet.NumberOfInputs != INPUTNEURONS) ||
+      (trainingSet.NumberOfOutputs != OUTPUTNEURONS))
     {
-      // Read in inputs from training data
-      trainingData>>neuralInputData.agentPosition;
-      trainingData>>neuralInputData.boxColor;
-      trainingData>>neuralInputData.boxAngle;
-      trainingData>>neuralInputData.isThereABox;
+      cout<<filename<<" has samples of "<<trainingSet.NumberOfInputs<<" inputs and "
+	  <<trainingSet.NumberOfOutputs<<" outputs, not "<<INPUTNEURONS<<" and "
+	  <<OUTPUTNEURONS<<endl;
+      exit(1);
+    }
 
-      // Read in desired outputs from training data
-      trainingData>>neuralOutputData.movement;
+  if (trainingSet.NumberOfSamples == 0)
+    {
+      cout<<"No samples found in "<<filename<<endl;
+      exit(1);
+    }
+}
+
+
+
+
+
+
+// Saves the brain, in the binary format if that's
+// what it was read from, otherwise as text
+template <typename Real>
+void saveTrainerBrain(NeuralNetworkT<Real>& trainerBrain)
+{
+  if (IsBinaryBrainFile(brainFilename))
+    trainerBrain.DumpBinary(brainFilename);
+  else
+    trainerBrain.DumpData(brainFilename);
+}
+
+
+
+
+
+
+// One sample at a time training on numSamples samples,
+// the way trainBrain has always done it: each sample is
+// trained on until the error drops below the threshold,
+// or the iteration count runs out. Returns how many
+// iterations that took, over all the samples.
+template <typename Real>
+long trainOnline(NeuralNetworkT<Real>& trainerBrain,
+		 const Real* inputs, const Real* desired, long numSamples)
+{
+  double error;
+  int    counter;
+  long   iterations = 0;
+  long   s;
+  int    i;
+
+  for (s = 0; s < numSamples; s++)
+    {
+      error   = 1;
+      counter = 0;
 
       while ((error > 0.05) && (counter < 50000))
 	{
@@ -166,30 +350,334 @@ void trainBrain()
 	  counter++;
 
 	  // Set the neural network inputs to training data
-	  trainerBrain.SetInput(0, neuralInputData.agentPosition); 
-	  trainerBrain.SetInput(1, neuralInputData.boxColor); 
-	  trainerBrain.SetInput(2, neuralInputData.boxAngle); 
-	  trainerBrain.SetInput(3, neuralInputData.isThereABox); 
+	  for (i = 0; i < INPUTNEURONS; i++)
+	    {
+	      trainerBrain.SetInput(i, inputs[s * INPUTNEURONS + i]);
+	    }
 
 	  // Show the neural network the desired output
-	  trainerBrain.SetDesiredOutput(0, neuralOutputData.movement);
+	  for (i = 0; i < OUTPUTNEURONS; i++)
+	    {
+	      trainerBrain.SetDesiredOutput(i, desired[s * OUTPUTNEURONS + i]);
+	    }
 
 	  // And now for the learning part
 	  trainerBrain.FeedForward();
 	  error += trainerBrain.CalculateError();
 	  trainerBrain.BackPropagate();
-	  lineCounter++;
 	}
+
+      iterations += counter;
+    }
+
+  return iterations;
+}
+
+
+
+
+
+
+// Use the training data set to create or
+// modify a neural network. 
+template <typename Real>
+void trainBrain()
+{
+  // The neural network to use 
+  // for training
+  NeuralNetworkT<Real> trainerBrain;
+  TrainingSetT<Real>   trainingSet;
+
+  loadTrainingSet(trainingDataSetFilename, trainingSet);
+
+  loadTrainerBrain(trainerBrain);
+
+  trainOnline(trainerBrain, trainingSet.Inputs, trainingSet.Desired,
+	      trainingSet.NumberOfSamples);
+
+  saveTrainerBrain(trainerBrain);
+}
+
+
+
+
+
+
+// Mini-batch version of trainBrain. Every sample in the training
+// data set is read up front, then the whole set is run through
+// the network batchSize samples at a time, with one weight update
+// per batch, until the mean error drops below the same threshold
+// trainBrain uses (or we give up after as many passes as trainBrain
+// allows iterations). With numThreads set, each batch is split
+// across that many threads by a ParallelTrainerT.
+template <typename Real>
+void trainBrainBatched()
+{
+  double error   = 1;
+  int    counter = 0;
+  int    first, rows, numSamples;
+
+  NeuralNetworkT<Real>	 trainerBrain;
+  ParallelTrainerT<Real> parallelTrainer;
+  TrainingSetT<Real>	 trainingSet;
+
+  loadTrainingSet(trainingDataSetFilename, trainingSet);
+  numSamples = trainingSet.NumberOfSamples;
+
+  if (batchSize <= 0)
+    {
+      batchSize = numSamples;
+    }
+
+  cout<<"Training on "<<numSamples<<" samples in batches of "<<batchSize;
+  if (numThreads > 0)
+    {
+      cout<<" on "<<numThreads<<" threads";
+    }
+  cout<<endl;
+
+  loadTrainerBrain(trainerBrain);
+
+  if (numThreads > 0)
+    {
+      parallelTrainer.Initialize(&trainerBrain, numThreads, batchSize);
+    }
+
+  while ((error > 0.05) && (counter < 50000))
+    {
+      error = 0.0;
+      counter++;
+
+      for (first = 0; first < numSamples; first += batchSize)
+	{
+	  rows = numSamples - first;
+	  if (rows > batchSize)
+	    {
+	      rows = batchSize;
+	    }
+
+	  if (numThreads > 0)
+	    {
+	      error += rows * parallelTrainer.BackPropagateBatch(trainingSet.Inputs + first * INPUTNEURONS,
+								 trainingSet.Desired + first * OUTPUTNEURONS,
+								 rows);
+	    }
+	  else
+	    {
+	      error += rows * trainerBrain.BackPropagateBatch(trainingSet.Inputs + first * INPUTNEURONS,
+							      trainingSet.Desired + first * OUTPUTNEURONS,
+							      rows);
+	    }
+	}
+
+      error /= numSamples;
+    }
+
+  cout<<"Finished after "<<counter<<" passes, error "<<error<<endl;
+
+  saveTrainerBrain(trainerBrain);
+}
+
+
+
+
+
+// Asynchronous version of trainBrain. hogwildThreads threads
+// each train on their own share of the samples, one at a time,
+// updating the one shared network without any locking, until
+// the mean error drops below the usual threshold. How fast each
+// thread went is printed at the end: -hogwild 1 is the single
+// threaded baseline to measure the scaling against.
+template <typename Real>
+void trainBrainHogwild()
+{
+  double error   = 1;
+  int    counter = 0;
+  int    t, numSamples;
+  double total	 = 0;
+
+  NeuralNetworkT<Real>	trainerBrain;
+  HogwildTrainerT<Real> hogwildTrainer;
+  TrainingSetT<Real>	trainingSet;
+
+  loadTrainingSet(trainingDataSetFilename, trainingSet);
+  numSamples = trainingSet.NumberOfSamples;
+
+  cout<<"Training on "<<numSamples<<" samples on "<<hogwildThreads<<" asynchronous threads"<<endl;
+
+  loadTrainerBrain(trainerBrain);
+  hogwildTrainer.Initialize(&trainerBrain, hogwildThreads);
+
+  while ((error > 0.05) && (counter < 50000))
+    {
+      counter++;
+      error = hogwildTrainer.TrainPass(trainingSet.Inputs, trainingSet.Desired, numSamples);
+    }
+
+  cout<<"Finished after "<<counter<<" passes, error "<<error<<endl;
+
+  for (t = 0; t < hogwildTrainer.NumberOfThreads; t++)
+    {
+      cout<<"Thread "<<t<<": "<<hogwildTrainer.Threads[t].Samples<<" samples, "
+	  <<hogwildTrainer.SamplesPerSecond(t)<<" samples/sec"<<endl;
+      total += hogwildTrainer.SamplesPerSecond(t);
+    }
+  cout<<"All threads: "<<total<<" samples/sec"<<endl;
+
+  saveTrainerBrain(trainerBrain);
+}
+
+
+
+
+
+// Trains the brain in epochs with an EpochTrainerT: every epoch
+// goes through the samples not held back for validation once, in
+// a new random order, and then scores the brain on the held back
+// ones. Stops after maxEpochs, or sooner once the validation error
+// has stopped improving, and saves the best scoring brain.
+template <typename Real>
+void trainBrainEpochs()
+{
+  NeuralNetworkT<Real>	trainerBrain;
+  EpochTrainerT<Real>	epochTrainer;
+  TrainingSetT<Real>	trainingSet;
+  bool			more;
+
+  loadTrainingSet(trainingDataSetFilename, trainingSet);
+  loadTrainerBrain(trainerBrain);
+
+  epochTrainer.SetBatching(batchSize, numThreads);
+  epochTrainer.SetStopping(maxEpochs, patience);
+  epochTrainer.Initialize(&trainerBrain, &trainingSet, validationFraction, randomSeed);
+
+  cout<<"Training on "<<epochTrainer.NumberOfTrainingSamples<<" samples, validating on "
+      <<epochTrainer.NumberOfValidationSamples;
+  if (batchSize > 0)
+    {
+      cout<<", in batches of "<<batchSize;
+    }
+  if ((batchSize > 0) && (numThreads > 0))
+    {
+      cout<<" on "<<numThreads<<" threads";
+    }
+  cout<<endl;
+
+  do
+    {
+      more = epochTrainer.NextEpoch();
+
+      cout<<"Epoch "<<epochTrainer.Epoch<<": training error "<<epochTrainer.TrainingError
+	  <<", validation error "<<epochTrainer.ValidationError<<endl;
+    }
+  while (more);
+
+  epochTrainer.RestoreBest();
+
+  cout<<"Finished after "<<epochTrainer.Epoch<<" epochs, best validation error "
+      <<epochTrainer.BestError<<" at epoch "<<epochTrainer.BestEpoch<<endl;
+  cout<<"Processed "<<epochTrainer.SamplesProcessed<<" samples in "<<epochTrainer.Seconds
+      <<" seconds ("<<epochTrainer.SamplesProcessed / epochTrainer.Seconds<<" samples/sec)"<<endl;
+
+  saveTrainerBrain(trainerBrain);
+}
+
+
+
+
+
+
+// Does what trainScript does, without starting a process for
+// every cycle. Every data set in the trainingDataSetFilename
+// directory is read, and the brain loaded, just once. Then each
+// of the scheduleCycles cycles trains the brain online on a data
+// set picked at random, exactly as one aiTrainer run would. The
+// momentum is reset between cycles, since each run used to start
+// afresh from the brain file. The brain is only saved every
+// checkpointInterval cycles, if set, and at the end.
+template <typename Real>
+void trainBrainCycles()
+{
+  int	 cycle, set, percent;
+  int	 lastPercent = -1;
+  PhiloxRandom	 sampler(randomSeed, RANDOM_STREAM_SAMPLING);
+  long	 iterations  = 0;
+  Timer	 timer;
+  DIR*	 directory;
+  struct dirent* entry;
+
+  NeuralNetworkT<Real>	 trainerBrain;
+  vector<string>	 setFilenames;
+  vector< TrainingSetT<Real> > trainingSets;
+
+  directory = opendir(trainingDataSetFilename.c_str());
+  if (directory == NULL)
+    {
+      cout<<"Failed to open the data set directory "<<trainingDataSetFilename<<endl;
+      exit(1);
+    }
+
+  while ((entry = readdir(directory)) != NULL)
+    {
+      if (entry->d_name[0] != '.')
+	{
+	  setFilenames.push_back(trainingDataSetFilename + "/" + entry->d_name);
+	}
+    }
+  closedir(directory);
+
+  if (setFilenames.empty())
+    {
+      cout<<"No data sets found in "<<trainingDataSetFilename<<endl;
+      exit(1);
     }
 
-  trainerBrain.DumpData(brainFilename);
-  trainingData.close();
+  // Same order every time, whatever order the directory lists them in
+  sort(setFilenames.begin(), setFilenames.end());
+
+  trainingSets.resize(setFilenames.size());
+
+  for (set = 0; set < (int) setFilenames.size(); set++)
+    {
+      loadTrainingSet(setFilenames[set], trainingSets[set]);
+    }
+
+  cout<<"Read "<<setFilenames.size()<<" data sets, running "<<scheduleCycles<<" cycles"<<endl;
+
+  loadTrainerBrain(trainerBrain);
+
+  for (cycle = 1; cycle <= scheduleCycles; cycle++)
+    {
+      set = sampler.NextBelow(setFilenames.size());
+
+      trainerBrain.ResetMomentum();
+      iterations += trainOnline(trainerBrain, trainingSets[set].Inputs, trainingSets[set].Desired,
+				trainingSets[set].NumberOfSamples);
+
+      if ((checkpointInterval > 0) && (cycle % checkpointInterval == 0) && (cycle < scheduleCycles))
+	{
+	  saveTrainerBrain(trainerBrain);
+	}
+
+      percent = (int) ((long) cycle * 100 / scheduleCycles);
+      if (percent != lastPercent)
+	{
+	  cout<<"\rCycle "<<cycle<<" of "<<scheduleCycles<<", "<<percent<<"% done"<<flush;
+	  lastPercent = percent;
+	}
+    }
+
+  saveTrainerBrain(trainerBrain);
+
+  cout<<endl<<"Finished "<<scheduleCycles<<" cycles ("<<iterations<<" training iterations) in "
+      <<timer.total()<<" seconds"<<endl;
 }
 
 
 
 
 
+
 // The main function, for training 
 // neural nets
 int main(int argc, char** argv)
@@ -203,15 +691,132 @@ int main(int argc, char** argv)
     }
 
   trainingDataSetFilename = argv[1];
-  HIDDENNEURONS           = atoi(argv[2]);
+  hiddenLayerSizes        = parseLayerSizes(argv[2]);
   brainFilename           = argv[3];
+
+  for (int i = 4; i < argc; i++)
+    {
+      if ((strcmp(argv[i], "-batch") == 0) && (i+1 < argc))
+	{
+	  batchSize = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-threads") == 0) && (i+1 < argc))
+	{
+	  numThreads = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-hogwild") == 0) && (i+1 < argc))
+	{
+	  hogwildThreads = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-cycles") == 0) && (i+1 < argc))
+	{
+	  scheduleCycles = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-checkpoint") == 0) && (i+1 < argc))
+	{
+	  checkpointInterval = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-epochs") == 0) && (i+1 < argc))
+	{
+	  maxEpochs = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-validation") == 0) && (i+1 < argc))
+	{
+	  validationFraction = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-patience") == 0) && (i+1 < argc))
+	{
+	  patience = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-seed") == 0) && (i+1 < argc))
+	{
+	  randomSeed = strtoull(argv[++i], NULL, 10);
+	}
+      else if (strcmp(argv[i], "-float") == 0)
+	{
+	  useFloat = true;
+	}
+      else if ((strcmp(argv[i], "-optimizer") == 0) && (i+1 < argc))
+	{
+	  i++;
+	  if (strcmp(argv[i], "sgd") == 0)
+	    optimizerMode = OPTIMIZER_SGD;
+	  else if (strcmp(argv[i], "rmsprop") == 0)
+	    optimizerMode = OPTIMIZER_RMSPROP;
+	  else if (strcmp(argv[i], "adam") == 0)
+	    optimizerMode = OPTIMIZER_ADAM;
+	  else
+	    {
+	      printUsageInfo();
+	      return 0;
+	    }
+	}
+      else if ((strcmp(argv[i], "-rate") == 0) && (i+1 < argc))
+	{
+	  learningRate = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-sigmoid") == 0) && (i+1 < argc))
+	{
+	  i++;
+	  if (strcmp(argv[i], "exact") == 0)
+	    sigmoidMode = SIGMOID_EXACT;
+	  else if (strcmp(argv[i], "table") == 0)
+	    sigmoidMode = SIGMOID_TABLE;
+	  else if (strcmp(argv[i], "rational") == 0)
+	    sigmoidMode = SIGMOID_RATIONAL;
+	  else
+	    {
+	      printUsageInfo();
+	      return 0;
+	    }
+	}
+      else
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+    }
   
   cout<<endl;
   cout<<"Using dataset: "<<trainingDataSetFilename<<endl;
-  cout<<"Building a network with "<<HIDDENNEURONS<<" hidden nodes."<<endl;
+  cout<<"Building a network with "<<argv[2]<<" hidden nodes."<<endl;
   cout<<"Saving the brain to file: "<<brainFilename<<endl<<endl;
 
-  trainBrain();
+  if (scheduleCycles > 0)
+    {
+      if (useFloat)
+	trainBrainCycles<float>();
+      else
+	trainBrainCycles<double>();
+    }
+  else if (maxEpochs > 0)
+    {
+      if (useFloat)
+	trainBrainEpochs<float>();
+      else
+	trainBrainEpochs<double>();
+    }
+  else if (hogwildThreads > 0)
+    {
+      if (useFloat)
+	trainBrainHogwild<float>();
+      else
+	trainBrainHogwild<double>();
+    }
+  else if ((batchSize > 0) || (numThreads > 0))
+    {
+      if (useFloat)
+	trainBrainBatched<float>();
+      else
+	trainBrainBatched<double>();
+    }
+  else
+    {
+      if (useFloat)
+	trainBrain<float>();
+      else
+	trainBrain<double>();
+    }
 
   return 0;
 }
@@ -0,0 +1,102 @@
+/*******************************************************************
+Brain converter
+
+Converts a text brain, as written by aiTrainer, into the binary
+brain format NeuralNetwork::ReadBinary maps straight into memory,
+or a binary brain back into text. Which way it goes depends on
+what the input file is. Binary brains are checked against their
+checksum on the way in, and both loads are timed.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+#include "neuralNet.h"
+#include "timer.h"
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"brainConverter [inputBrainFilename] [outputBrainFilename] [-float]"<<endl<<endl;
+  cout<<"A text brain is converted to binary, in double precision unless -float"<<endl;
+  cout<<"is given, and a binary brain is converted to text."<<endl;
+}
+
+
+
+
+// Text to binary, in Real precision
+template <typename Real>
+void textToBinary(const char* inputFilename, const char* outputFilename)
+{
+  NeuralNetworkT<Real> brain;
+  Timer		       timer;
+  float		       parseTime, mapTime;
+
+  brain.ReadData(inputFilename);
+  parseTime = timer.since();
+
+  brain.DumpBinary(outputFilename);
+  brain.CleanUp();
+
+  timer.since();
+  brain.ReadBinary(outputFilename, false);
+  mapTime = timer.since();
+
+  cout<<"Converted "<<inputFilename<<" to binary "<<sizeof(Real) * 8<<" bit brain "
+      <<outputFilename<<endl;
+  cout<<"Load time: "<<parseTime * 1e6<<" us as text, "<<mapTime * 1e6<<" us as binary"<<endl;
+
+  brain.CleanUp();
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  NeuralNetwork brain;
+  bool		useFloat = false;
+
+  if ((argc < 3) || (argc > 4))
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  if (argc == 4)
+    {
+      if (strcmp(argv[3], "-float") != 0)
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+      useFloat = true;
+    }
+
+  if (IsBinaryBrainFile(argv[1]))
+    {
+      brain.ReadBinary(argv[1], true);
+      brain.DumpData(argv[2]);
+      brain.CleanUp();
+
+      cout<<"Converted binary brain "<<argv[1]<<" to text "<<argv[2]<<endl;
+    }
+  else if (useFloat)
+    {
+      textToBinary<float>(argv[1], argv[2]);
+    }
+  else
+    {
+      textToBinary<double>(argv[1], argv[2]);
+    }
+
+  return 0;
+}
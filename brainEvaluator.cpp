@@ -0,0 +1,334 @@
+/*******************************************************************
+Brain evaluator
+
+Scores trained brains on the box catching game without anyone
+having to click boxes into the simulator window. Every brain given
+plays the same millions of random drops, split across every core,
+each one with the agent starting somewhere random, a random red or
+blue box dropped from somewhere random, and random wind and colour
+shift to fall through. The game's own counters are added up over
+all of them, and reported as rates with confidence intervals, so
+brains (say the trainedBrain_N_HiddenNodes ones) can be compared
+fairly, and it's clear when they're too close to call.
+
+Drops are numbered, and each one is made from its number and the
+seed alone, so the results are the same however many threads play
+them.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+using namespace std;
+
+#include "neuralNet.h"
+#include "world.h"
+#include "worldBatch.h"
+#include "threadPool.h"
+#include "timer.h"
+
+
+
+
+// Drops are handed out to the threads this many at a time
+#define DROPS_PER_TASK 65536
+
+// z for a two sided 95% confidence interval
+#define CONFIDENCE_Z 1.959964
+
+
+// Evaluation settings, from the command line
+vector<string>	   brainFilenames;
+long		   numDrops	    = 1000000;
+int		   numThreads	    = 0;
+int		   numWorlds	    = 1024;
+float		   maxWind	    = 1.5;
+float		   maxColorShift    = 1.0;
+unsigned long long randomSeed	    = 1;
+SigmoidMode	   sigmoidMode	    = SIGMOID_TABLE;
+
+
+
+// The game's score counters, summed over some drops
+struct Score
+{
+  long NumBluesCaught;
+  long NumBluesMissed;
+  long NumRedsHitBy;
+  long NumRedsDodged;
+};
+
+
+// What the tasks share: the brain, which they only read, a
+// batch of worlds for each thread, and a score for each task
+struct Evaluation
+{
+  NeuralNetworkF     Brain;
+  vector<WorldBatch> Worlds;
+  vector<Score>	     Scores;
+};
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"brainEvaluator [brainFilename ...] [options]"<<endl<<endl;
+  cout<<"Options:"<<endl;
+  cout<<"  -drops N    Play N random drops with each brain (default "<<numDrops<<")"<<endl;
+  cout<<"  -threads N  Play on N threads (default one per core)"<<endl;
+  cout<<"  -worlds N   Step N worlds at a time on each thread (default "<<numWorlds<<")"<<endl;
+  cout<<"  -wind W     Blow the boxes with wind from -W to W (default "<<maxWind<<")"<<endl;
+  cout<<"  -shift S    Shift the box colours by 0 to S (default "<<maxColorShift<<")"<<endl;
+  cout<<"  -seed N     Pick the drops with seed N (default "<<randomSeed<<")"<<endl;
+  cout<<"  -sigmoid M  Evaluate the sigmoid as M: exact, table (default) or rational"<<endl;
+}
+
+
+
+
+// Plays drops DROPS_PER_TASK * task onwards, with every world
+// of the thread's batch playing one drop after another until
+// they've all been played
+void evaluateTask(void* data, int task, int thread)
+{
+  Evaluation*		evaluation = (Evaluation*) data;
+  const NeuralNetworkF& brain	   = evaluation->Brain;
+  WorldBatch&		worlds	   = evaluation->Worlds[thread];
+  Score&		score	   = evaluation->Scores[task];
+  long			next	   = (long) task * DROPS_PER_TASK;
+  long			last	   = next + DROPS_PER_TASK;
+  int			w, falling = 0;
+
+  if (last > numDrops)
+    last = numDrops;
+
+  worlds.Reset();
+
+  for (w = 0; (w < worlds.NumberOfWorlds) && (next < last); w++, next++, falling++)
+    {
+      worlds.StartDrop(w, RandomDrop(randomSeed, next, maxWind, maxColorShift));
+    }
+
+  while (falling > 0)
+    {
+      falling -= worlds.Step(brain);
+
+      for (w = 0; (w < worlds.NumberOfWorlds) && (next < last); w++)
+	{
+	  if (worlds.Events[w] != WORLD_NO_EVENT)
+	    {
+	      worlds.StartDrop(w, RandomDrop(randomSeed, next, maxWind, maxColorShift));
+	      next++;
+	      falling++;
+	    }
+	}
+    }
+
+  memset(&score, 0, sizeof(score));
+  for (w = 0; w < worlds.NumberOfWorlds; w++)
+    {
+      score.NumBluesCaught += worlds.NumBluesCaught[w];
+      score.NumBluesMissed += worlds.NumBluesMissed[w];
+      score.NumRedsHitBy   += worlds.NumRedsHitBy[w];
+      score.NumRedsDodged  += worlds.NumRedsDodged[w];
+    }
+}
+
+
+
+
+// Prints count out of total as a percentage, with its Wilson
+// score interval, which unlike the plain normal approximation
+// stays inside 0 to 100% when a brain (nearly) never misses
+void printRate(const char* name, long count, long total)
+{
+  double rate = 0, center = 0, spread = 0;
+  double z2   = CONFIDENCE_Z * CONFIDENCE_Z;
+
+  if (total > 0)
+    {
+      rate   = (double) count / total;
+      center = (rate + z2 / (2 * total)) / (1 + z2 / total);
+      spread = CONFIDENCE_Z * sqrt(rate * (1 - rate) / total + z2 / (4.0 * total * total)) / (1 + z2 / total);
+    }
+
+  cout<<"  "<<left<<setw(28)<<name<<right<<setw(10)<<count<<" of "<<setw(10)<<total
+      <<fixed<<setprecision(2)<<setw(9)<<100 * rate<<"%  (95% CI "
+      <<100 * (center - spread)<<"% - "<<100 * (center + spread)<<"%)"<<endl;
+}
+
+
+
+
+// Plays every drop with the brain in brainFilename, and reports how it did
+void evaluateBrain(ThreadPool& pool, const string& brainFilename, Score& total)
+{
+  Evaluation	  evaluation;
+  NeuralNetworkF& brain	   = evaluation.Brain;
+  Timer		  timer;
+  int		  numTasks = (numDrops + DROPS_PER_TASK - 1) / DROPS_PER_TASK;
+  int		  t;
+
+  brain.ReadData(brainFilename);
+  brain.SetSigmoidMode(sigmoidMode);
+
+  if ((brain.Layers[0].NumberOfNodes != WORLD_INPUTS) ||
+      (brain.Layers[brain.NumberOfLayers-1].NumberOfNodes != 1))
+    {
+      cout<<"Error, "<<brainFilename<<" doesn't have "<<WORLD_INPUTS
+	  <<" inputs and 1 output, so it can't play!"<<endl;
+      exit(1);
+    }
+
+  evaluation.Worlds.resize(numThreads);
+  evaluation.Scores.resize(numTasks);
+
+  for (t = 0; t < numThreads; t++)
+    {
+      evaluation.Worlds[t].Initialize(numWorlds);
+    }
+
+  pool.Run(evaluateTask, &evaluation, numTasks);
+
+  memset(&total, 0, sizeof(total));
+  for (t = 0; t < numTasks; t++)
+    {
+      total.NumBluesCaught += evaluation.Scores[t].NumBluesCaught;
+      total.NumBluesMissed += evaluation.Scores[t].NumBluesMissed;
+      total.NumRedsHitBy   += evaluation.Scores[t].NumRedsHitBy;
+      total.NumRedsDodged  += evaluation.Scores[t].NumRedsDodged;
+    }
+
+  cout<<brainFilename<<": "<<numDrops<<" drops in "<<fixed<<setprecision(2)<<timer.total()<<" seconds"<<endl;
+
+  printRate("Blue boxes caught:", total.NumBluesCaught, total.NumBluesCaught + total.NumBluesMissed);
+  printRate("Blue boxes missed:", total.NumBluesMissed, total.NumBluesCaught + total.NumBluesMissed);
+  printRate("Red boxes hit by:", total.NumRedsHitBy, total.NumRedsHitBy + total.NumRedsDodged);
+  printRate("Red boxes dodged:", total.NumRedsDodged, total.NumRedsHitBy + total.NumRedsDodged);
+  printRate("Overall (caught + dodged):", total.NumBluesCaught + total.NumRedsDodged, numDrops);
+  cout<<endl;
+
+  for (t = 0; t < numThreads; t++)
+    {
+      evaluation.Worlds[t].CleanUp();
+    }
+
+  brain.CleanUp();
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  ThreadPool	pool;
+  vector<Score> scores;
+  unsigned int	b;
+
+  numThreads = thread::hardware_concurrency();
+
+  for (int i = 1; i < argc; i++)
+    {
+      if ((strcmp(argv[i], "-drops") == 0) && (i+1 < argc))
+	{
+	  numDrops = atol(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-threads") == 0) && (i+1 < argc))
+	{
+	  numThreads = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-worlds") == 0) && (i+1 < argc))
+	{
+	  numWorlds = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-wind") == 0) && (i+1 < argc))
+	{
+	  maxWind = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-shift") == 0) && (i+1 < argc))
+	{
+	  maxColorShift = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-seed") == 0) && (i+1 < argc))
+	{
+	  randomSeed = strtoull(argv[++i], NULL, 10);
+	}
+      else if ((strcmp(argv[i], "-sigmoid") == 0) && (i+1 < argc))
+	{
+	  i++;
+	  if (strcmp(argv[i], "exact") == 0)
+	    sigmoidMode = SIGMOID_EXACT;
+	  else if (strcmp(argv[i], "table") == 0)
+	    sigmoidMode = SIGMOID_TABLE;
+	  else if (strcmp(argv[i], "rational") == 0)
+	    sigmoidMode = SIGMOID_RATIONAL;
+	  else
+	    {
+	      printUsageInfo();
+	      return 0;
+	    }
+	}
+      else if (argv[i][0] != '-')
+	{
+	  brainFilenames.push_back(argv[i]);
+	}
+      else
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+    }
+
+  if (brainFilenames.empty() || (numDrops < 1))
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numWorlds < 1)
+    numWorlds = 1;
+
+  cout<<"Playing "<<numDrops<<" drops (seed "<<randomSeed<<", wind up to "<<maxWind
+      <<", colour shift up to "<<maxColorShift<<") on "<<numThreads<<" threads"<<endl<<endl;
+
+  pool.Start(numThreads);
+
+  scores.resize(brainFilenames.size());
+  for (b = 0; b < brainFilenames.size(); b++)
+    {
+      evaluateBrain(pool, brainFilenames[b], scores[b]);
+    }
+
+  pool.Stop();
+
+  // Side by side, for comparing
+  if (brainFilenames.size() > 1)
+    {
+      cout<<setw(10)<<"caught"<<setw(10)<<"dodged"<<setw(10)<<"overall"<<"  brain"<<endl;
+
+      for (b = 0; b < brainFilenames.size(); b++)
+	{
+	  Score& s = scores[b];
+
+	  cout<<fixed<<setprecision(2)
+	      <<setw(9)<<100.0 * s.NumBluesCaught / max(s.NumBluesCaught + s.NumBluesMissed, 1L)<<"%"
+	      <<setw(9)<<100.0 * s.NumRedsDodged / max(s.NumRedsHitBy + s.NumRedsDodged, 1L)<<"%"
+	      <<setw(9)<<100.0 * (s.NumBluesCaught + s.NumRedsDodged) / numDrops<<"%"
+	      <<"  "<<brainFilenames[b]<<endl;
+	}
+    }
+
+  return 0;
+}
@@ -0,0 +1,683 @@
+/*******************************************************************
+Brain evolver
+
+Evolves brains for the box catching game, rather than training them
+by backpropagation on recorded data sets. A population of networks
+plays the game, and the better players are bred into the next
+generation: a child takes each of its neurons (the weights coming
+into it, and its bias) from one parent or the other, and then some
+of its weights are nudged at random. With -topology, children can
+also gain or lose a hidden neuron, so hidden layer sizes are
+searched along with the weights. That's a much simpler take on
+NEAT's idea than NEAT itself, but it needs nothing the network
+library doesn't already have.
+
+Fitness is the share of drops a brain gets right, blues caught plus
+reds dodged, played out in headless WorldBatches. Every brain in a
+generation plays the same random drops, a fresh set each generation,
+and the population is scored in parallel, one brain per task on the
+thread pool. At the end the final population plays a bigger set of
+drops, and the best brains are written out as ordinary .brain files
+the simulator can load.
+
+The same seed evolves the same brains, however many threads there are.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+using namespace std;
+
+#include <sys/stat.h>
+#include "neuralNet.h"
+#include "philoxRandom.h"
+#include "world.h"
+#include "worldBatch.h"
+#include "threadPool.h"
+#include "timer.h"
+
+
+
+
+// A tournament picks the fittest of this many at random
+#define TOURNAMENT_SIZE 3
+
+// The most hidden neurons a layer can grow to
+#define MAX_HIDDEN_NODES 64
+
+// Drop seeds. Each generation plays its own drops from
+// the first, and the final ranking plays from the second.
+#define GENERATION_DROP_SEED(seed) (seed)
+#define FINAL_DROP_SEED(seed)	   ((seed) + 1)
+
+
+// Evolution settings, from the command line
+string	 outputDirectory;
+string	 hiddenSizes	     = "4";
+string	 startFilename;
+int	 populationSize	     = 64;
+int	 numGenerations	     = 100;
+int	 dropsPerGeneration  = 256;
+int	 finalDrops	     = 20000;
+int	 numElite	     = 2;
+int	 numKeep	     = 3;
+int	 numThreads	     = 0;
+double	 mutationRate	     = 0.3;
+double	 mutationSize	     = 1.0;
+double	 crossoverRate	     = 0.5;
+double	 topologyRate	     = 0;
+float	 maxWind	     = 1.5;
+float	 maxColorShift	     = 0.5;
+unsigned long long randomSeed = time(NULL);
+
+
+
+// One brain in the population, and how it's doing
+struct Individual
+{
+  NeuralNetworkF* Brain;
+  double	  Fitness;
+};
+
+
+// What a generation's tasks share
+struct Generation
+{
+  vector<Individual>* Population;
+  vector<WorldBatch>  Worlds;		// one per thread
+  unsigned long long  DropSeed;
+  unsigned long long  FirstDrop;
+  int		      NumberOfDrops;
+};
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"brainEvolver [outputDirectory] [options]"<<endl<<endl;
+  cout<<"Options:"<<endl;
+  cout<<"  -hidden L       Hidden layer sizes to start from, with x between the sizes"<<endl;
+  cout<<"                  of several layers, e.g. 4 or 8x4 (default "<<hiddenSizes<<")"<<endl;
+  cout<<"  -start F        Start from mutated copies of the brain in F instead"<<endl;
+  cout<<"  -population N   Breed N brains a generation (default "<<populationSize<<")"<<endl;
+  cout<<"  -generations N  Evolve for N generations (default "<<numGenerations<<")"<<endl;
+  cout<<"  -drops N        Score each brain on N drops a generation (default "<<dropsPerGeneration<<")"<<endl;
+  cout<<"  -final N        Rank the last generation on N drops (default "<<finalDrops<<")"<<endl;
+  cout<<"  -elite N        Carry the best N brains over unchanged (default "<<numElite<<")"<<endl;
+  cout<<"  -mutation P S   Nudge each weight with probability P, by about S (default "
+      <<mutationRate<<" "<<mutationSize<<")"<<endl;
+  cout<<"  -crossover P    Breed from two parents with probability P (default "<<crossoverRate<<")"<<endl;
+  cout<<"  -topology P     Add or remove a hidden neuron with probability P (default "<<topologyRate<<")"<<endl;
+  cout<<"  -wind W         Blow the boxes with wind from -W to W (default "<<maxWind<<")"<<endl;
+  cout<<"  -shift S        Shift the box colours by 0 to S (default "<<maxColorShift<<")"<<endl;
+  cout<<"  -keep N         Save the best N brains (default "<<numKeep<<")"<<endl;
+  cout<<"  -threads N      Score brains on N threads (default one per core)"<<endl;
+  cout<<"  -seed N         Seed everything random with N"<<endl;
+}
+
+
+
+
+// The layer sizes of brain
+vector<int> layerSizes(const NeuralNetworkF* brain)
+{
+  vector<int> sizes;
+
+  for (int l = 0; l < brain->NumberOfLayers; l++)
+    sizes.push_back(brain->Layers[l].NumberOfNodes);
+
+  return sizes;
+}
+
+
+// A brain's layer sizes written out, e.g. 4-5-1
+string topologyName(const NeuralNetworkF* brain)
+{
+  ostringstream name;
+
+  for (int l = 0; l < brain->NumberOfLayers; l++)
+    name<<(l > 0 ? "-" : "")<<brain->Layers[l].NumberOfNodes;
+
+  return name.str();
+}
+
+
+// A weight between -1 and 1, the range new networks start with
+float randomWeight(PhiloxRandom& random)
+{
+  return 2 * random.NextDouble() - 1;
+}
+
+
+// Roughly normally distributed, with standard deviation 1 (Box-Muller)
+double randomNormal(PhiloxRandom& random)
+{
+  double u = 1 - random.NextDouble();
+  double v = random.NextDouble();
+
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+
+
+
+// Makes to a network of the given layer sizes with from's weights.
+// sources[l][i] is the neuron of from's layer l that to's neuron i
+// of layer l copies, or -1 for a new neuron. A new neuron gets
+// random weights coming in, and zero weights going out, so adding
+// one doesn't change what the network does until they're mutated.
+void copyNetwork(const NeuralNetworkF* from, NeuralNetworkF* to, const vector<int>& sizes,
+		 const vector< vector<int> >& sources, PhiloxRandom& random)
+{
+  int l, i, j, fromI, fromJ;
+
+  if (layerSizes(to) != sizes)
+    {
+      to->CleanUp();
+      to->Initialize(sizes.size(), &sizes[0]);
+      to->SetSigmoidMode(SIGMOID_TABLE);
+    }
+
+  for (l = 0; l < to->NumberOfLayers-1; l++)
+    {
+      const NeuralNetworkLayerF& source = from->Layers[l];
+      NeuralNetworkLayerF&	 layer	= to->Layers[l];
+
+      for (j = 0; j < layer.NumberOfChildNodes; j++)
+	{
+	  fromJ = sources[l+1][j];
+
+	  for (i = 0; i < layer.NumberOfNodes; i++)
+	    {
+	      fromI = sources[l][i];
+
+	      if (fromJ < 0)
+		layer.Weights[i * layer.WeightStride + j] = randomWeight(random);
+	      else if (fromI < 0)
+		layer.Weights[i * layer.WeightStride + j] = 0;
+	      else
+		layer.Weights[i * layer.WeightStride + j] = source.Weights[fromI * source.WeightStride + fromJ];
+	    }
+
+	  layer.BiasWeights[j] = (fromJ < 0) ? randomWeight(random) : source.BiasWeights[fromJ];
+	}
+    }
+}
+
+
+
+// Every neuron copied to where it was
+vector< vector<int> > sameNeurons(const vector<int>& sizes)
+{
+  vector< vector<int> > sources(sizes.size());
+
+  for (unsigned int l = 0; l < sizes.size(); l++)
+    for (int i = 0; i < sizes[l]; i++)
+      sources[l].push_back(i);
+
+  return sources;
+}
+
+
+
+
+// Gives child a random choice of other's neurons, each one's
+// incoming weights and bias together. Only for networks with
+// the same layer sizes.
+void crossOver(NeuralNetworkF* child, const NeuralNetworkF* other, PhiloxRandom& random)
+{
+  int l, i, j;
+
+  for (l = 0; l < child->NumberOfLayers-1; l++)
+    {
+      NeuralNetworkLayerF&	 layer	= child->Layers[l];
+      const NeuralNetworkLayerF& source = other->Layers[l];
+
+      for (j = 0; j < layer.NumberOfChildNodes; j++)
+	{
+	  if (random.NextBelow(2) == 0)
+	    continue;
+
+	  for (i = 0; i < layer.NumberOfNodes; i++)
+	    layer.Weights[i * layer.WeightStride + j] = source.Weights[i * source.WeightStride + j];
+
+	  layer.BiasWeights[j] = source.BiasWeights[j];
+	}
+    }
+}
+
+
+
+// Nudges each weight and bias, with probability mutationRate,
+// by a normally distributed amount mutationSize across
+void mutateWeights(NeuralNetworkF* brain, PhiloxRandom& random)
+{
+  int l, i, j;
+
+  for (l = 0; l < brain->NumberOfLayers-1; l++)
+    {
+      NeuralNetworkLayerF& layer = brain->Layers[l];
+
+      for (j = 0; j < layer.NumberOfChildNodes; j++)
+	{
+	  for (i = 0; i < layer.NumberOfNodes; i++)
+	    {
+	      if (random.NextDouble() < mutationRate)
+		layer.Weights[i * layer.WeightStride + j] += mutationSize * randomNormal(random);
+	    }
+
+	  if (random.NextDouble() < mutationRate)
+	    layer.BiasWeights[j] += mutationSize * randomNormal(random);
+	}
+    }
+}
+
+
+
+// Copies parent into child with one hidden neuron, in a random
+// hidden layer, added or removed. Layers are never emptied, or
+// grown past MAX_HIDDEN_NODES.
+void mutateTopology(const NeuralNetworkF* parent, NeuralNetworkF* child, PhiloxRandom& random)
+{
+  vector<int>		sizes	= layerSizes(parent);
+  vector< vector<int> > sources = sameNeurons(sizes);
+  int			l, drop;
+
+  l = 1 + random.NextBelow(sizes.size() - 2);
+
+  if ((random.NextBelow(2) == 0) && (sizes[l] < MAX_HIDDEN_NODES))
+    {
+      sources[l].push_back(-1);
+      sizes[l]++;
+    }
+  else if (sizes[l] > 1)
+    {
+      drop = random.NextBelow(sizes[l]);
+      sources[l].erase(sources[l].begin() + drop);
+      sizes[l]--;
+    }
+
+  copyNetwork(parent, child, sizes, sources, random);
+}
+
+
+
+
+// Plays the generation's drops with brain number task, all of
+// them at once, one to each of the thread's worlds
+void scoreTask(void* data, int task, int thread)
+{
+  Generation* generation = (Generation*) data;
+  Individual& individual = (*generation->Population)[task];
+  WorldBatch& worlds	 = generation->Worlds[thread];
+  int	      w, falling;
+  long	      right	 = 0;
+
+  worlds.Reset();
+
+  for (w = 0; w < worlds.NumberOfWorlds; w++)
+    {
+      worlds.StartDrop(w, RandomDrop(generation->DropSeed, generation->FirstDrop + w,
+				     maxWind, maxColorShift));
+    }
+
+  for (falling = worlds.NumberOfWorlds; falling > 0; )
+    {
+      falling -= worlds.Step(*individual.Brain);
+    }
+
+  for (w = 0; w < worlds.NumberOfWorlds; w++)
+    {
+      right += worlds.NumBluesCaught[w] + worlds.NumRedsDodged[w];
+    }
+
+  individual.Fitness = (double) right / worlds.NumberOfWorlds;
+}
+
+
+
+// Scores the whole population on numDrops drops, from
+// drop number firstDrop of the drops seeded with dropSeed
+void scorePopulation(ThreadPool& pool, vector<Individual>& population,
+		     unsigned long long dropSeed, unsigned long long firstDrop, int numDrops)
+{
+  Generation generation;
+  int	     t;
+
+  generation.Population	   = &population;
+  generation.DropSeed	   = dropSeed;
+  generation.FirstDrop	   = firstDrop;
+  generation.NumberOfDrops = numDrops;
+  generation.Worlds.resize(numThreads);
+
+  for (t = 0; t < numThreads; t++)
+    generation.Worlds[t].Initialize(numDrops);
+
+  pool.Run(scoreTask, &generation, population.size());
+
+  for (t = 0; t < numThreads; t++)
+    generation.Worlds[t].CleanUp();
+}
+
+
+
+// Fittest first. Ties keep their order.
+bool fitter(const Individual& a, const Individual& b)
+{
+  return a.Fitness > b.Fitness;
+}
+
+
+// The fittest of TOURNAMENT_SIZE picked at random
+// from the population, which is sorted fittest first
+int tournament(int size, PhiloxRandom& random)
+{
+  int best = size, t, pick;
+
+  for (t = 0; t < TOURNAMENT_SIZE; t++)
+    {
+      pick = random.NextBelow(size);
+      best = (pick < best) ? pick : best;
+    }
+
+  return best;
+}
+
+
+
+
+// Breeds children from parents, which are sorted fittest first
+void breed(const vector<Individual>& parents, vector<Individual>& children, PhiloxRandom& random)
+{
+  int		  c, first, second;
+  NeuralNetworkF* child;
+  vector<int>	  sizes;
+
+  for (c = 0; c < populationSize; c++)
+    {
+      child = children[c].Brain;
+
+      // The elite go through as they are
+      if (c < numElite)
+	{
+	  sizes = layerSizes(parents[c].Brain);
+	  copyNetwork(parents[c].Brain, child, sizes, sameNeurons(sizes), random);
+	  continue;
+	}
+
+      first = tournament(populationSize, random);
+
+      if ((topologyRate > 0) && (parents[first].Brain->NumberOfLayers > 2) &&
+	  (random.NextDouble() < topologyRate))
+	{
+	  mutateTopology(parents[first].Brain, child, random);
+	}
+      else
+	{
+	  sizes = layerSizes(parents[first].Brain);
+	  copyNetwork(parents[first].Brain, child, sizes, sameNeurons(sizes), random);
+
+	  if (random.NextDouble() < crossoverRate)
+	    {
+	      second = tournament(populationSize, random);
+
+	      if (layerSizes(parents[second].Brain) == sizes)
+		crossOver(child, parents[second].Brain, random);
+	    }
+	}
+
+      mutateWeights(child, random);
+    }
+}
+
+
+
+
+// The first generation: networks of the -hidden sizes with
+// random weights, or mutated copies of the -start brain
+void createPopulation(vector<Individual>& population)
+{
+  NeuralNetworkF	start;
+  vector<int>		sizes;
+  string		item;
+  istringstream		hidden(hiddenSizes);
+  PhiloxRandom		random(randomSeed, RANDOM_STREAM_EVOLUTION);
+  int			i;
+
+  if (!startFilename.empty())
+    {
+      start.ReadData(startFilename);
+      sizes = layerSizes(&start);
+    }
+  else
+    {
+      sizes.push_back(WORLD_INPUTS);
+      while (getline(hidden, item, 'x'))
+	{
+	  if (atoi(item.c_str()) > 0)
+	    sizes.push_back(atoi(item.c_str()));
+	}
+      sizes.push_back(1);
+    }
+
+  if ((sizes.front() != WORLD_INPUTS) || (sizes.back() != 1))
+    {
+      cout<<"Error, "<<startFilename<<" doesn't have "<<WORLD_INPUTS<<" inputs and 1 output, so it can't play!"<<endl;
+      exit(1);
+    }
+
+  population.resize(populationSize);
+
+  for (i = 0; i < populationSize; i++)
+    {
+      population[i].Brain   = new NeuralNetworkF;
+      population[i].Fitness = 0;
+
+      population[i].Brain->SetRandomSeed(randomSeed + i);
+      population[i].Brain->Initialize(sizes.size(), &sizes[0]);
+      population[i].Brain->SetSigmoidMode(SIGMOID_TABLE);
+
+      // The start brain itself, then mutated copies of it
+      if (!startFilename.empty())
+	{
+	  copyNetwork(&start, population[i].Brain, sizes, sameNeurons(sizes), random);
+	  if (i > 0)
+	    mutateWeights(population[i].Brain, random);
+	}
+    }
+
+  start.CleanUp();
+}
+
+
+
+
+void evolve()
+{
+  vector<Individual> population, children;
+  ThreadPool	     pool;
+  Timer		     timer;
+  PhiloxRandom	     random;
+  int		     generation, i;
+  double	     meanFitness;
+
+  createPopulation(population);
+
+  children.resize(populationSize);
+  for (i = 0; i < populationSize; i++)
+    {
+      children[i].Brain	  = new NeuralNetworkF;
+      children[i].Fitness = 0;
+    }
+
+  cout<<"Evolving "<<populationSize<<" brains of "<<topologyName(population[0].Brain)<<" for "
+      <<numGenerations<<" generations, "<<dropsPerGeneration<<" drops each, on "<<numThreads
+      <<" threads (random seed "<<randomSeed<<")"<<endl;
+
+  pool.Start(numThreads);
+
+  for (generation = 1; generation <= numGenerations; generation++)
+    {
+      scorePopulation(pool, population, GENERATION_DROP_SEED(randomSeed),
+		      (unsigned long long) generation * dropsPerGeneration, dropsPerGeneration);
+
+      stable_sort(population.begin(), population.end(), fitter);
+
+      meanFitness = 0;
+      for (i = 0; i < populationSize; i++)
+	meanFitness += population[i].Fitness / populationSize;
+
+      cout<<"Generation "<<generation<<": best "<<fixed<<setprecision(4)<<population[0].Fitness
+	  <<" ("<<topologyName(population[0].Brain)<<"), mean "<<meanFitness<<endl;
+
+      if (generation == numGenerations)
+	break;
+
+      random.Seed(randomSeed, RANDOM_STREAM_EVOLUTION + generation);
+      breed(population, children, random);
+      population.swap(children);
+    }
+
+  // The last generation played on a bigger set of drops, which
+  // no brain has been picked for, to rank it fairly
+  scorePopulation(pool, population, FINAL_DROP_SEED(randomSeed), 0, finalDrops);
+  stable_sort(population.begin(), population.end(), fitter);
+
+  pool.Stop();
+
+  mkdir(outputDirectory.c_str(), 0755);
+
+  for (i = 0; (i < numKeep) && (i < populationSize); i++)
+    {
+      ostringstream brainFilename;
+
+      brainFilename<<outputDirectory<<"/evolvedBrain_"<<i+1;
+      population[i].Brain->DumpData(brainFilename.str());
+
+      cout<<"Saved "<<topologyName(population[i].Brain)<<", scoring "<<population[i].Fitness
+	  <<" on "<<finalDrops<<" drops, as "<<brainFilename.str()<<endl;
+    }
+
+  cout<<"Evolution took "<<setprecision(2)<<timer.total()<<" seconds"<<endl;
+
+  for (i = 0; i < populationSize; i++)
+    {
+      population[i].Brain->CleanUp();
+      children[i].Brain->CleanUp();
+      delete population[i].Brain;
+      delete children[i].Brain;
+    }
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  outputDirectory = argv[1];
+  numThreads	  = thread::hardware_concurrency();
+
+  for (int i = 2; i < argc; i++)
+    {
+      if ((strcmp(argv[i], "-hidden") == 0) && (i+1 < argc))
+	{
+	  hiddenSizes = argv[++i];
+	}
+      else if ((strcmp(argv[i], "-start") == 0) && (i+1 < argc))
+	{
+	  startFilename = argv[++i];
+	}
+      else if ((strcmp(argv[i], "-population") == 0) && (i+1 < argc))
+	{
+	  populationSize = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-generations") == 0) && (i+1 < argc))
+	{
+	  numGenerations = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-drops") == 0) && (i+1 < argc))
+	{
+	  dropsPerGeneration = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-final") == 0) && (i+1 < argc))
+	{
+	  finalDrops = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-elite") == 0) && (i+1 < argc))
+	{
+	  numElite = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-mutation") == 0) && (i+2 < argc))
+	{
+	  mutationRate = atof(argv[++i]);
+	  mutationSize = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-crossover") == 0) && (i+1 < argc))
+	{
+	  crossoverRate = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-topology") == 0) && (i+1 < argc))
+	{
+	  topologyRate = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-wind") == 0) && (i+1 < argc))
+	{
+	  maxWind = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-shift") == 0) && (i+1 < argc))
+	{
+	  maxColorShift = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-keep") == 0) && (i+1 < argc))
+	{
+	  numKeep = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-threads") == 0) && (i+1 < argc))
+	{
+	  numThreads = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-seed") == 0) && (i+1 < argc))
+	{
+	  randomSeed = strtoull(argv[++i], NULL, 10);
+	}
+      else
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+    }
+
+  if (numThreads < 1)
+    numThreads = 1;
+  if (populationSize < 2)
+    populationSize = 2;
+  if (numGenerations < 1)
+    numGenerations = 1;
+  if (dropsPerGeneration < 1)
+    dropsPerGeneration = 1;
+  if (finalDrops < 1)
+    finalDrops = 1;
+  if (numElite > populationSize)
+    numElite = populationSize;
+
+  evolve();
+
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*******************************************************************
+Brain quantizer
+
+Converts a brain trained with aiTrainer into the fixed point,
+inference only format used by QuantizedNeuralNetwork, and reports
+how far the quantized outputs can stray from the original network.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <cstdlib>
+using namespace std;
+
+#include "neuralNet.h"
+#include "quantizedNet.h"
+#include "timer.h"
+
+
+
+
+// Number of random inputs to compare the
+// two networks on, unless told otherwise
+#define DEFAULT_ERROR_SAMPLES 1000000
+
+
+// Number of forward passes timed for each network
+#define TIMING_PASSES 1000000
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"brainQuantizer [brainFilename] [quantizedBrainFilename] [numErrorSamples]"<<endl;
+}
+
+
+
+
+// Rough cost of one forward pass, in nanoseconds
+template <class Network>
+double timeFeedForward(Network& network, int numInputs)
+{
+  int	i, k;
+  Timer timer;
+
+  for(k=0; k<TIMING_PASSES; k++)
+    {
+      for(i=0; i<numInputs; i++)
+	{
+	  network.SetInput(i, ((k + i) & 255) / 128.0f - 1.0f);
+	}
+      network.FeedForward();
+    }
+
+  return timer.total() * 1e9 / TIMING_PASSES;
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  NeuralNetwork		 brain;
+  QuantizedNeuralNetwork quantizedBrain;
+  int			 numSamples = DEFAULT_ERROR_SAMPLES;
+  int			 nInputs, nHidden, nOutputs;
+  double		 worstError;
+
+  if (argc < 3)
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  if (argc > 3)
+    {
+      numSamples = atoi(argv[3]);
+    }
+
+  brain.ReadData(argv[1]);
+  quantizedBrain.Quantize(brain);
+  quantizedBrain.DumpData(argv[2]);
+
+  nInputs  = brain.Layers[0].NumberOfNodes;
+  nHidden  = brain.Layers[1].NumberOfNodes;
+  nOutputs = brain.Layers[2].NumberOfNodes;
+
+  cout<<"Quantized a "<<nInputs<<"-"<<nHidden<<"-"<<nOutputs
+      <<" network into "<<argv[2]<<endl;
+  cout<<"Weight bytes: "
+      <<sizeof(double) * (nInputs * nHidden + nHidden * nOutputs)<<" double, "
+      <<sizeof(short) * (nInputs * nHidden + nHidden * nOutputs)<<" quantized"<<endl;
+  cout<<"Hidden layer weight scale: "<<quantizedBrain.HiddenLayer.WeightScale<<endl;
+  cout<<"Output layer weight scale: "<<quantizedBrain.OutputLayer.WeightScale<<endl;
+
+  worstError = quantizedBrain.MeasureError(brain, numSamples);
+  cout<<"Worst case output error over "<<numSamples
+      <<" samples: "<<worstError<<endl;
+
+  cout<<"Forward pass: "<<timeFeedForward(brain, nInputs)<<" ns double, "
+      <<timeFeedForward(quantizedBrain, nInputs)<<" ns quantized"<<endl;
+
+  brain.CleanUp();
+  quantizedBrain.CleanUp();
+
+  return 0;
+}
@@ -0,0 +1,265 @@
+/*******************************************************************
+Data set generator
+
+Generates training data from the game itself, rather than by hand.
+Random drops are played out in headless Worlds, and every step's
+brain inputs become a sample, labelled with what the scripted
+expert (World::ExpertMovement) would do: get under a blue box, and
+out from under a red one. Now and then the agent makes a random move
+instead of the expert's, so the samples also cover states the
+expert would never get itself into, and a brain trained on them
+knows how to recover. Some samples with no box falling are mixed
+in too, for sitting still.
+
+The samples are generated on every core and written straight into
+one binary training set, the kind datasetPacker makes and aiTrainer
+maps, without going through text files. They come in blocks, each
+made from its block number and the seed alone, so the same seed
+gives the same set however many threads make it.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <thread>
+using namespace std;
+
+#include "trainingSet.h"
+#include "philoxRandom.h"
+#include "world.h"
+#include "threadPool.h"
+#include "timer.h"
+
+
+
+
+// Samples are generated in blocks of this many
+#define SAMPLES_PER_TASK 65536
+
+// and this many blocks a thread are kept in memory at once
+#define TASKS_PER_THREAD 4
+
+
+// Generator settings, from the command line
+string	 packedFilename;
+long	 numSamples	     = 1000000;
+int	 numThreads	     = 0;
+double	 exploreRate	     = 0.25;
+double	 idleRate	     = 0.05;
+float	 maxWind	     = 1.5;
+float	 maxColorShift	     = 0.5;
+unsigned long long randomSeed = time(NULL);
+bool	 useDouble	     = false;
+
+
+
+// What a round of tasks shares: the blocks of samples
+// they make, each one's inputs then desired outputs
+template <typename Real>
+struct GeneratorRound
+{
+  long		       FirstTask;
+  vector< vector<Real> > Inputs;
+  vector< vector<Real> > Desired;
+  vector<long>	       Drops;
+};
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"datasetGenerator [packedSetFilename] [options]"<<endl<<endl;
+  cout<<"Options:"<<endl;
+  cout<<"  -samples N  Generate N samples (default "<<numSamples<<")"<<endl;
+  cout<<"  -explore P  Make a random move instead of the expert's with probability P (default "
+      <<exploreRate<<")"<<endl;
+  cout<<"  -idle P     Add a sample with no box falling between drops with probability P (default "
+      <<idleRate<<")"<<endl;
+  cout<<"  -wind W     Blow the boxes with wind from -W to W (default "<<maxWind<<")"<<endl;
+  cout<<"  -shift S    Shift the box colours by 0 to S (default "<<maxColorShift<<")"<<endl;
+  cout<<"  -threads N  Generate on N threads (default one per core)"<<endl;
+  cout<<"  -seed N     Seed the drops and moves with N"<<endl;
+  cout<<"  -double     Store the samples in double precision instead of single"<<endl;
+}
+
+
+
+
+// Fills block number FirstTask + task, playing drop after drop in a
+// World of its own and taking a sample every step
+template <typename Real>
+void generateTask(void* data, int task, int thread)
+{
+  GeneratorRound<Real>* round  = (GeneratorRound<Real>*) data;
+  unsigned long long	block  = round->FirstTask + task;
+  vector<Real>&		inputs  = round->Inputs[task];
+  vector<Real>&		desired = round->Desired[task];
+  PhiloxRandom		random(randomSeed, RANDOM_STREAM_SAMPLING + block);
+  World			world;
+  float			values[WORLD_INPUTS];
+  float			expert;
+  long			s, count;
+  int			i;
+  long			drop	= 0;
+
+  count = numSamples - (long) block * SAMPLES_PER_TASK;
+  if (count > SAMPLES_PER_TASK)
+    count = SAMPLES_PER_TASK;
+
+  inputs.resize(count * WORLD_INPUTS);
+  desired.resize(count);
+
+  for (s = 0; s < count; s++)
+    {
+      // Between drops, a sample of the agent waiting, or the next drop
+      if (!world.BoxActive && (random.NextDouble() >= idleRate))
+	{
+	  world.StartDrop(RandomDrop(randomSeed, (block << 32) + drop, maxWind, maxColorShift));
+	  drop++;
+	}
+
+      // One step of World::Step, with the expert's say
+      // recorded and then, mostly, followed
+      if (world.BoxActive)
+	{
+	  world.AnimateBox();
+	  world.CalculateVectors();
+	}
+
+      world.GetInputs(values);
+      expert = world.ExpertMovement();
+
+      for (i = 0; i < WORLD_INPUTS; i++)
+	inputs[s * WORLD_INPUTS + i] = values[i];
+      desired[s] = expert;
+
+      if (random.NextDouble() < exploreRate)
+	world.MoveAgent(random.NextDouble());
+      else
+	world.MoveAgent(expert);
+    }
+
+  round->Drops[task] = drop;
+}
+
+
+
+
+template <typename Real>
+void generateSet()
+{
+  TrainingSetWriterT<Real> writer;
+  GeneratorRound<Real>	   round;
+  ThreadPool		   pool;
+  Timer			   timer;
+  long			   numTasks  = (numSamples + SAMPLES_PER_TASK - 1) / SAMPLES_PER_TASK;
+  long			   perRound  = (long) numThreads * TASKS_PER_THREAD;
+  long			   numDrops  = 0;
+  long			   tasks, t;
+
+  cout<<"Generating "<<numSamples<<" samples on "<<numThreads<<" threads (random seed "
+      <<randomSeed<<")"<<endl;
+
+  writer.Open(packedFilename, WORLD_INPUTS, 1, numSamples);
+  pool.Start(numThreads);
+
+  round.Inputs.resize(perRound);
+  round.Desired.resize(perRound);
+  round.Drops.resize(perRound);
+
+  for (round.FirstTask = 0; round.FirstTask < numTasks; round.FirstTask += perRound)
+    {
+      tasks = numTasks - round.FirstTask;
+      if (tasks > perRound)
+	tasks = perRound;
+
+      pool.Run(generateTask<Real>, &round, tasks);
+
+      for (t = 0; t < tasks; t++)
+	{
+	  writer.WriteSamples(&round.Inputs[t][0], &round.Desired[t][0], round.Desired[t].size());
+	  numDrops += round.Drops[t];
+	}
+    }
+
+  pool.Stop();
+  writer.Close();
+
+  cout<<"Wrote "<<numSamples<<" samples, from "<<numDrops<<" drops, to "<<packedFilename
+      <<" in "<<timer.total()<<" seconds"<<endl;
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  packedFilename = argv[1];
+  numThreads	 = thread::hardware_concurrency();
+
+  for (int i = 2; i < argc; i++)
+    {
+      if ((strcmp(argv[i], "-samples") == 0) && (i+1 < argc))
+	{
+	  numSamples = atol(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-explore") == 0) && (i+1 < argc))
+	{
+	  exploreRate = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-idle") == 0) && (i+1 < argc))
+	{
+	  idleRate = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-wind") == 0) && (i+1 < argc))
+	{
+	  maxWind = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-shift") == 0) && (i+1 < argc))
+	{
+	  maxColorShift = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-threads") == 0) && (i+1 < argc))
+	{
+	  numThreads = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-seed") == 0) && (i+1 < argc))
+	{
+	  randomSeed = strtoull(argv[++i], NULL, 10);
+	}
+      else if (strcmp(argv[i], "-double") == 0)
+	{
+	  useDouble = true;
+	}
+      else
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+    }
+
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numSamples < 1)
+    numSamples = 1;
+
+  if (useDouble)
+    generateSet<double>();
+  else
+    generateSet<float>();
+
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*******************************************************************
+Data set packer
+
+Packs any number of text training data sets, the kind aiTrainer
+has always read, into one binary training set that aiTrainer maps
+straight into memory. Directories are packed file by file, in name
+order, so all of trainingFiles can go into a single set.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+#include <dirent.h>
+#include "trainingSet.h"
+
+
+
+
+// The shape of the samples aiTrainer trains on
+#define INPUTNEURONS  4
+#define OUTPUTNEURONS 1
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"datasetPacker [packedSetFilename] [dataSetFilename or directory] ... [options]"<<endl<<endl;
+  cout<<"Options:"<<endl;
+  cout<<"  -inputs N   Samples have N inputs (default "<<INPUTNEURONS<<")"<<endl;
+  cout<<"  -outputs N  Samples have N desired outputs (default "<<OUTPUTNEURONS<<")"<<endl;
+  cout<<"  -double     Store the samples in double precision instead of single"<<endl;
+}
+
+
+
+
+// Adds filename to filenames, or every file in it, in
+// name order, if it turns out to be a directory
+void addDataSets(string filename, vector<string>& filenames)
+{
+  DIR*		 directory;
+  struct dirent* entry;
+  vector<string> contents;
+
+  directory = opendir(filename.c_str());
+  if (directory == NULL)
+    {
+      filenames.push_back(filename);
+      return;
+    }
+
+  while ((entry = readdir(directory)) != NULL)
+    {
+      if (entry->d_name[0] != '.')
+	{
+	  contents.push_back(filename + "/" + entry->d_name);
+	}
+    }
+  closedir(directory);
+
+  sort(contents.begin(), contents.end());
+  filenames.insert(filenames.end(), contents.begin(), contents.end());
+}
+
+
+
+
+template <typename Real>
+void packDataSets(const string& packedFilename, const vector<string>& filenames,
+		  int numInputs, int numOutputs)
+{
+  TrainingSetT<Real> trainingSet;
+  unsigned int	     i;
+
+  trainingSet.Initialize(numInputs, numOutputs);
+
+  for (i = 0; i < filenames.size(); i++)
+    {
+      trainingSet.ImportText(filenames[i]);
+    }
+
+  trainingSet.DumpData(packedFilename);
+
+  cout<<"Packed "<<trainingSet.NumberOfSamples<<" samples from "<<filenames.size()
+      <<" data sets into "<<packedFilename<<endl;
+
+  trainingSet.CleanUp();
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  vector<string> filenames;
+  int		 numInputs  = INPUTNEURONS;
+  int		 numOutputs = OUTPUTNEURONS;
+  bool		 useDouble  = false;
+
+  if (argc < 3)
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  for (int i = 2; i < argc; i++)
+    {
+      if ((strcmp(argv[i], "-inputs") == 0) && (i+1 < argc))
+	{
+	  numInputs = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-outputs") == 0) && (i+1 < argc))
+	{
+	  numOutputs = atoi(argv[++i]);
+	}
+      else if (strcmp(argv[i], "-double") == 0)
+	{
+	  useDouble = true;
+	}
+      else if (argv[i][0] == '-')
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+      else
+	{
+	  addDataSets(argv[i], filenames);
+	}
+    }
+
+  if (filenames.empty() || (numInputs < 1) || (numOutputs < 1))
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  if (useDouble)
+    packDataSets<double>(argv[1], filenames, numInputs, numOutputs);
+  else
+    packDataSets<float>(argv[1], filenames, numInputs, numOutputs);
+
+  return 0;
+}
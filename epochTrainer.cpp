@@ -0,0 +1,365 @@
+#include "epochTrainer.h"
+#include "philoxRandom.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+//---------------------------------------------------------------------------
+/*
+  See epochTrainer.h. Samples are only ever referred to by their
+  number in the training set. The ones a batch or a validation chunk
+  needs are copied into BatchInputs/BatchDesired, so the set itself
+  (which may be a mapped file) is never rearranged.
+*/
+//---------------------------------------------------------------------------
+
+template <typename Real>
+EpochTrainerT<Real>::EpochTrainerT()
+{
+  MaxEpochs	  = 1000;
+  Patience	  = 10;
+  Network	  = NULL;
+  Set		  = NULL;
+  Seed		  = 0;
+  BatchSize	  = 0;
+  NumberOfThreads = 0;
+
+  CleanUp();
+}
+
+
+
+
+// Sets up to train network on trainingSet, holding back
+// validationFraction of its samples, picked at random with
+// seed, to score it on. At least one sample is always left
+// to train on. With no validation samples at all, the
+// training error is used to decide when to stop instead.
+template <typename Real>
+void EpochTrainerT<Real>::Initialize(NeuralNetworkT<Real>* network, const TrainingSetT<Real>* trainingSet,
+				     double validationFraction, unsigned long long seed)
+{
+  long	       s, numSamples, numValidation;
+  vector<long> order;
+  PhiloxRandom random(seed, RANDOM_STREAM_VALIDATION);
+
+  CleanUp();
+
+  Network    = network;
+  Set	     = trainingSet;
+  Seed	     = seed;
+  numSamples = Set->NumberOfSamples;
+
+  numValidation = (long) (validationFraction * numSamples);
+  if(numValidation > numSamples - 1)
+    {
+      numValidation = numSamples - 1;
+    }
+  if(numValidation < 0)
+    {
+      numValidation = 0;
+    }
+
+  order.resize(numSamples);
+  for(s=0; s<numSamples; s++)
+    {
+      order[s] = s;
+    }
+  random.Shuffle(&order[0], numSamples);
+
+  ValidationSamples.assign(order.begin(), order.begin() + numValidation);
+  TrainingSamples.assign(order.begin() + numValidation, order.end());
+
+  // Read in file order, they're gathered with less jumping about
+  sort(ValidationSamples.begin(), ValidationSamples.end());
+
+  NumberOfTrainingSamples   = TrainingSamples.size();
+  NumberOfValidationSamples = ValidationSamples.size();
+
+  SetBatching(BatchSize, NumberOfThreads);
+}
+
+
+
+template <typename Real>
+void EpochTrainerT<Real>::CleanUp(void)
+{
+  Parallel.CleanUp();
+
+  TrainingSamples.clear();
+  ValidationSamples.clear();
+  BatchInputs.clear();
+  BatchDesired.clear();
+  BatchOutputs.clear();
+  BestWeights.clear();
+
+  Epoch			    = 0;
+  TrainingError		    = 0;
+  ValidationError	    = 0;
+  BestEpoch		    = 0;
+  BestError		    = 0;
+  SamplesProcessed	    = 0;
+  Seconds		    = 0;
+  NumberOfTrainingSamples   = 0;
+  NumberOfValidationSamples = 0;
+}
+
+
+
+
+// Trains in mini-batches of batchSize samples, on numThreads
+// threads if that's more than zero. A batchSize of zero goes
+// back to training on one sample at a time.
+template <typename Real>
+void EpochTrainerT<Real>::SetBatching(int batchSize, int numThreads)
+{
+  int rows;
+
+  BatchSize	  = (batchSize > 0) ? batchSize : 0;
+  NumberOfThreads = (BatchSize > 0) ? numThreads : 0;
+
+  if(Network == NULL)
+    {
+      return;
+    }
+
+  rows = (BatchSize > VALIDATION_CHUNK) ? BatchSize : VALIDATION_CHUNK;
+
+  BatchInputs.resize((size_t) rows * Set->NumberOfInputs);
+  BatchDesired.resize((size_t) rows * Set->NumberOfOutputs);
+  BatchOutputs.resize((size_t) rows * Set->NumberOfOutputs);
+
+  Parallel.CleanUp();
+  if(NumberOfThreads > 0)
+    {
+      Parallel.Initialize(Network, NumberOfThreads, BatchSize);
+    }
+}
+
+
+
+// Stops after maxEpochs epochs, or once patience epochs
+// in a row haven't improved on the best validation error
+template <typename Real>
+void EpochTrainerT<Real>::SetStopping(int maxEpochs, int patience)
+{
+  MaxEpochs = maxEpochs;
+  Patience  = patience;
+}
+
+
+
+
+// Runs one epoch: every training sample once, in a new order, then
+// the validation samples scored. Keeps a copy of the weights if they
+// scored the best yet. Returns whether training should go on.
+template <typename Real>
+bool EpochTrainerT<Real>::NextEpoch(void)
+{
+  Timer	       timer;
+  PhiloxRandom shuffler(Seed, RANDOM_STREAM_SHUFFLE + Epoch);
+
+  Epoch++;
+
+  shuffler.Shuffle(&TrainingSamples[0], NumberOfTrainingSamples);
+
+  if(BatchSize > 0)
+    TrainingError = TrainBatched();
+  else
+    TrainingError = TrainOnline();
+
+  SamplesProcessed += NumberOfTrainingSamples;
+
+  if(NumberOfValidationSamples > 0)
+    ValidationError = Validate();
+  else
+    ValidationError = TrainingError;
+
+  if((Epoch == 1) || (ValidationError < BestError * (1 - EPOCH_MIN_IMPROVEMENT)))
+    {
+      BestEpoch = Epoch;
+      BestError = ValidationError;
+      SaveBest();
+    }
+
+  Seconds += timer.total();
+
+  return (Epoch < MaxEpochs) && (Epoch - BestEpoch < Patience);
+}
+
+
+
+
+// One sample at a time, one weight update per sample
+template <typename Real>
+Real EpochTrainerT<Real>::TrainOnline(void)
+{
+  long	      s;
+  int	      i;
+  int	      nInputs  = Set->NumberOfInputs;
+  int	      nOutputs = Set->NumberOfOutputs;
+  const Real* inputs;
+  const Real* desired;
+  double      error    = 0;
+
+  for(s=0; s<NumberOfTrainingSamples; s++)
+    {
+      inputs  = Set->Inputs + TrainingSamples[s] * nInputs;
+      desired = Set->Desired + TrainingSamples[s] * nOutputs;
+
+      for(i=0; i<nInputs; i++)
+	{
+	  Network->SetInput(i, inputs[i]);
+	}
+
+      for(i=0; i<nOutputs; i++)
+	{
+	  Network->SetDesiredOutput(i, desired[i]);
+	}
+
+      Network->FeedForward();
+      error += Network->CalculateError();
+      Network->BackPropagate();
+    }
+
+  return error / NumberOfTrainingSamples;
+}
+
+
+
+// BatchSize samples at a time, one weight update per batch
+template <typename Real>
+Real EpochTrainerT<Real>::TrainBatched(void)
+{
+  long	 first;
+  int	 rows;
+  double error = 0;
+
+  for(first=0; first<NumberOfTrainingSamples; first+=BatchSize)
+    {
+      rows = (NumberOfTrainingSamples - first < BatchSize) ? NumberOfTrainingSamples - first : BatchSize;
+
+      GatherSamples(&TrainingSamples[first], rows);
+
+      if(NumberOfThreads > 0)
+	error += rows * Parallel.BackPropagateBatch(&BatchInputs[0], &BatchDesired[0], rows);
+      else
+	error += rows * Network->BackPropagateBatch(&BatchInputs[0], &BatchDesired[0], rows);
+    }
+
+  return error / NumberOfTrainingSamples;
+}
+
+
+
+
+// The mean of CalculateError over the validation samples, run
+// through the network VALIDATION_CHUNK at a time with FeedForwardBatch
+template <typename Real>
+Real EpochTrainerT<Real>::Validate(void)
+{
+  long	 first;
+  int	 rows, r, i;
+  int	 nOutputs = Set->NumberOfOutputs;
+  Real	 difference;
+  double error	  = 0;
+
+  for(first=0; first<NumberOfValidationSamples; first+=VALIDATION_CHUNK)
+    {
+      rows = (NumberOfValidationSamples - first < VALIDATION_CHUNK) ?
+	NumberOfValidationSamples - first : VALIDATION_CHUNK;
+
+      GatherSamples(&ValidationSamples[first], rows);
+      Network->FeedForwardBatch(&BatchInputs[0], rows, &BatchOutputs[0]);
+
+      for(r=0; r<rows * nOutputs; r+=nOutputs)
+	{
+	  for(i=0; i<nOutputs; i++)
+	    {
+	      difference = BatchOutputs[r + i] - BatchDesired[r + i];
+	      error	+= difference * difference / nOutputs;
+	    }
+	}
+    }
+
+  return (NumberOfValidationSamples > 0) ? error / NumberOfValidationSamples : 0;
+}
+
+
+
+
+// Copies count samples, by number, into BatchInputs and BatchDesired
+template <typename Real>
+void EpochTrainerT<Real>::GatherSamples(const long* samples, int count)
+{
+  int i;
+  int nInputs  = Set->NumberOfInputs;
+  int nOutputs = Set->NumberOfOutputs;
+
+  for(i=0; i<count; i++)
+    {
+      memcpy(&BatchInputs[(size_t) i * nInputs], Set->Inputs + samples[i] * nInputs,
+	     sizeof(Real) * nInputs);
+      memcpy(&BatchDesired[(size_t) i * nOutputs], Set->Desired + samples[i] * nOutputs,
+	     sizeof(Real) * nOutputs);
+    }
+}
+
+
+
+
+// Copies every layer's weights and bias weights into BestWeights
+template <typename Real>
+void EpochTrainerT<Real>::SaveBest(void)
+{
+  int	 l;
+  size_t weights, biases, offset = 0;
+
+  for(l=0; l<Network->NumberOfLayers-1; l++)
+    {
+      NeuralNetworkLayerT<Real>& layer = Network->Layers[l];
+
+      weights = (size_t) layer.NumberOfNodes * layer.WeightStride;
+      biases  = layer.NumberOfChildNodes;
+
+      BestWeights.resize(offset + weights + biases);
+      memcpy(&BestWeights[offset], layer.Weights, sizeof(Real) * weights);
+      memcpy(&BestWeights[offset + weights], layer.BiasWeights, sizeof(Real) * biases);
+      offset += weights + biases;
+    }
+}
+
+
+
+// Puts back the weights of the best scoring epoch, the ones
+// worth saving, rather than those of the last one trained
+template <typename Real>
+void EpochTrainerT<Real>::RestoreBest(void)
+{
+  int	 l;
+  size_t weights, biases, offset = 0;
+
+  if(BestWeights.empty())
+    {
+      return;
+    }
+
+  for(l=0; l<Network->NumberOfLayers-1; l++)
+    {
+      NeuralNetworkLayerT<Real>& layer = Network->Layers[l];
+
+      weights = (size_t) layer.NumberOfNodes * layer.WeightStride;
+      biases  = layer.NumberOfChildNodes;
+
+      memcpy(layer.Weights, &BestWeights[offset], sizeof(Real) * weights);
+      memcpy(layer.BiasWeights, &BestWeights[offset + weights], sizeof(Real) * biases);
+      offset += weights + biases;
+    }
+}
+
+
+
+// The scalar types networks are built for
+template class EpochTrainerT<float>;
+template class EpochTrainerT<double>;
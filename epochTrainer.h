@@ -0,0 +1,94 @@
+//---------------------------------------------------------------------------
+/*
+  Epoch training for a NeuralNetworkT, with a held out validation set
+  and early stopping. Initialize sets a random share of the training
+  set's samples aside for validation. Each NextEpoch call then trains
+  once on every other sample, in a fresh random order, and scores the
+  network on the validation samples with FeedForwardBatch. Training
+  stops when the validation error hasn't improved for Patience epochs
+  (or after MaxEpochs), and RestoreBest puts back the weights from the
+  epoch that scored best.
+
+  Samples are trained on one at a time, as the online aiTrainer does,
+  unless SetBatching asks for mini-batches (optionally split across
+  threads by a ParallelTrainerT). The split and every epoch's order
+  come from the Philox generator, so the same seed gives the same
+  network.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef EPOCHTRAINER_H
+#define EPOCHTRAINER_H
+
+#include <vector>
+using namespace std;
+
+#include "neuralNet.h"
+#include "parallelTrainer.h"
+#include "trainingSet.h"
+
+
+// An epoch only counts as an improvement if it takes
+// at least this fraction off the best validation error
+#define EPOCH_MIN_IMPROVEMENT 1e-4
+
+// Validation samples are gathered and scored this many at a time
+#define VALIDATION_CHUNK (16 * BATCH_TILE)
+
+
+template <typename Real>
+class EpochTrainerT
+{
+ public:
+  int		MaxEpochs;
+  int		Patience;
+
+  // Progress, as of the last NextEpoch
+  int		Epoch;
+  Real		TrainingError;		// mean over the epoch, before each update
+  Real		ValidationError;	// mean, after the epoch
+  int		BestEpoch;
+  Real		BestError;
+  long		SamplesProcessed;	// trained on, over all epochs
+  double	Seconds;		// spent training and scoring
+
+  long		NumberOfTrainingSamples;
+  long		NumberOfValidationSamples;
+
+  EpochTrainerT();
+
+  void	Initialize(NeuralNetworkT<Real>* network, const TrainingSetT<Real>* trainingSet,
+		   double validationFraction, unsigned long long seed);
+  void	CleanUp(void);
+  void	SetBatching(int batchSize, int numThreads);
+  void	SetStopping(int maxEpochs, int patience);
+  bool	NextEpoch(void);
+  Real	Validate(void);
+  void	RestoreBest(void);
+
+ private:
+  Real	TrainOnline(void);
+  Real	TrainBatched(void);
+  void	GatherSamples(const long* samples, int count);
+  void	SaveBest(void);
+
+  NeuralNetworkT<Real>*		Network;
+  const TrainingSetT<Real>*	Set;
+  ParallelTrainerT<Real>	Parallel;
+  unsigned long long		Seed;
+  int				BatchSize;	// zero for online
+  int				NumberOfThreads;
+
+  vector<long>	TrainingSamples;	// in this epoch's order
+  vector<long>	ValidationSamples;	// in file order
+  vector<Real>	BatchInputs;
+  vector<Real>	BatchDesired;
+  vector<Real>	BatchOutputs;
+  vector<Real>	BestWeights;		// every layer's weights, then biases
+};
+
+
+typedef EpochTrainerT<double>	EpochTrainer;
+typedef EpochTrainerT<float>	EpochTrainerF;
+
+#endif   // EPOCHTRAINER_H
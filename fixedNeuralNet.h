@@ -0,0 +1,395 @@
+//---------------------------------------------------------------------------
+/*
+  A 3 layer feed-forward network whose sizes are fixed at compile time.
+  It computes exactly what NeuralNetwork does with its scalar kernels
+  (within a couple of ulps of the vector ones), but the layer sizes are
+  template parameters, so every loop has a constant trip count the
+  compiler can unroll, and all of the weights and activations live
+  inside the object itself with no heap allocation at all.
+
+  The agent network is always 4-N-1, so for example
+
+    FixedNeuralNetwork<4, 3, 1> brain;
+    brain.ReadData("./brains/trainedBrain_3_HiddenNodes");
+
+  It reads and writes the same text .brain files as NeuralNetwork,
+  and refuses (like NeuralNetwork does with a bad file) to load one
+  whose sizes don't match its own. Binary brains (DumpBinary) it
+  can't read; read those into a NeuralNetwork and use CopyFrom. It
+  only does inference; train with NeuralNetwork and copy the result
+  over with CopyFrom.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef FIXEDNEURALNET_H
+#define FIXEDNEURALNET_H
+
+#include <iostream>
+#include <fstream>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+using namespace std;
+#include <string>
+
+#include "neuralNet.h"
+
+
+template <int In, int Hidden, int Out, typename Real = double>
+class FixedNeuralNetwork
+{
+ public:
+  static constexpr int NumberOfInputs  = In;
+  static constexpr int NumberOfHidden  = Hidden;
+  static constexpr int NumberOfOutputs = Out;
+
+  // NeuralNetwork's bias neurons always hold -1
+  static constexpr Real BiasValue = -1;
+
+  alignas(LAYER_ALIGNMENT) Real InputWeights[In][Hidden];
+  alignas(LAYER_ALIGNMENT) Real InputBiasWeights[Hidden];
+  alignas(LAYER_ALIGNMENT) Real HiddenWeights[Hidden][Out];
+  alignas(LAYER_ALIGNMENT) Real HiddenBiasWeights[Out];
+
+  alignas(LAYER_ALIGNMENT) Real InputValues[In];
+  alignas(LAYER_ALIGNMENT) Real HiddenValues[Hidden];
+  alignas(LAYER_ALIGNMENT) Real OutputValues[Out];
+
+  bool LinearOutput;
+
+  FixedNeuralNetwork()
+    {
+      int i;
+
+      LinearOutput = false;
+
+      for(i=0; i<In; i++)
+	{
+	  InputValues[i] = 0;
+	}
+    }
+
+
+  void SetInput(int i, Real value)
+    {
+      if((i>=0) && (i<In))
+	{
+	  InputValues[i] = value;
+	}
+    }
+
+
+  Real GetOutput(int i) const
+    {
+      if((i>=0) && (i<Out))
+	{
+	  return OutputValues[i];
+	}
+
+      return (Real) INT_MAX; // to indicate an error
+    }
+
+
+  void SetLinearOutput(bool useLinear)
+    {
+      LinearOutput = useLinear;
+    }
+
+
+  // Same arithmetic, in the same order, as NeuralNetwork's
+  // scalar path, so the outputs match it bit for bit
+  void FeedForward(void)
+    {
+      int i, j;
+
+#pragma GCC unroll 16
+      for(j=0; j<Hidden; j++)
+	{
+	  HiddenValues[j] = 0;
+	}
+
+#pragma GCC unroll 16
+      for(i=0; i<In; i++)
+	{
+#pragma GCC unroll 16
+	  for(j=0; j<Hidden; j++)
+	    {
+	      HiddenValues[j] += InputValues[i] * InputWeights[i][j];
+	    }
+	}
+
+#pragma GCC unroll 16
+      for(j=0; j<Hidden; j++)
+	{
+	  HiddenValues[j] = Sigmoid(HiddenValues[j] + BiasValue * InputBiasWeights[j]);
+	}
+
+#pragma GCC unroll 16
+      for(j=0; j<Out; j++)
+	{
+	  OutputValues[j] = 0;
+	}
+
+#pragma GCC unroll 16
+      for(i=0; i<Hidden; i++)
+	{
+#pragma GCC unroll 16
+	  for(j=0; j<Out; j++)
+	    {
+	      OutputValues[j] += HiddenValues[i] * HiddenWeights[i][j];
+	    }
+	}
+
+#pragma GCC unroll 16
+      for(j=0; j<Out; j++)
+	{
+	  OutputValues[j] += BiasValue * HiddenBiasWeights[j];
+
+	  if(!LinearOutput)
+	    {
+	      OutputValues[j] = Sigmoid(OutputValues[j]);
+	    }
+	}
+    }
+
+
+  // Takes the weights from a trained network of the same shape
+  template <typename OtherReal>
+    void CopyFrom(const NeuralNetworkT<OtherReal>& network)
+    {
+      int i, j;
+
+      if((network.NumberOfLayers != 3) ||
+	 (network.Layers[0].NumberOfNodes != In) ||
+	 (network.Layers[1].NumberOfNodes != Hidden) ||
+	 (network.Layers[2].NumberOfNodes != Out))
+	{
+	  cout<<"Error, network shape doesn't match in CopyFrom!"<<endl;
+	  exit(1);
+	}
+
+      const NeuralNetworkLayerT<OtherReal>& inputLayer  = network.Layers[0];
+      const NeuralNetworkLayerT<OtherReal>& hiddenLayer = network.Layers[1];
+      const NeuralNetworkLayerT<OtherReal>& outputLayer = network.Layers[2];
+
+      for(i=0; i<In; i++)
+	{
+	  InputValues[i] = inputLayer.NeuronValues[i];
+
+	  for(j=0; j<Hidden; j++)
+	    {
+	      InputWeights[i][j] = inputLayer.Weights[i * inputLayer.WeightStride + j];
+	    }
+	}
+
+      for(j=0; j<Hidden; j++)
+	{
+	  InputBiasWeights[j] = inputLayer.BiasWeights[j];
+	}
+
+      for(i=0; i<Hidden; i++)
+	{
+	  for(j=0; j<Out; j++)
+	    {
+	      HiddenWeights[i][j] = hiddenLayer.Weights[i * hiddenLayer.WeightStride + j];
+	    }
+	}
+
+      for(j=0; j<Out; j++)
+	{
+	  HiddenBiasWeights[j] = hiddenLayer.BiasWeights[j];
+	  OutputValues[j]      = outputLayer.NeuronValues[j];
+	}
+
+      LinearOutput = outputLayer.LinearOutput;
+    }
+
+
+  // Writes the same text format as NeuralNetwork::DumpData
+  void DumpData(string filename)
+    {
+      int i, j;
+      ofstream brainFile(filename.c_str(), ios::out);
+
+      brainFile<<In<<"\n"<<Hidden<<"\n"<<Out<<"\n";
+
+      brainFile.precision(9);
+      brainFile.setf(ios::fixed);
+
+      for(i=0; i<In; i++)
+	{
+	  brainFile<<(double) InputValues[i]<<"\n";
+	}
+
+      for(i=0; i<In; i++)
+	{
+	  for(j=0; j<Hidden; j++)
+	    {
+	      brainFile<<i<<" "<<j<<" "<<(double) InputWeights[i][j]<<"\n";
+	    }
+	}
+
+      for(j=0; j<Hidden; j++)
+	{
+	  brainFile<<j<<" "<<(double) InputBiasWeights[j]<<"\n";
+	}
+
+      for(i=0; i<Hidden; i++)
+	{
+	  for(j=0; j<Out; j++)
+	    {
+	      brainFile<<i<<" "<<j<<" "<<(double) HiddenWeights[i][j]<<"\n";
+	    }
+	}
+
+      for(j=0; j<Out; j++)
+	{
+	  brainFile<<j<<" "<<(double) HiddenBiasWeights[j]<<"\n";
+	}
+
+      for(i=0; i<Out; i++)
+	{
+	  brainFile<<i<<" "<<(double) OutputValues[i]<<"\n";
+	}
+
+      brainFile.close();
+    }
+
+
+  // Reads a brain file written by NeuralNetwork::DumpData. The
+  // sizes in the file have to match the template parameters.
+  void ReadData(string filename)
+    {
+      int      i, j;
+      int      readIn	  = 0;
+      int      readHidden = 0;
+      int      readOut	  = 0;
+      int      numLayers;
+      string   header;
+
+      if(IsBinaryBrainFile(filename))
+	{
+	  cout<<"Error, "<<filename<<" is a binary brain file, which FixedNeuralNetwork can't read."
+	      <<" Read it into a NeuralNetwork and use CopyFrom!"<<endl;
+	  exit(1);
+	}
+
+      ifstream brainFile(filename.c_str(), ios::in);
+
+      // Networks of other than 3 layers start with a "layers N" line
+      brainFile>>header;
+      if(header == "layers")
+	{
+	  brainFile>>numLayers;
+
+	  if(brainFile && (numLayers != 3))
+	    {
+	      cout<<"Error, "<<filename<<" is a "<<numLayers<<" layer network, expected a "
+		  <<In<<"-"<<Hidden<<"-"<<Out<<" one!"<<endl;
+	      brainFile.close();
+	      exit(1);
+	    }
+
+	  brainFile>>readIn;
+	}
+      else
+	{
+	  readIn = atoi(header.c_str());
+	}
+
+      brainFile>>readHidden>>readOut;
+
+      if(!brainFile || (readIn != In) || (readHidden != Hidden) || (readOut != Out))
+	{
+	  cout<<"Error, "<<filename<<" is a "<<readIn<<"-"<<readHidden<<"-"<<readOut
+	      <<" network, expected "<<In<<"-"<<Hidden<<"-"<<Out<<"!"<<endl;
+	  brainFile.close();
+	  exit(1);
+	}
+
+      for(i=0; i<In; i++)
+	{
+	  InputValues[i] = ReadValue(brainFile);
+	}
+
+      for(i=0; i<In; i++)
+	{
+	  for(j=0; j<Hidden; j++)
+	    {
+	      CheckIndex(brainFile, i, j);
+	      InputWeights[i][j] = ReadValue(brainFile);
+	    }
+	}
+
+      for(j=0; j<Hidden; j++)
+	{
+	  CheckIndex(brainFile, j, -1);
+	  InputBiasWeights[j] = ReadValue(brainFile);
+	}
+
+      for(i=0; i<Hidden; i++)
+	{
+	  for(j=0; j<Out; j++)
+	    {
+	      CheckIndex(brainFile, i, j);
+	      HiddenWeights[i][j] = ReadValue(brainFile);
+	    }
+	}
+
+      for(j=0; j<Out; j++)
+	{
+	  CheckIndex(brainFile, j, -1);
+	  HiddenBiasWeights[j] = ReadValue(brainFile);
+	}
+
+      for(i=0; i<Out; i++)
+	{
+	  CheckIndex(brainFile, i, -1);
+	  OutputValues[i] = ReadValue(brainFile);
+	}
+
+      brainFile.close();
+    }
+
+
+ private:
+  static inline Real Sigmoid(Real x)
+    {
+      return 1.0f/(1+exp(-x));
+    }
+
+
+  // Values are parsed as double, then converted, the
+  // same way NeuralNetworkT<float> does it
+  static Real ReadValue(ifstream& brainFile)
+    {
+      double value;
+
+      brainFile>>value;
+      return (Real) value;
+    }
+
+
+  // Checks the indices at the start of a line. j is -1
+  // for the lines that only carry one index.
+  static void CheckIndex(ifstream& brainFile, int i, int j)
+    {
+      int readI, readJ;
+
+      brainFile>>readI;
+      readJ = j;
+      if(j >= 0)
+	{
+	  brainFile>>readJ;
+	}
+
+      if(!brainFile || (readI != i) || (readJ != j))
+	{
+	  cout<<"Error, bad brainfile in FixedNeuralNetwork::ReadData!"<<endl;
+	  brainFile.close();
+	  exit(1);
+	}
+    }
+};
+
+#endif   // FIXEDNEURALNET_H
@@ -0,0 +1,204 @@
+/*******************************************************************
+Fixed neural network check
+
+Checks FixedNeuralNetwork against NeuralNetwork running its scalar
+kernels, the ones it's built to match (the vector kernels' sigmoid
+is only good to a couple of ulps). For random 4-N-1 networks, in
+double and single precision, and for the trained brains in ./brains,
+both run 100,000 random inputs and have to give exactly the same
+outputs, bit for bit. Both also have to write byte for byte the same
+brain file, and a FixedNeuralNetwork and a NeuralNetwork reading it
+back have to agree again. Prints what went wrong and exits with 1 if
+anything did.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+using namespace std;
+
+#include <stdio.h>
+#include "neuralNet.h"
+#include "fixedNeuralNet.h"
+#include "philoxRandom.h"
+
+
+
+
+// Random inputs each network is run on
+#define CHECK_SAMPLES 100000
+
+// Scratch brain files
+#define CHECK_BRAIN	  "fixedNeuralNetCheck.tmp.brain"
+#define CHECK_FIXED_BRAIN "fixedNeuralNetCheck.tmp.fixed.brain"
+
+
+int failures = 0;
+
+
+
+
+void fail(const string& what)
+{
+  cout<<"Error, "<<what<<endl;
+  failures++;
+}
+
+
+
+
+string readFile(const char* filename)
+{
+  ifstream	file(filename, ios::in | ios::binary);
+  stringstream	contents;
+
+  contents<<file.rdbuf();
+  return contents.str();
+}
+
+
+
+
+// Runs brain and fixed on the same random inputs, and
+// counts the outputs that aren't the same bit for bit
+template <int Hidden, typename Real>
+long countMismatches(NeuralNetworkT<Real>& brain, FixedNeuralNetwork<4, Hidden, 1, Real>& fixed,
+		     unsigned long long seed)
+{
+  PhiloxRandom random(seed, RANDOM_STREAM_SAMPLING);
+  Real	       input, expected, got;
+  long	       s, mismatches = 0;
+  int	       i;
+
+  for (s = 0; s < CHECK_SAMPLES; s++)
+    {
+      for (i = 0; i < 4; i++)
+	{
+	  input = 2 * random.NextDouble() - 1;
+	  brain.SetInput(i, input);
+	  fixed.SetInput(i, input);
+	}
+
+      brain.FeedForward();
+      fixed.FeedForward();
+
+      expected = brain.GetOutput(0);
+      got      = fixed.GetOutput(0);
+
+      if (memcmp(&expected, &got, sizeof(Real)) != 0)
+	mismatches++;
+    }
+
+  return mismatches;
+}
+
+
+
+
+// Checks a FixedNeuralNetwork copied from brain, and one
+// read back from the brain file it writes
+template <int Hidden, typename Real>
+void checkNetwork(NeuralNetworkT<Real>& brain, const string& name)
+{
+  FixedNeuralNetwork<4, Hidden, 1, Real> fixed;
+  FixedNeuralNetwork<4, Hidden, 1, Real> loaded;
+  NeuralNetworkT<Real>			 reloaded;
+  long					 mismatches;
+
+  fixed.CopyFrom(brain);
+
+  mismatches = countMismatches(brain, fixed, Hidden);
+  if (mismatches > 0)
+    fail(name + ": " + to_string(mismatches) + " outputs differ from NeuralNetwork's");
+
+  brain.DumpData(CHECK_BRAIN);
+  fixed.DumpData(CHECK_FIXED_BRAIN);
+
+  if (readFile(CHECK_BRAIN) != readFile(CHECK_FIXED_BRAIN))
+    fail(name + ": DumpData doesn't write the same file as NeuralNetwork's");
+
+  // The file's weights are rounded, so the
+  // two have to agree with each other again
+  loaded.ReadData(CHECK_FIXED_BRAIN);
+  reloaded.ReadData(CHECK_BRAIN);
+
+  mismatches = countMismatches(reloaded, loaded, Hidden + 1);
+  if (mismatches > 0)
+    fail(name + ": " + to_string(mismatches) + " outputs differ after ReadData");
+
+  reloaded.CleanUp();
+  remove(CHECK_BRAIN);
+  remove(CHECK_FIXED_BRAIN);
+}
+
+
+
+
+// A random 4-Hidden-1 network
+template <int Hidden, typename Real>
+void checkRandom(const char* precision)
+{
+  NeuralNetworkT<Real> brain;
+
+  brain.SetRandomSeed(Hidden);
+  brain.Initialize(4, Hidden, 1);
+
+  checkNetwork<Hidden, Real>(brain, "random 4-" + to_string(Hidden) + "-1 " + precision);
+
+  brain.CleanUp();
+}
+
+
+
+
+// One of the trained brains shipped in ./brains
+template <int Hidden>
+void checkTrained(void)
+{
+  NeuralNetwork brain;
+  string	filename = "./brains/trainedBrain_" + to_string(Hidden) + "_HiddenNodes";
+
+  brain.ReadData(filename);
+
+  checkNetwork<Hidden, double>(brain, filename);
+
+  brain.CleanUp();
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  // Before anything picks the kernels
+  setenv("NEURALNET_KERNELS", "scalar", 1);
+
+  checkRandom<1, double>("double");
+  checkRandom<3, double>("double");
+  checkRandom<8, double>("double");
+  checkRandom<32, double>("double");
+  checkRandom<1, float>("float");
+  checkRandom<3, float>("float");
+  checkRandom<8, float>("float");
+  checkRandom<32, float>("float");
+
+  checkTrained<1>();
+  checkTrained<2>();
+  checkTrained<3>();
+  checkTrained<4>();
+  checkTrained<5>();
+
+  if (failures > 0)
+    {
+      cout<<failures<<" fixed neural network checks failed"<<endl;
+      exit(1);
+    }
+
+  cout<<"Fixed neural network checks passed"<<endl;
+  return 0;
+}
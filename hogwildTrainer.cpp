@@ -0,0 +1,200 @@
+#include "hogwildTrainer.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+/*
+  See hogwildTrainer.h. Each step runs one sample through
+  NeuralNetworkT::BackPropagateTile into the thread's own gradient
+  buffer and applies it with ApplyGradients, as the thread's own
+  next update, which clears the buffer again for the next sample.
+*/
+//---------------------------------------------------------------------------
+
+// Allocates bytes rounded up to whole cache lines, so
+// nothing else can end up sharing the buffer's last line.
+static void* AllocateThreadBuffer(size_t bytes)
+{
+  void* memory;
+
+  bytes = ((bytes + LAYER_ALIGNMENT - 1) / LAYER_ALIGNMENT) * LAYER_ALIGNMENT;
+
+  if(posix_memalign(&memory, LAYER_ALIGNMENT, bytes) != 0)
+    {
+      cout<<"Error, unable to allocate hogwild trainer buffers!"<<endl;
+      exit(1);
+    }
+
+  memset(memory, 0, bytes);
+  return memory;
+}
+
+
+
+
+template <typename Real>
+HogwildTrainerT<Real>::HogwildTrainerT()
+{
+  NumberOfThreads = 0;
+  Threads	  = NULL;
+  Network	  = NULL;
+}
+
+
+
+template <typename Real>
+HogwildTrainerT<Real>::~HogwildTrainerT()
+{
+  CleanUp();
+}
+
+
+
+
+// Sets up numThreads threads to train network. The network has to be
+// initialized (or read in) first, and this has to be called again if
+// it changes shape.
+template <typename Real>
+void HogwildTrainerT<Real>::Initialize(NeuralNetworkT<Real>* network, int numThreads)
+{
+  int t;
+
+  CleanUp();
+
+  if(numThreads < 1)
+    {
+      numThreads = 1;
+    }
+
+  Network	  = network;
+  NumberOfThreads = numThreads;
+  Threads	  = new HogwildThreadT<Real>[numThreads];
+
+  for(t=0; t<numThreads; t++)
+    {
+      Threads[t].Scratch   = (Real*) AllocateThreadBuffer(sizeof(Real) * Network->TileScratchSize);
+      Threads[t].Gradients = (Real*) AllocateThreadBuffer(sizeof(Real) * Network->GradientSize);
+      Threads[t].Error	   = 0;
+      Threads[t].Steps	   = 0;
+      Threads[t].Samples   = 0;
+      Threads[t].Seconds   = 0;
+    }
+
+  Pool.Start(numThreads);
+}
+
+
+
+template <typename Real>
+void HogwildTrainerT<Real>::CleanUp(void)
+{
+  int t;
+
+  Pool.Stop();
+
+  if(Threads != NULL)
+    {
+      for(t=0; t<NumberOfThreads; t++)
+	{
+	  free(Threads[t].Scratch);
+	  free(Threads[t].Gradients);
+	}
+      delete[] Threads;
+    }
+
+  NumberOfThreads = 0;
+  Threads	  = NULL;
+  Network	  = NULL;
+}
+
+
+
+
+// Trains on slice number slice of the pass's samples, one sample
+// at a time, with no locking of the shared weights. Thread number
+// t always gets slice number t.
+template <typename Real>
+void HogwildTrainerT<Real>::SliceTask(void* data, int slice, int thread)
+{
+  HogwildTrainerT* trainer	 = (HogwildTrainerT*) data;
+  NeuralNetworkT<Real>* network = trainer->Network;
+  HogwildThreadT<Real>& state	 = trainer->Threads[thread];
+  int	nInputs	 = network->Layers[0].NumberOfNodes;
+  int	nOutputs = network->Layers[network->NumberOfLayers-1].NumberOfNodes;
+  int	first	 = (int) ((long) slice * trainer->PassSamples / trainer->NumberOfThreads);
+  int	last	 = (int) ((long) (slice + 1) * trainer->PassSamples / trainer->NumberOfThreads);
+  int	s;
+  Real	error	 = 0;
+  Timer timer;
+
+  for(s=first; s<last; s++)
+    {
+      network->BackPropagateTile(trainer->PassInputs + (size_t) s * nInputs,
+				 trainer->PassDesired + (size_t) s * nOutputs, 1,
+				 state.Scratch, state.Gradients, error);
+      state.Steps++;
+      network->ApplyGradients(1, state.Gradients, state.Steps);
+    }
+
+  state.Error	+= error;
+  state.Samples += last - first;
+  state.Seconds += timer.total();
+}
+
+
+
+
+// One pass over numSamples samples, split evenly between the threads.
+// Returns the mean error of the samples, each one measured just
+// before the network was trained on it, like the online aiTrainer.
+template <typename Real>
+Real HogwildTrainerT<Real>::TrainPass(const Real* inputs, const Real* desired, int numSamples)
+{
+  int  t;
+  Real error = 0;
+
+  if(numSamples <= 0)
+    {
+      return 0;
+    }
+
+  PassInputs  = inputs;
+  PassDesired = desired;
+  PassSamples = numSamples;
+
+  for(t=0; t<NumberOfThreads; t++)
+    {
+      Threads[t].Error = 0;
+    }
+
+  Pool.RunOnEachThread(SliceTask, this);
+
+  for(t=0; t<NumberOfThreads; t++)
+    {
+      error += Threads[t].Error;
+    }
+
+  return error / numSamples;
+}
+
+
+
+
+// How fast thread number thread has been training, over all passes
+template <typename Real>
+double HogwildTrainerT<Real>::SamplesPerSecond(int thread)
+{
+  if(Threads[thread].Seconds <= 0)
+    {
+      return 0;
+    }
+
+  return Threads[thread].Samples / Threads[thread].Seconds;
+}
+
+
+
+// The scalar types networks are built for
+template class HogwildTrainerT<float>;
+template class HogwildTrainerT<double>;
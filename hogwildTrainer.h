@@ -0,0 +1,81 @@
+//---------------------------------------------------------------------------
+/*
+  Asynchronous, lock-free ("Hogwild") training for a NeuralNetworkT.
+  Every pass over the samples hands each thread its own slice of
+  them, which it trains on one sample at a time, the way the online
+  aiTrainer does, updating the shared weights straight away.
+
+  Nothing is locked. A thread can read weights another thread is
+  halfway through updating, and two updates to the same weight can
+  race so that one of them is lost. With small per-sample updates
+  these races just add a little noise to the descent, which SGD
+  tolerates, and in exchange the threads never wait on each other.
+  The flip side is that, unlike ParallelTrainerT, the result depends
+  on the thread count and the scheduling, and isn't reproducible.
+
+  The activations, errors and gradients each thread works with are
+  its own, in separately allocated buffers padded to whole cache
+  lines. So is each thread's count of the updates it's made, which
+  Adam's bias correction is worked out from, and the layers' own
+  OptimizerSteps are never written (see the ApplyGradients that
+  takes a step). The memory the threads share is the weights and
+  the optimizer's state beside them, momentum's last changes or
+  RMSProp's and Adam's running means, which race the same way the
+  weights do.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef HOGWILDTRAINER_H
+#define HOGWILDTRAINER_H
+
+#include "neuralNet.h"
+#include "threadPool.h"
+
+
+// One thread's buffers and counters. Each one
+// starts on its own cache line, so the threads
+// counting samples don't keep stealing lines.
+template <typename Real>
+struct alignas(LAYER_ALIGNMENT) HogwildThreadT
+{
+  Real*		Scratch;	// tile buffer, only its first row is used
+  Real*		Gradients;	// one sample's gradients
+  Real		Error;		// summed over the current pass
+  long		Steps;		// updates made, for Adam's bias correction
+  long		Samples;	// trained on, over all passes
+  double	Seconds;	// spent training, over all passes
+};
+
+
+template <typename Real>
+class HogwildTrainerT
+{
+ public:
+  int			NumberOfThreads;
+  HogwildThreadT<Real>* Threads;
+
+  HogwildTrainerT();
+  ~HogwildTrainerT();
+
+  void	 Initialize(NeuralNetworkT<Real>* network, int numThreads);
+  void	 CleanUp(void);
+  Real	 TrainPass(const Real* inputs, const Real* desired, int numSamples);
+  double SamplesPerSecond(int thread);
+
+ private:
+  static void SliceTask(void* data, int slice, int thread);
+
+  NeuralNetworkT<Real>* Network;
+  ThreadPool		Pool;
+
+  // The pass being worked on
+  const Real*		PassInputs;
+  const Real*		PassDesired;
+  int			PassSamples;
+};
+
+
+typedef HogwildTrainerT<double>	HogwildTrainer;
+typedef HogwildTrainerT<float>	HogwildTrainerF;
+
+#endif   // HOGWILDTRAINER_H
@@ -0,0 +1,502 @@
+/*******************************************************************
+Neural network benchmarks
+
+Times the network library's main entry points, FeedForward,
+BackPropagate, CalculateError, ReadData and DumpData (and their
+batched and binary counterparts), over a range of topologies from
+the 4-1-1 the simulation was first built with up to wide hidden
+layers, and over a range of batch sizes. For the 4-N-1 topologies
+FixedNeuralNetwork's FeedForward is timed beside NeuralNetwork's.
+
+For the topologies a brain for the simulation can have (WORLD_INPUTS
+inputs, one output) the simulation itself is timed too, one World
+with its own context and then WorldBatches of up to 4096 worlds.
+
+Every benchmark reports the time per sample, samples per second and
+heap allocations per call. For the file benchmarks a "sample" is a
+whole call, reading or writing the entire brain, and for the world
+benchmarks it's one world stepped once. Everything runs on the one
+thread, so samples per second are per core. Results go to the
+screen as a table, and with -csv to a CSV file as well, which is the
+one to keep and compare between commits (make bench names it after
+the commit it was built from).
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdio.h>
+#include "neuralNet.h"
+#include "fixedNeuralNet.h"
+#include "philoxRandom.h"
+#include "timer.h"
+#include "world.h"
+#include "worldBatch.h"
+
+
+
+
+// Every call to malloc, calloc or realloc anywhere in the program,
+// operator new included, is counted on its way through to glibc's
+// allocator. The network's own storage comes from mmap and isn't
+// counted: that's one block per Initialize or ReadData, not per
+// sample.
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* memory, size_t size);
+
+static long allocationCount = 0;
+
+extern "C" void* malloc(size_t size)
+{
+  allocationCount++;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+  allocationCount++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* memory, size_t size)
+{
+  allocationCount++;
+  return __libc_realloc(memory, size);
+}
+
+
+
+
+// The topologies and batch sizes benchmarked
+static const char* topologies[] =
+  {
+    "4-1-1",
+    "4-5-1",
+    "4-32-1",
+    "4-64-64-1",
+    "32-256-256-4",
+    "64-1024-8"
+  };
+
+static const int batchSizes[] = { 1, 16, 64, 256 };
+static const int worldCounts[] = { 64, 1024, 4096 };
+
+#define NUM_TOPOLOGIES	 (sizeof(topologies) / sizeof(topologies[0]))
+#define NUM_BATCH_SIZES	 (sizeof(batchSizes) / sizeof(batchSizes[0]))
+#define NUM_WORLD_COUNTS (sizeof(worldCounts) / sizeof(worldCounts[0]))
+
+// Scratch brain file for the file benchmarks
+#define BENCHMARK_BRAIN "neuralBenchmark.tmp.brain"
+
+
+// Settings, from the command line
+double	 minimumTime  = 0.1;
+bool	 runDouble    = true;
+bool	 runFloat     = true;
+string	 csvFilename;
+string	 label	      = "";
+ofstream csvFile;
+
+
+
+// What a benchmark measured
+struct BenchResult
+{
+  double NanosecondsPerSample;
+  double SamplesPerSecond;
+  double AllocationsPerCall;
+};
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"neuralBenchmark [options]"<<endl<<endl;
+  cout<<"Options:"<<endl;
+  cout<<"  -time S    Run each benchmark for at least S seconds (default "<<minimumTime<<")"<<endl;
+  cout<<"  -double    Only benchmark double precision networks"<<endl;
+  cout<<"  -float     Only benchmark single precision networks"<<endl;
+  cout<<"  -csv F     Also write the results to the CSV file F"<<endl;
+  cout<<"  -label L   Label the CSV results with L, e.g. a commit id"<<endl;
+}
+
+
+
+
+// Turns "4-8-1" into { 4, 8, 1 }
+vector<int> parseTopology(const char* topology)
+{
+  vector<int> sizes;
+  const char* next = topology;
+
+  while (*next != '\0')
+    {
+      sizes.push_back(atoi(next));
+
+      next = strchr(next, '-');
+      if (next == NULL)
+	break;
+      next++;
+    }
+
+  return sizes;
+}
+
+
+
+
+// Calls run, which handles samplesPerCall samples a call, once to
+// warm up and then in ever bigger runs until a run takes at least
+// minimumTime, and reports on the last run
+template <typename Run>
+BenchResult measure(Run run, int samplesPerCall)
+{
+  BenchResult result;
+  Timer	      timer;
+  long	      calls, c, allocations;
+  double      seconds;
+
+  run();
+
+  for (calls = 1; ; calls *= 2)
+    {
+      allocations = allocationCount;
+      timer.reset();
+
+      for (c = 0; c < calls; c++)
+	{
+	  run();
+	}
+
+      seconds	  = timer.total();
+      allocations = allocationCount - allocations;
+
+      if (seconds >= minimumTime)
+	break;
+    }
+
+  result.NanosecondsPerSample = seconds * 1e9 / ((double) calls * samplesPerCall);
+  result.SamplesPerSecond     = (double) calls * samplesPerCall / seconds;
+  result.AllocationsPerCall   = (double) allocations / calls;
+
+  return result;
+}
+
+
+
+
+// Prints a result, and writes it to the CSV file if there is one
+void report(const char* benchmark, const char* precision, const char* kernels,
+	    const char* topology, int batch, const BenchResult& result)
+{
+  cout<<left<<setw(18)<<benchmark<<setw(8)<<precision<<setw(16)<<topology<<right
+      <<setw(6)<<batch<<setw(14)<<fixed<<setprecision(1)<<result.NanosecondsPerSample
+      <<setw(16)<<setprecision(0)<<result.SamplesPerSecond
+      <<setw(10)<<setprecision(2)<<result.AllocationsPerCall<<endl;
+
+  if (csvFile.is_open())
+    {
+      csvFile<<label<<","<<benchmark<<","<<precision<<","<<kernels<<","<<topology<<","
+	     <<batch<<","<<setprecision(3)<<result.NanosecondsPerSample<<","
+	     <<setprecision(0)<<result.SamplesPerSecond<<","
+	     <<setprecision(3)<<result.AllocationsPerCall<<"\n";
+    }
+}
+
+
+
+
+// FeedForward on a FixedNeuralNetwork<4, Hidden, 1>, with the same
+// weights and inputs as NeuralNetwork's FeedForward gets
+template <int Hidden, typename Real>
+void benchmarkFixedSize(const char* topology, const char* precision)
+{
+  NeuralNetworkT<Real>			    brain;
+  FixedNeuralNetwork<4, Hidden, 1, Real> fixed;
+  int					    maxBatch = batchSizes[NUM_BATCH_SIZES - 1];
+  vector<Real>				    inputs(maxBatch * 4);
+  PhiloxRandom				    random(1, RANDOM_STREAM_SAMPLING);
+  int					    i;
+  long					    next     = 0;
+  Real					    sum	     = 0;
+
+  brain.SetRandomSeed(1);
+  brain.Initialize(4, Hidden, 1);
+  fixed.CopyFrom(brain);
+
+  for (i = 0; i < maxBatch * 4; i++)
+    inputs[i] = random.NextDouble();
+
+  report("FixedFeedForward", precision, "fixed", topology, 1,
+	 measure([&]()
+		 {
+		   for (int k = 0; k < 4; k++)
+		     fixed.SetInput(k, inputs[next * 4 + k]);
+		   next = (next + 1) % maxBatch;
+		   fixed.FeedForward();
+		   sum += fixed.GetOutput(0);
+		 }, 1));
+
+  brain.CleanUp();
+
+  // Keeps the outputs from being optimized away
+  if (sum != sum)
+    cout<<"(NaN outputs)"<<endl;
+}
+
+
+
+// FixedNeuralNetwork's sizes are template parameters, so it can
+// only be timed for the 4-N-1 topologies in the table listed here
+template <typename Real>
+void benchmarkFixed(const char* topology, const char* precision)
+{
+  if (strcmp(topology, "4-1-1") == 0)
+    benchmarkFixedSize<1, Real>(topology, precision);
+  else if (strcmp(topology, "4-5-1") == 0)
+    benchmarkFixedSize<5, Real>(topology, precision);
+  else if (strcmp(topology, "4-32-1") == 0)
+    benchmarkFixedSize<32, Real>(topology, precision);
+}
+
+
+
+
+// Every benchmark of one topology, in Real precision
+template <typename Real>
+void benchmarkTopology(const char* topology, const char* precision)
+{
+  NeuralNetworkT<Real> brain;
+  NeuralNetworkT<Real> loaded;
+  vector<int>	       layerSizes = parseTopology(topology);
+  int		       nInputs	  = layerSizes.front();
+  int		       nOutputs	  = layerSizes.back();
+  int		       maxBatch	  = batchSizes[NUM_BATCH_SIZES - 1];
+  vector<Real>	       inputs(maxBatch * nInputs);
+  vector<Real>	       desired(maxBatch * nOutputs);
+  vector<Real>	       outputs(maxBatch * nOutputs);
+  PhiloxRandom	       random(1, RANDOM_STREAM_SAMPLING);
+  const char*	       kernels	  = GetNeuralKernels<Real>().Name;
+  unsigned int	       b;
+  int		       i, batch;
+  long		       next	  = 0;
+  Real		       error	  = 0;
+
+  brain.SetRandomSeed(1);
+  brain.Initialize(layerSizes.size(), &layerSizes[0]);
+  brain.SetLearningRate(0.001);
+  brain.SetMomentum(true, 0.9);
+
+  for (i = 0; i < maxBatch * nInputs; i++)
+    inputs[i] = random.NextDouble();
+  for (i = 0; i < maxBatch * nOutputs; i++)
+    desired[i] = random.NextDouble();
+
+  // One sample at a time, through the network's own neuron values,
+  // cycling through the samples so the inputs keep changing
+  auto setSample = [&]()
+    {
+      for (int k = 0; k < nInputs; k++)
+	brain.SetInput(k, inputs[next * nInputs + k]);
+      for (int k = 0; k < nOutputs; k++)
+	brain.SetDesiredOutput(k, desired[next * nOutputs + k]);
+      next = (next + 1) % maxBatch;
+    };
+
+  report("FeedForward", precision, kernels, topology, 1,
+	 measure([&]() { setSample(); brain.FeedForward(); }, 1));
+
+  benchmarkFixed<Real>(topology, precision);
+
+  report("BackPropagate", precision, kernels, topology, 1,
+	 measure([&]() { setSample(); brain.FeedForward(); brain.BackPropagate(); }, 1));
+
+  setSample();
+  brain.FeedForward();
+  report("CalculateError", precision, kernels, topology, 1,
+	 measure([&]() { error += brain.CalculateError(); }, 1));
+
+  for (b = 1; b < NUM_BATCH_SIZES; b++)
+    {
+      batch = batchSizes[b];
+
+      report("FeedForwardBatch", precision, kernels, topology, batch,
+	     measure([&]() { brain.FeedForwardBatch(&inputs[0], batch, &outputs[0]); }, batch));
+    }
+
+  for (b = 1; b < NUM_BATCH_SIZES; b++)
+    {
+      batch = batchSizes[b];
+
+      report("BackPropBatch", precision, kernels, topology, batch,
+	     measure([&]() { error += brain.BackPropagateBatch(&inputs[0], &desired[0], batch); }, batch));
+    }
+
+  report("DumpData", precision, kernels, topology, 1,
+	 measure([&]() { brain.DumpData(BENCHMARK_BRAIN); }, 1));
+
+  report("ReadData", precision, kernels, topology, 1,
+	 measure([&]() { loaded.ReadData(BENCHMARK_BRAIN); }, 1));
+
+  report("DumpBinary", precision, kernels, topology, 1,
+	 measure([&]() { brain.DumpBinary(BENCHMARK_BRAIN); }, 1));
+
+  report("ReadBinary", precision, kernels, topology, 1,
+	 measure([&]() { loaded.ReadBinary(BENCHMARK_BRAIN); }, 1));
+
+  loaded.CleanUp();
+  brain.CleanUp();
+  remove(BENCHMARK_BRAIN);
+
+  // Keeps the error sums from being optimized away
+  if (error != error)
+    cout<<"(NaN errors)"<<endl;
+}
+
+
+
+
+// Stepping simulated worlds with a brain of the given topology, which
+// must have WORLD_INPUTS inputs and one output. Whenever a box comes
+// down another is dropped, from a random place, so every world
+// always has a box falling and a brain to run.
+void benchmarkWorlds(const char* topology)
+{
+  NeuralNetworkF	brain;
+  NeuralNetworkContextF context;
+  World			world;
+  WorldBatch		worlds;
+  vector<int>		layerSizes = parseTopology(topology);
+  PhiloxRandom		random(1, RANDOM_STREAM_SAMPLING);
+  const char*		kernels	   = GetNeuralKernels<float>().Name;
+  unsigned int		c;
+  int			count;
+
+  brain.SetRandomSeed(1);
+  brain.Initialize(layerSizes.size(), &layerSizes[0]);
+  context.Initialize(brain);
+
+  auto randomColor = [&]()
+    {
+      return (random.NextBelow(2) == 0) ? BLUE : RED;
+    };
+
+  report("WorldStep", "float", kernels, topology, 1,
+	 measure([&]()
+		 {
+		   if (!world.BoxActive)
+		     world.DropBox(randomColor(), 3 + random.NextBelow(195), 20 + random.NextBelow(130));
+		   world.Step(&context);
+		 }, 1));
+
+  for (c = 0; c < NUM_WORLD_COUNTS; c++)
+    {
+      count = worldCounts[c];
+      worlds.Initialize(count);
+
+      report("WorldBatch", "float", kernels, topology, count,
+	     measure([&]()
+		     {
+		       for (int w = 0; w < count; w++)
+			 {
+			   if (!worlds.BoxActive[w])
+			     worlds.DropBox(w, randomColor(), 3 + random.NextBelow(195), 20 + random.NextBelow(130));
+			 }
+		       worlds.Step(brain);
+		     }, count));
+    }
+
+  worlds.CleanUp();
+  context.CleanUp();
+  brain.CleanUp();
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  unsigned int t;
+
+  for (int i = 1; i < argc; i++)
+    {
+      if ((strcmp(argv[i], "-time") == 0) && (i+1 < argc))
+	{
+	  minimumTime = atof(argv[++i]);
+	}
+      else if (strcmp(argv[i], "-double") == 0)
+	{
+	  runFloat = false;
+	}
+      else if (strcmp(argv[i], "-float") == 0)
+	{
+	  runDouble = false;
+	}
+      else if ((strcmp(argv[i], "-csv") == 0) && (i+1 < argc))
+	{
+	  csvFilename = argv[++i];
+	}
+      else if ((strcmp(argv[i], "-label") == 0) && (i+1 < argc))
+	{
+	  label = argv[++i];
+	}
+      else
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+    }
+
+  if (!csvFilename.empty())
+    {
+      csvFile.open(csvFilename.c_str(), ios::out);
+      if (!csvFile)
+	{
+	  cout<<"Error, unable to write "<<csvFilename<<"!"<<endl;
+	  exit(1);
+	}
+
+      csvFile<<"label,benchmark,precision,kernels,topology,batch,"
+	     <<"ns_per_sample,samples_per_sec,allocs_per_call\n"<<fixed;
+    }
+
+  cout<<left<<setw(18)<<"benchmark"<<setw(8)<<"type"<<setw(16)<<"topology"<<right
+      <<setw(6)<<"batch"<<setw(14)<<"ns/sample"<<setw(16)<<"samples/sec"
+      <<setw(10)<<"allocs"<<endl;
+
+  for (t = 0; t < NUM_TOPOLOGIES; t++)
+    {
+      if (runDouble)
+	benchmarkTopology<double>(topologies[t], "double");
+      if (runFloat)
+	benchmarkTopology<float>(topologies[t], "float");
+    }
+
+  for (t = 0; t < NUM_TOPOLOGIES; t++)
+    {
+      vector<int> layerSizes = parseTopology(topologies[t]);
+
+      if (runFloat && (layerSizes.front() == WORLD_INPUTS) && (layerSizes.back() == 1))
+	benchmarkWorlds(topologies[t]);
+    }
+
+  if (csvFile.is_open())
+    {
+      csvFile.close();
+      cout<<"Results written to "<<csvFilename<<endl;
+    }
+
+  return 0;
+}
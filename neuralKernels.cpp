@@ -0,0 +1,722 @@
+#include "neuralKernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NEURALNET_X86 1
+#include <immintrin.h>
+#endif
+
+//---------------------------------------------------------------------------
+/*
+  Scalar, SSE2 and AVX2 versions of the neural network inner loops.
+  See neuralKernels.h for how they are chosen, and how closely the
+  vector versions track the scalar ones. The vector kernels themselves
+  live in neuralKernelsSimd.h, and are instantiated here once for each
+  instruction set and scalar type.
+*/
+//---------------------------------------------------------------------------
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Scalar kernels
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename Real>
+static void ScalarAxpy(Real a, const Real* x, Real* y, int n)
+{
+  int j;
+
+  for(j=0; j<n; j++)
+    {
+      y[j] += a * x[j];
+    }
+}
+
+
+
+template <typename Real>
+static Real ScalarDot(const Real* a, const Real* b, int n)
+{
+  int  j;
+  Real sum = 0;
+
+  for(j=0; j<n; j++)
+    {
+      sum += a[j] * b[j];
+    }
+
+  return sum;
+}
+
+
+
+template <typename Real>
+static void ScalarSigmoid(Real* v, int n)
+{
+  int j;
+
+  for(j=0; j<n; j++)
+    {
+      v[j] = 1.0f/(1+exp(-v[j]));
+    }
+}
+
+
+
+// The interpolated sigmoid table covers -FAST_SIGMOID_RANGE to
+// FAST_SIGMOID_RANGE in steps of 1/FAST_SIGMOID_STEPS. It has one
+// entry past the end, so the top of the range can still interpolate.
+#define FAST_SIGMOID_RANGE	16
+#define FAST_SIGMOID_STEPS	32
+#define FAST_SIGMOID_ENTRIES	(2 * FAST_SIGMOID_RANGE * FAST_SIGMOID_STEPS + 2)
+
+template <typename Real>
+struct FastSigmoidTable
+{
+  Real Values[FAST_SIGMOID_ENTRIES];
+
+  FastSigmoidTable()
+  {
+    int	   k;
+    double x;
+
+    for(k=0; k<FAST_SIGMOID_ENTRIES; k++)
+      {
+	x	  = (double) k / FAST_SIGMOID_STEPS - FAST_SIGMOID_RANGE;
+	Values[k] = (Real) (1.0 / (1.0 + exp(-x)));
+      }
+  }
+};
+
+
+// Built the first time any table sigmoid runs
+template <typename Real>
+static const Real* GetFastSigmoidTable(void)
+{
+  static const FastSigmoidTable<Real> table;
+
+  return table.Values;
+}
+
+
+
+// The comparisons are written the way minpd/maxpd work, so a
+// value clamps exactly as it does in the vector kernels.
+template <typename Real>
+static inline void ScalarSigmoidTable(Real* v, int n)
+{
+  int	      j, whole;
+  Real	      x, t;
+  const Real  range = FAST_SIGMOID_RANGE;
+  const Real  steps = FAST_SIGMOID_STEPS;
+  const Real* table = GetFastSigmoidTable<Real>();
+
+  for(j=0; j<n; j++)
+    {
+      x = v[j];
+      x = (x > -range) ? x : -range;
+      x = (x < range) ? x : range;
+
+      t	    = (x + range) * steps;
+      whole = (int) t;
+      v[j]  = table[whole] + (t - (Real) whole) * (table[whole+1] - table[whole]);
+    }
+}
+
+
+
+// tanh(h) is approximated by h * N(h^2) / D(h^2), its [9/8] Pade
+// approximant, with the coefficients highest power first. Past
+// TANH_CLAMP the approximation is no better than +-1, so h is
+// clamped there.
+#define TANH_TERMS 5
+#define TANH_CLAMP 6.25
+
+static const double TanhNumerator[TANH_TERMS] =
+  {
+    1.0, 990.0, 135135.0, 4729725.0, 34459425.0
+  };
+
+static const double TanhDenominator[TANH_TERMS] =
+  {
+    45.0, 13860.0, 945945.0, 16216200.0, 34459425.0
+  };
+
+
+template <typename Real>
+static inline void ScalarSigmoidRational(Real* v, int n)
+{
+  int  j, k;
+  Real h, h2, num, den, t;
+  const Real limit = TANH_CLAMP;
+  const Real half  = 0.5;
+  const Real one   = 1;
+
+  for(j=0; j<n; j++)
+    {
+      h = v[j] * half;
+      h = (h > -limit) ? h : -limit;
+      h = (h < limit) ? h : limit;
+      h2 = h * h;
+
+      num = (Real) TanhNumerator[0];
+      den = (Real) TanhDenominator[0];
+      for(k=1; k<TANH_TERMS; k++)
+	{
+	  num = num * h2 + (Real) TanhNumerator[k];
+	  den = den * h2 + (Real) TanhDenominator[k];
+	}
+
+      t = (h * num) / den;
+      t = (t > -one) ? t : -one;
+      t = (t < one) ? t : one;
+
+      v[j] = half + half * t;
+    }
+}
+
+
+
+template <typename Real>
+static void ScalarGemm(const Real* a, int lda, const Real* b, int ldb,
+		       Real* c, int ldc, int rows, int inner, int cols)
+{
+  int r, i, j;
+
+  for(r=0; r<rows; r++)
+    {
+      for(j=0; j<cols; j++)
+	{
+	  c[r * ldc + j] = 0;
+	}
+
+      for(i=0; i<inner; i++)
+	{
+	  ScalarAxpy(a[r * lda + i], b + i * ldb, c + r * ldc, cols);
+	}
+    }
+}
+
+
+
+template <typename Real>
+static void ScalarGemmTransA(const Real* a, int lda, const Real* b, int ldb,
+			     Real* c, int ldc, int rows, int aCols, int bCols)
+{
+  int r, i;
+
+  for(r=0; r<rows; r++)
+    {
+      for(i=0; i<aCols; i++)
+	{
+	  ScalarAxpy(a[r * lda + i], b + r * ldb, c + i * ldc, bCols);
+	}
+    }
+}
+
+
+
+template <typename Real>
+static void ScalarMomentumUpdate(Real* w, Real* changes, const Real* errors,
+				 Real rate, Real x, Real momentum, int n)
+{
+  int  j;
+  Real dw;
+
+  for(j=0; j<n; j++)
+    {
+      dw = rate * errors[j] * x;
+      w[j] += dw + momentum * changes[j];
+      changes[j] = dw;
+    }
+}
+
+
+
+template <typename Real>
+static void ScalarRmsPropUpdate(Real* w, Real* moments, const Real* errors,
+				Real rate, Real x, Real decay, Real epsilon, int n)
+{
+  int  j;
+  Real g;
+  Real keep = 1 - decay;
+
+  for(j=0; j<n; j++)
+    {
+      g		 = errors[j] * x;
+      moments[j] = decay * moments[j] + keep * (g * g);
+      w[j]	+= (rate * g) / ((Real) sqrt(moments[j]) + epsilon);
+    }
+}
+
+
+
+template <typename Real>
+static void ScalarAdamUpdate(Real* w, Real* means, Real* moments, const Real* errors,
+			     Real rate, Real x, Real beta1, Real beta2, Real epsilon, int n)
+{
+  int  j;
+  Real g;
+  Real keep1 = 1 - beta1;
+  Real keep2 = 1 - beta2;
+
+  for(j=0; j<n; j++)
+    {
+      g		 = errors[j] * x;
+      means[j]	 = beta1 * means[j] + keep1 * g;
+      moments[j] = beta2 * moments[j] + keep2 * (g * g);
+      w[j]	+= (rate * means[j]) / ((Real) sqrt(moments[j]) + epsilon);
+    }
+}
+
+
+
+template <typename Real>
+static const NeuralKernels<Real>* ScalarTable(void)
+{
+  static const NeuralKernels<Real> kernels =
+    {
+      "scalar",
+      ScalarAxpy<Real>,
+      ScalarDot<Real>,
+      ScalarSigmoid<Real>,
+      ScalarSigmoidTable<Real>,
+      ScalarSigmoidRational<Real>,
+      ScalarGemm<Real>,
+      ScalarGemmTransA<Real>,
+      ScalarMomentumUpdate<Real>,
+      ScalarRmsPropUpdate<Real>,
+      ScalarAdamUpdate<Real>
+    };
+
+  return &kernels;
+}
+
+
+
+
+static int ScalarDotInt16(const short* a, const short* b, int n)
+{
+  int j;
+  int sum = 0;
+
+  for(j=0; j<n; j++)
+    {
+      sum += a[j] * b[j];
+    }
+
+  return sum;
+}
+
+
+static const QuantizedKernels scalarQuantizedKernels =
+  {
+    "scalar",
+    ScalarDotInt16
+  };
+
+
+
+
+#ifdef NEURALNET_X86
+
+// Constants for the vectorized exp(). The ln(2) splits are the usual
+// Cephes ones, and the series are long enough that truncation is
+// below the type's rounding error for |r| <= ln(2)/2.
+struct DoubleExpConstants
+{
+  static constexpr double ExpMax = 709.0;
+  static constexpr double ExpMin = -708.0;
+  static constexpr double Log2e  = 1.4426950408889634074;
+  static constexpr double Ln2Hi  = 6.93145751953125e-1;
+  static constexpr double Ln2Lo  = 1.42860682030941723212e-6;
+
+  static const int	  ExpTerms = 14;
+  static constexpr double ExpCoefficients[ExpTerms] =
+    {
+      1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0,
+      1.0 / 3628800.0,	  1.0 / 362880.0,    1.0 / 40320.0,
+      1.0 / 5040.0,	  1.0 / 720.0,	     1.0 / 120.0,
+      1.0 / 24.0,	  1.0 / 6.0,	     1.0 / 2.0,
+      1.0,		  1.0
+    };
+};
+
+struct FloatExpConstants
+{
+  static constexpr float ExpMax = 88.0f;
+  static constexpr float ExpMin = -87.0f;
+  static constexpr float Log2e  = 1.44269504088896341f;
+  static constexpr float Ln2Hi  = 0.693359375f;
+  static constexpr float Ln2Lo  = -2.12194440e-4f;
+
+  static const int	 ExpTerms = 8;
+  static constexpr float ExpCoefficients[ExpTerms] =
+    {
+      1.0f / 5040.0f, 1.0f / 720.0f, 1.0f / 120.0f, 1.0f / 24.0f,
+      1.0f / 6.0f,    1.0f / 2.0f,   1.0f,	    1.0f
+    };
+};
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// SSE2 kernels, two doubles or four floats at a time
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+namespace Sse2
+{
+  template <typename Real> struct Traits;
+
+  template <> struct Traits<double> : DoubleExpConstants
+  {
+    typedef double  Real;
+    typedef __m128d Vec;
+    static const int Width = 2;
+
+    static inline Vec Zero()			  { return _mm_setzero_pd(); }
+    static inline Vec Set1(Real a)		  { return _mm_set1_pd(a); }
+    static inline Vec Load(const Real* p)	  { return _mm_loadu_pd(p); }
+    static inline void Store(Real* p, Vec a)	  { _mm_storeu_pd(p, a); }
+    static inline Vec Add(Vec a, Vec b)		  { return _mm_add_pd(a, b); }
+    static inline Vec Sub(Vec a, Vec b)		  { return _mm_sub_pd(a, b); }
+    static inline Vec Mul(Vec a, Vec b)		  { return _mm_mul_pd(a, b); }
+    static inline Vec Div(Vec a, Vec b)		  { return _mm_div_pd(a, b); }
+    static inline Vec Sqrt(Vec a)		  { return _mm_sqrt_pd(a); }
+    static inline Vec Min(Vec a, Vec b)		  { return _mm_min_pd(a, b); }
+    static inline Vec Max(Vec a, Vec b)		  { return _mm_max_pd(a, b); }
+
+    // cvtpd rounds to nearest, which is exactly what we want
+    static inline Vec Round(Vec a)		  { return _mm_cvtepi32_pd(_mm_cvtpd_epi32(a)); }
+    static inline Vec Truncate(Vec a)		  { return _mm_cvtepi32_pd(_mm_cvttpd_epi32(a)); }
+
+    // No gather instruction before AVX2, so the lanes are fetched one by one
+    static inline Vec Gather(const Real* table, Vec index)
+    {
+      int k[4];
+
+      _mm_storeu_si128((__m128i*) k, _mm_cvttpd_epi32(index));
+      return _mm_set_pd(table[k[1]], table[k[0]]);
+    }
+
+    // The biased exponent goes in the top 32 bits of each lane
+    static inline Vec Pow2(Vec n)
+    {
+      __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvtpd_epi32(n), _mm_set1_epi32(1023)), 20);
+      return _mm_castsi128_pd(_mm_unpacklo_epi32(_mm_setzero_si128(), bits));
+    }
+  };
+
+  template <> struct Traits<float> : FloatExpConstants
+  {
+    typedef float  Real;
+    typedef __m128 Vec;
+    static const int Width = 4;
+
+    static inline Vec Zero()			  { return _mm_setzero_ps(); }
+    static inline Vec Set1(Real a)		  { return _mm_set1_ps(a); }
+    static inline Vec Load(const Real* p)	  { return _mm_loadu_ps(p); }
+    static inline void Store(Real* p, Vec a)	  { _mm_storeu_ps(p, a); }
+    static inline Vec Add(Vec a, Vec b)		  { return _mm_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)		  { return _mm_sub_ps(a, b); }
+    static inline Vec Mul(Vec a, Vec b)		  { return _mm_mul_ps(a, b); }
+    static inline Vec Div(Vec a, Vec b)		  { return _mm_div_ps(a, b); }
+    static inline Vec Sqrt(Vec a)		  { return _mm_sqrt_ps(a); }
+    static inline Vec Min(Vec a, Vec b)		  { return _mm_min_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)		  { return _mm_max_ps(a, b); }
+    static inline Vec Round(Vec a)		  { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+    static inline Vec Truncate(Vec a)		  { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+
+    static inline Vec Gather(const Real* table, Vec index)
+    {
+      int k[4];
+
+      _mm_storeu_si128((__m128i*) k, _mm_cvttps_epi32(index));
+      return _mm_set_ps(table[k[3]], table[k[2]], table[k[1]], table[k[0]]);
+    }
+
+    static inline Vec Pow2(Vec n)
+    {
+      __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23);
+      return _mm_castsi128_ps(bits);
+    }
+  };
+
+#include "neuralKernelsSimd.h"
+
+  // pmaddwd multiplies pairs of 16 bit values and adds
+  // each pair into a 32 bit lane, eight products at a time
+  static int DotInt16(const short* a, const short* b, int n)
+  {
+    int	    j;
+    int	    lanes[4];
+    __m128i sum = _mm_setzero_si128();
+
+    for(j=0; j<n; j+=8)
+      {
+	sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i*) (a+j)),
+						_mm_loadu_si128((const __m128i*) (b+j))));
+      }
+
+    _mm_storeu_si128((__m128i*) lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  }
+
+  static const QuantizedKernels quantizedKernels =
+    {
+      "sse2",
+      DotInt16
+    };
+}
+
+#pragma GCC pop_options
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels, four doubles or eight floats at a time. FMA is
+// deliberately not enabled, so the per-element kernels round
+// exactly like the scalar ones.
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace Avx2
+{
+  template <typename Real> struct Traits;
+
+  template <> struct Traits<double> : DoubleExpConstants
+  {
+    typedef double  Real;
+    typedef __m256d Vec;
+    static const int Width = 4;
+
+    static inline Vec Zero()			  { return _mm256_setzero_pd(); }
+    static inline Vec Set1(Real a)		  { return _mm256_set1_pd(a); }
+    static inline Vec Load(const Real* p)	  { return _mm256_loadu_pd(p); }
+    static inline void Store(Real* p, Vec a)	  { _mm256_storeu_pd(p, a); }
+    static inline Vec Add(Vec a, Vec b)		  { return _mm256_add_pd(a, b); }
+    static inline Vec Sub(Vec a, Vec b)		  { return _mm256_sub_pd(a, b); }
+    static inline Vec Mul(Vec a, Vec b)		  { return _mm256_mul_pd(a, b); }
+    static inline Vec Div(Vec a, Vec b)		  { return _mm256_div_pd(a, b); }
+    static inline Vec Sqrt(Vec a)		  { return _mm256_sqrt_pd(a); }
+    static inline Vec Min(Vec a, Vec b)		  { return _mm256_min_pd(a, b); }
+    static inline Vec Max(Vec a, Vec b)		  { return _mm256_max_pd(a, b); }
+
+    static inline Vec Round(Vec a)
+    {
+      return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+
+    static inline Vec Truncate(Vec a)
+    {
+      return _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    }
+
+    static inline Vec Gather(const Real* table, Vec index)
+    {
+      return _mm256_i32gather_pd(table, _mm256_cvttpd_epi32(index), 8);
+    }
+
+    // 2^n, built straight into the exponent field
+    static inline Vec Pow2(Vec n)
+    {
+      __m256i bits = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+      bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+      return _mm256_castsi256_pd(bits);
+    }
+  };
+
+  template <> struct Traits<float> : FloatExpConstants
+  {
+    typedef float  Real;
+    typedef __m256 Vec;
+    static const int Width = 8;
+
+    static inline Vec Zero()			  { return _mm256_setzero_ps(); }
+    static inline Vec Set1(Real a)		  { return _mm256_set1_ps(a); }
+    static inline Vec Load(const Real* p)	  { return _mm256_loadu_ps(p); }
+    static inline void Store(Real* p, Vec a)	  { _mm256_storeu_ps(p, a); }
+    static inline Vec Add(Vec a, Vec b)		  { return _mm256_add_ps(a, b); }
+    static inline Vec Sub(Vec a, Vec b)		  { return _mm256_sub_ps(a, b); }
+    static inline Vec Mul(Vec a, Vec b)		  { return _mm256_mul_ps(a, b); }
+    static inline Vec Div(Vec a, Vec b)		  { return _mm256_div_ps(a, b); }
+    static inline Vec Sqrt(Vec a)		  { return _mm256_sqrt_ps(a); }
+    static inline Vec Min(Vec a, Vec b)		  { return _mm256_min_ps(a, b); }
+    static inline Vec Max(Vec a, Vec b)		  { return _mm256_max_ps(a, b); }
+
+    static inline Vec Round(Vec a)
+    {
+      return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+
+    static inline Vec Truncate(Vec a)
+    {
+      return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    }
+
+    static inline Vec Gather(const Real* table, Vec index)
+    {
+      return _mm256_i32gather_ps(table, _mm256_cvttps_epi32(index), 4);
+    }
+
+    static inline Vec Pow2(Vec n)
+    {
+      __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+      return _mm256_castsi256_ps(bits);
+    }
+  };
+
+#include "neuralKernelsSimd.h"
+
+  static int DotInt16(const short* a, const short* b, int n)
+  {
+    int	    j;
+    int	    lanes[8];
+    __m256i sum = _mm256_setzero_si256();
+
+    for(j=0; j<n; j+=16)
+      {
+	sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*) (a+j)),
+						      _mm256_loadu_si256((const __m256i*) (b+j))));
+      }
+
+    _mm256_storeu_si256((__m256i*) lanes, sum);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+      ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+  }
+
+  static const QuantizedKernels quantizedKernels =
+    {
+      "avx2",
+      DotInt16
+    };
+}
+
+#pragma GCC pop_options
+
+#endif   // NEURALNET_X86
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Runtime selection
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum InstructionSet
+  {
+    SCALAR,
+    SSE2,
+    AVX2
+  };
+
+
+
+// Looks at cpuid (through the compiler's builtins) to find the widest
+// instruction set available, unless NEURALNET_KERNELS asks for a
+// specific one. Asking for something the CPU can't do falls back to
+// the automatic choice.
+static InstructionSet SelectInstructionSet(void)
+{
+  const char* forced = getenv("NEURALNET_KERNELS");
+
+  if((forced != NULL) && (strcmp(forced, "scalar") == 0))
+    {
+      return SCALAR;
+    }
+
+#ifdef NEURALNET_X86
+  __builtin_cpu_init();
+
+  bool hasAvx2 = __builtin_cpu_supports("avx2");
+  bool hasSse2 = __builtin_cpu_supports("sse2");
+
+  if((forced != NULL) && (strcmp(forced, "sse2") == 0) && hasSse2)
+    {
+      return SSE2;
+    }
+
+  if(hasAvx2)
+    {
+      return AVX2;
+    }
+
+  if(hasSse2)
+    {
+      return SSE2;
+    }
+#endif
+
+  return SCALAR;
+}
+
+
+
+template <typename Real>
+static const NeuralKernels<Real>* SelectKernels(void)
+{
+  switch(SelectInstructionSet())
+    {
+#ifdef NEURALNET_X86
+    case AVX2:
+      return Avx2::Table<Real>("avx2");
+
+    case SSE2:
+      return Sse2::Table<Real>("sse2");
+#endif
+
+    default:
+      return ScalarTable<Real>();
+    }
+}
+
+
+
+template <typename Real>
+const NeuralKernels<Real>& GetNeuralKernels(void)
+{
+  static const NeuralKernels<Real>* kernels = SelectKernels<Real>();
+
+  return *kernels;
+}
+
+
+template const NeuralKernels<float>&  GetNeuralKernels<float>(void);
+template const NeuralKernels<double>& GetNeuralKernels<double>(void);
+
+
+
+static const QuantizedKernels* SelectQuantizedKernels(void)
+{
+  switch(SelectInstructionSet())
+    {
+#ifdef NEURALNET_X86
+    case AVX2:
+      return &Avx2::quantizedKernels;
+
+    case SSE2:
+      return &Sse2::quantizedKernels;
+#endif
+
+    default:
+      return &scalarQuantizedKernels;
+    }
+}
+
+
+
+const QuantizedKernels& GetQuantizedKernels(void)
+{
+  static const QuantizedKernels* kernels = SelectQuantizedKernels();
+
+  return *kernels;
+}
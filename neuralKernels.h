@@ -0,0 +1,156 @@
+//---------------------------------------------------------------------------
+/*
+  Inner loops of the neural network, in scalar, SSE2 and AVX2
+  flavours. The best set the CPU supports is picked once at runtime,
+  so the same binary runs on any x86 box (and falls back to the
+  scalar loops anywhere else).
+
+  The scalar kernels are exactly the loops NeuralNetworkLayer used
+  to run inline. The vector kernels agree with them to within about
+  1e-13 for double and 1e-6 for float, relative to the size of the
+  values involved: Dot adds its terms across vector lanes in a
+  different order, and Sigmoid uses a polynomial exp() that is good
+  to a couple of ulps. Axpy, Gemm, GemmTransA, the three optimizer
+  updates and the two approximate sigmoids do the same arithmetic per
+  element and are bit-identical.
+
+  Setting the NEURALNET_KERNELS environment variable to "scalar",
+  "sse2" or "avx2" overrides the automatic choice, which is handy
+  when comparing results between machines.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef NEURALKERNELS_H
+#define NEURALKERNELS_H
+
+// How a layer evaluates its sigmoid. SIGMOID_EXACT is the original
+// 1 / (1 + exp(-x)). The other two skip exp() altogether:
+//
+//   SIGMOID_TABLE	linear interpolation in a table of 32 points per
+//			unit over [-16, 16], within 1.2e-5 of the exact value
+//   SIGMOID_RATIONAL	0.5 + 0.5 * tanh(x/2), with tanh replaced by its
+//			[9/8] Pade approximant, within 3.5e-6
+//
+// Both have scalar and vector kernels that agree bit for bit.
+enum SigmoidMode
+  {
+    SIGMOID_EXACT,
+    SIGMOID_TABLE,
+    SIGMOID_RATIONAL
+  };
+
+// How a layer turns its gradients into weight changes:
+//
+//   OPTIMIZER_SGD	the original gradient step, plus MomentumFactor
+//			times the last change when UseMomentum is set
+//   OPTIMIZER_RMSPROP	each step divided by the root of a running mean
+//			of that weight's squared gradients
+//   OPTIMIZER_ADAM	RMSProp's step, but of a running mean of the
+//			gradients, with both means bias corrected
+//
+// Each is a single fused pass over a row of weights and the optimizer
+// state kept alongside them (see NeuralNetworkLayerT).
+enum OptimizerMode
+  {
+    OPTIMIZER_SGD,
+    OPTIMIZER_RMSPROP,
+    OPTIMIZER_ADAM
+  };
+
+// One set of kernels per scalar type, for NeuralNetworkT<Real>.
+// Only float and double are provided.
+template <typename Real>
+struct NeuralKernels
+{
+  const char* Name;
+
+  // y[j] += a * x[j]
+  void	 (*Axpy)(Real a, const Real* x, Real* y, int n);
+
+  // Returns the sum of a[j] * b[j]
+  Real	 (*Dot)(const Real* a, const Real* b, int n);
+
+  // v[j] = 1 / (1 + exp(-v[j])), in place
+  void	 (*Sigmoid)(Real* v, int n);
+
+  // The same, approximated as SIGMOID_TABLE and SIGMOID_RATIONAL
+  void	 (*SigmoidTable)(Real* v, int n);
+  void	 (*SigmoidRational)(Real* v, int n);
+
+  // c = a * b, for a (rows x inner) and b (inner x cols), each
+  // row-major with the given leading dimensions. Every element of
+  // c is summed in inner order, the same as a run of Axpy calls.
+  void	 (*Gemm)(const Real* a, int lda, const Real* b, int ldb,
+		 Real* c, int ldc, int rows, int inner, int cols);
+
+  // c += transpose(a) * b, for a (rows x aCols) and b (rows x bCols).
+  // This sums outer products of matching rows, which is how the
+  // weight gradients of a mini-batch are built up. Rows are added
+  // in order, so every element is summed the same way on any CPU.
+  void	 (*GemmTransA)(const Real* a, int lda, const Real* b, int ldb,
+		       Real* c, int ldc, int rows, int aCols, int bCols);
+
+  // dw = rate * errors[j] * x;
+  // w[j] += dw + momentum * changes[j];
+  // changes[j] = dw;
+  void	 (*MomentumUpdate)(Real* w, Real* changes, const Real* errors,
+			   Real rate, Real x, Real momentum, int n);
+
+  // g = errors[j] * x;
+  // moments[j] = decay * moments[j] + (1 - decay) * g * g;
+  // w[j] += rate * g / (sqrt(moments[j]) + epsilon);
+  void	 (*RmsPropUpdate)(Real* w, Real* moments, const Real* errors,
+			  Real rate, Real x, Real decay, Real epsilon, int n);
+
+  // g = errors[j] * x;
+  // means[j] = beta1 * means[j] + (1 - beta1) * g;
+  // moments[j] = beta2 * moments[j] + (1 - beta2) * g * g;
+  // w[j] += rate * means[j] / (sqrt(moments[j]) + epsilon);
+  // (The caller folds Adam's bias corrections into rate and epsilon.)
+  void	 (*AdamUpdate)(Real* w, Real* means, Real* moments, const Real* errors,
+		       Real rate, Real x, Real beta1, Real beta2, Real epsilon, int n);
+
+  // Runs whichever of the sigmoid kernels mode asks for
+  void ApplySigmoid(SigmoidMode mode, Real* v, int n) const
+  {
+    switch(mode)
+      {
+      case SIGMOID_TABLE:
+	SigmoidTable(v, n);
+	break;
+
+      case SIGMOID_RATIONAL:
+	SigmoidRational(v, n);
+	break;
+
+      default:
+	Sigmoid(v, n);
+	break;
+      }
+  }
+};
+
+
+// Returns the kernels chosen for this CPU. The choice
+// is made on the first call and never changes after that.
+template <typename Real>
+const NeuralKernels<Real>& GetNeuralKernels(void);
+
+
+
+// Integer kernels used by the quantized inference engine
+// in quantizedNet.h. They are picked the same way.
+struct QuantizedKernels
+{
+  const char* Name;
+
+  // Returns the sum of a[j] * b[j], accumulated in 32 bits.
+  // n must be a multiple of QUANTIZED_PADDING.
+  int	 (*DotInt16)(const short* a, const short* b, int n);
+};
+
+#define QUANTIZED_PADDING 16
+
+const QuantizedKernels& GetQuantizedKernels(void);
+
+#endif   // NEURALKERNELS_H
@@ -0,0 +1,374 @@
+//---------------------------------------------------------------------------
+/*
+  Body of the vectorized neural network kernels. This is not a normal
+  header: neuralKernels.cpp includes it once per instruction set, inside
+  a namespace that defines Traits<double> and Traits<float>, with the
+  matching "#pragma GCC target" in effect. Everything here is written
+  in terms of those traits, so one body serves every vector width and
+  scalar type. Each traits class provides:
+
+    Real, Vec, Width		 the scalar type, vector type and lanes
+    Zero, Set1, Load, Store	 unaligned loads and stores
+    Add, Sub, Mul, Div, Min, Max
+    Round			 round to nearest integer
+    Truncate			 round towards zero
+    Gather			 table[index] for each lane, index integer valued
+    Pow2			 2^n, for n already rounded
+    ExpMin, ExpMax		 clamp range for the exponential
+    Ln2Hi, Ln2Lo, Log2e		 range reduction constants
+    ExpTerms, ExpCoefficients	 Taylor series for exp(r), highest first
+*/
+//---------------------------------------------------------------------------
+
+
+
+template <class V>
+static void Axpy(typename V::Real a, const typename V::Real* x, typename V::Real* y, int n)
+{
+  int		 j  = 0;
+  typename V::Vec va = V::Set1(a);
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      V::Store(y+j, V::Add(V::Load(y+j), V::Mul(va, V::Load(x+j))));
+    }
+
+  ScalarAxpy(a, x+j, y+j, n-j);
+}
+
+
+
+// The lanes are folded together pairwise in a fixed order,
+// so the result doesn't depend on anything but the inputs.
+template <class V>
+static typename V::Real Dot(const typename V::Real* a, const typename V::Real* b, int n)
+{
+  int		  j    = 0;
+  int		  k, half;
+  typename V::Real sum;
+  typename V::Real lanes[V::Width];
+  typename V::Vec  vsum = V::Zero();
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      vsum = V::Add(vsum, V::Mul(V::Load(a+j), V::Load(b+j)));
+    }
+
+  V::Store(lanes, vsum);
+  for(half=V::Width/2; half>0; half/=2)
+    {
+      for(k=0; k<half; k++)
+	{
+	  lanes[k] += lanes[k+half];
+	}
+    }
+  sum = lanes[0];
+
+  for(; j<n; j++)
+    {
+      sum += a[j] * b[j];
+    }
+
+  return sum;
+}
+
+
+
+// exp(x) as 2^n * exp(r), with x = n*ln(2) + r and |r| <= ln(2)/2.
+// The Taylor series is long enough that its truncation error is
+// below the rounding error of the type.
+template <class V>
+static inline typename V::Vec Exp(typename V::Vec x)
+{
+  int		 k;
+  typename V::Vec n, r, p;
+
+  x = V::Min(V::Max(x, V::Set1(V::ExpMin)), V::Set1(V::ExpMax));
+  n = V::Round(V::Mul(x, V::Set1(V::Log2e)));
+
+  r = V::Sub(x, V::Mul(n, V::Set1(V::Ln2Hi)));
+  r = V::Sub(r, V::Mul(n, V::Set1(V::Ln2Lo)));
+
+  p = V::Set1(V::ExpCoefficients[0]);
+  for(k=1; k<V::ExpTerms; k++)
+    {
+      p = V::Add(V::Mul(p, r), V::Set1(V::ExpCoefficients[k]));
+    }
+
+  return V::Mul(p, V::Pow2(n));
+}
+
+
+
+template <class V>
+static void Sigmoid(typename V::Real* v, int n)
+{
+  int		 j   = 0;
+  typename V::Vec one = V::Set1(1);
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      V::Store(v+j, V::Div(one, V::Add(one, Exp<V>(V::Sub(V::Zero(), V::Load(v+j))))));
+    }
+
+  ScalarSigmoid(v+j, n-j);
+}
+
+
+
+// The same arithmetic as ScalarSigmoidTable, with the
+// clamping done by Min/Max and the lookups by Gather.
+template <class V>
+static void SigmoidTable(typename V::Real* v, int n)
+{
+  int		     j	   = 0;
+  const typename V::Real* table = GetFastSigmoidTable<typename V::Real>();
+  typename V::Vec    range = V::Set1(FAST_SIGMOID_RANGE);
+  typename V::Vec    steps = V::Set1(FAST_SIGMOID_STEPS);
+  typename V::Vec    x, t, whole, lo, hi;
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      x = V::Min(V::Max(V::Load(v+j), V::Sub(V::Zero(), range)), range);
+      t = V::Mul(V::Add(x, range), steps);
+
+      whole = V::Truncate(t);
+      lo    = V::Gather(table, whole);
+      hi    = V::Gather(table + 1, whole);
+
+      V::Store(v+j, V::Add(lo, V::Mul(V::Sub(t, whole), V::Sub(hi, lo))));
+    }
+
+  ScalarSigmoidTable(v+j, n-j);
+}
+
+
+
+// The same arithmetic as ScalarSigmoidRational
+template <class V>
+static void SigmoidRational(typename V::Real* v, int n)
+{
+  int		 j     = 0;
+  int		 k;
+  typename V::Vec limit = V::Set1(TANH_CLAMP);
+  typename V::Vec half  = V::Set1(0.5);
+  typename V::Vec one   = V::Set1(1);
+  typename V::Vec h, h2, num, den, t;
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      h	 = V::Mul(V::Load(v+j), half);
+      h	 = V::Min(V::Max(h, V::Sub(V::Zero(), limit)), limit);
+      h2 = V::Mul(h, h);
+
+      num = V::Set1(TanhNumerator[0]);
+      den = V::Set1(TanhDenominator[0]);
+      for(k=1; k<TANH_TERMS; k++)
+	{
+	  num = V::Add(V::Mul(num, h2), V::Set1(TanhNumerator[k]));
+	  den = V::Add(V::Mul(den, h2), V::Set1(TanhDenominator[k]));
+	}
+
+      t = V::Div(V::Mul(h, num), den);
+      t = V::Min(V::Max(t, V::Sub(V::Zero(), one)), one);
+
+      V::Store(v+j, V::Add(half, V::Mul(half, t)));
+    }
+
+  ScalarSigmoidRational(v+j, n-j);
+}
+
+
+
+// Four rows of c at a time, so each vector of weights loaded
+// from b is used four times before moving on.
+template <class V>
+static void Gemm(const typename V::Real* a, int lda, const typename V::Real* b, int ldb,
+		 typename V::Real* c, int ldc, int rows, int inner, int cols)
+{
+  int		  r = 0;
+  int		  i, j, k;
+  typename V::Vec  acc0, acc1, acc2, acc3, w;
+  typename V::Real sum;
+
+  for(; r+4<=rows; r+=4)
+    {
+      const typename V::Real* a0 = a + r * lda;
+
+      for(j=0; j+V::Width<=cols; j+=V::Width)
+	{
+	  acc0 = acc1 = acc2 = acc3 = V::Zero();
+
+	  for(i=0; i<inner; i++)
+	    {
+	      w	   = V::Load(b + i * ldb + j);
+	      acc0 = V::Add(acc0, V::Mul(V::Set1(a0[i]), w));
+	      acc1 = V::Add(acc1, V::Mul(V::Set1(a0[lda + i]), w));
+	      acc2 = V::Add(acc2, V::Mul(V::Set1(a0[2 * lda + i]), w));
+	      acc3 = V::Add(acc3, V::Mul(V::Set1(a0[3 * lda + i]), w));
+	    }
+
+	  V::Store(c + r * ldc + j, acc0);
+	  V::Store(c + (r+1) * ldc + j, acc1);
+	  V::Store(c + (r+2) * ldc + j, acc2);
+	  V::Store(c + (r+3) * ldc + j, acc3);
+	}
+
+      for(; j<cols; j++)
+	{
+	  for(k=0; k<4; k++)
+	    {
+	      sum = 0;
+	      for(i=0; i<inner; i++)
+		{
+		  sum += a0[k * lda + i] * b[i * ldb + j];
+		}
+	      c[(r+k) * ldc + j] = sum;
+	    }
+	}
+    }
+
+  ScalarGemm(a + r * lda, lda, b, ldb, c + r * ldc, ldc, rows - r, inner, cols);
+}
+
+
+
+// Each block of c is held in a register while every row of
+// the batch is added into it, then written back once.
+template <class V>
+static void GemmTransA(const typename V::Real* a, int lda, const typename V::Real* b, int ldb,
+		       typename V::Real* c, int ldc, int rows, int aCols, int bCols)
+{
+  int		  r, i, j;
+  typename V::Vec  acc;
+  typename V::Real sum;
+
+  for(i=0; i<aCols; i++)
+    {
+      for(j=0; j+V::Width<=bCols; j+=V::Width)
+	{
+	  acc = V::Load(c + i * ldc + j);
+
+	  for(r=0; r<rows; r++)
+	    {
+	      acc = V::Add(acc, V::Mul(V::Set1(a[r * lda + i]), V::Load(b + r * ldb + j)));
+	    }
+
+	  V::Store(c + i * ldc + j, acc);
+	}
+
+      for(; j<bCols; j++)
+	{
+	  sum = c[i * ldc + j];
+	  for(r=0; r<rows; r++)
+	    {
+	      sum += a[r * lda + i] * b[r * ldb + j];
+	    }
+	  c[i * ldc + j] = sum;
+	}
+    }
+}
+
+
+
+template <class V>
+static void MomentumUpdate(typename V::Real* w, typename V::Real* changes,
+			   const typename V::Real* errors, typename V::Real rate,
+			   typename V::Real x, typename V::Real momentum, int n)
+{
+  int		 j     = 0;
+  typename V::Vec vrate = V::Set1(rate);
+  typename V::Vec vx	= V::Set1(x);
+  typename V::Vec vmom  = V::Set1(momentum);
+  typename V::Vec dw;
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      dw = V::Mul(V::Mul(vrate, V::Load(errors+j)), vx);
+      V::Store(w+j, V::Add(V::Load(w+j), V::Add(dw, V::Mul(vmom, V::Load(changes+j)))));
+      V::Store(changes+j, dw);
+    }
+
+  ScalarMomentumUpdate(w+j, changes+j, errors+j, rate, x, momentum, n-j);
+}
+
+
+
+template <class V>
+static void RmsPropUpdate(typename V::Real* w, typename V::Real* moments,
+			  const typename V::Real* errors, typename V::Real rate,
+			  typename V::Real x, typename V::Real decay,
+			  typename V::Real epsilon, int n)
+{
+  int		  j	 = 0;
+  typename V::Vec vrate	 = V::Set1(rate);
+  typename V::Vec vx	 = V::Set1(x);
+  typename V::Vec vdecay = V::Set1(decay);
+  typename V::Vec vkeep	 = V::Set1(1 - decay);
+  typename V::Vec veps	 = V::Set1(epsilon);
+  typename V::Vec g, m;
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      g = V::Mul(V::Load(errors+j), vx);
+      m = V::Add(V::Mul(vdecay, V::Load(moments+j)), V::Mul(vkeep, V::Mul(g, g)));
+      V::Store(moments+j, m);
+      V::Store(w+j, V::Add(V::Load(w+j), V::Div(V::Mul(vrate, g), V::Add(V::Sqrt(m), veps))));
+    }
+
+  ScalarRmsPropUpdate(w+j, moments+j, errors+j, rate, x, decay, epsilon, n-j);
+}
+
+
+
+template <class V>
+static void AdamUpdate(typename V::Real* w, typename V::Real* means,
+		       typename V::Real* moments, const typename V::Real* errors,
+		       typename V::Real rate, typename V::Real x, typename V::Real beta1,
+		       typename V::Real beta2, typename V::Real epsilon, int n)
+{
+  int		  j	 = 0;
+  typename V::Vec vrate	 = V::Set1(rate);
+  typename V::Vec vx	 = V::Set1(x);
+  typename V::Vec vbeta1 = V::Set1(beta1);
+  typename V::Vec vbeta2 = V::Set1(beta2);
+  typename V::Vec vkeep1 = V::Set1(1 - beta1);
+  typename V::Vec vkeep2 = V::Set1(1 - beta2);
+  typename V::Vec veps	 = V::Set1(epsilon);
+  typename V::Vec g, mean, m;
+
+  for(; j+V::Width<=n; j+=V::Width)
+    {
+      g	   = V::Mul(V::Load(errors+j), vx);
+      mean = V::Add(V::Mul(vbeta1, V::Load(means+j)), V::Mul(vkeep1, g));
+      m	   = V::Add(V::Mul(vbeta2, V::Load(moments+j)), V::Mul(vkeep2, V::Mul(g, g)));
+      V::Store(means+j, mean);
+      V::Store(moments+j, m);
+      V::Store(w+j, V::Add(V::Load(w+j), V::Div(V::Mul(vrate, mean), V::Add(V::Sqrt(m), veps))));
+    }
+
+  ScalarAdamUpdate(w+j, means+j, moments+j, errors+j, rate, x, beta1, beta2, epsilon, n-j);
+}
+
+
+
+template <typename Real>
+static const NeuralKernels<Real>* Table(const char* name)
+{
+  static const NeuralKernels<Real> kernels =
+    {
+      name,
+      Axpy< Traits<Real> >,
+      Dot< Traits<Real> >,
+      Sigmoid< Traits<Real> >,
+      SigmoidTable< Traits<Real> >,
+      SigmoidRational< Traits<Real> >,
+      Gemm< Traits<Real> >,
+      GemmTransA< Traits<Real> >,
+      MomentumUpdate< Traits<Real> >,
+      RmsPropUpdate< Traits<Real> >,
+      AdamUpdate< Traits<Real> >
+    };
+
+  return &kernels;
+}
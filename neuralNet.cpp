@@ -1,10 +1,18 @@
 #include "neuralNet.h"
+#include "neuralKernels.h"
 #include <malloc.h>
 #include <stdlib.h>
 #include <time.h>
 #include <limits.h>
 #include <math.h>
+#include <string.h>
+#include <stdio.h>
 #include <fstream>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 //---------------------------------------------------------------------------
 /*
@@ -15,110 +23,206 @@
 */
 //---------------------------------------------------------------------------
 
+// Rounds a count of values up to a whole number of cache lines
+template <typename Real>
+static int PadToAlignment(int count)
+{
+  const int perLine = LAYER_ALIGNMENT / sizeof(Real);
+
+  return ((count + perLine - 1) / perLine) * perLine;
+}
+
+
+
+
+// Brain files are always parsed as double precision, then
+// converted, so a float network read from a file holds exactly
+// the values a double network read from it would round to.
+template <typename Real>
+static void ReadValue(ifstream& brainFile, Real& value)
+{
+  double readValue;
+
+  brainFile>>readValue;
+  value = (Real) readValue;
+}
+
+
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // NeuralNetworkLayer Class
 /////////////////////////////////////////////////////////////////////////////////////////////////
-NeuralNetworkLayer::NeuralNetworkLayer()
+template <typename Real>
+NeuralNetworkLayerT<Real>::NeuralNetworkLayerT()
 {
+  NumberOfNodes       = 0;
+  NumberOfChildNodes  = 0;
+  NumberOfParentNodes = 0;
+  WeightStride   = 0;
+  BatchStride    = 0;
+  Weights        = NULL;
+  WeightChanges  = NULL;
+  WeightMoments  = NULL;
+  WeightGradients = NULL;
+  NeuronValues   = NULL;
+  DesiredValues  = NULL;
+  Errors         = NULL;
+  BiasValues     = NULL;
+  BiasWeights    = NULL;
+  BiasGradients  = NULL;
+  BiasChanges    = NULL;
+  BiasMoments    = NULL;
+  GradientOffset = 0;
+  TileOffset     = 0;
   ParentLayer    = NULL;
   ChildLayer     = NULL;
+  LearningRate   = 0;
   LinearOutput   = false;
   UseMomentum    = false;
   MomentumFactor = 0.9;
+  SigmoidMethod  = SIGMOID_EXACT;
+  Optimizer      = OPTIMIZER_SGD;
+  Beta1          = 0.9;
+  Beta2          = 0.999;
+  Epsilon        = 1e-8;
+  OptimizerSteps = 0;
 }
 
 
 
 
-// This function allocates the memory used by the neural network layer. 
-void NeuralNetworkLayer::Initialize(int NumNodes, NeuralNetworkLayer* parent, NeuralNetworkLayer* child)
+// Returns how many values this layer's own arrays take up, going by
+// NumberOfNodes and NumberOfChildNodes. Every array is padded to
+// whole cache lines, so the total is too, and the next layer's part
+// of the block stays aligned.
+template <typename Real>
+size_t NeuralNetworkLayerT<Real>::StorageSize(void)
 {
-  int i, j;
+  size_t nodesPadded = PadToAlignment<Real>(NumberOfNodes);
+  size_t childPadded = PadToAlignment<Real>(NumberOfChildNodes);
+  size_t total	     = 3 * nodesPadded;
 
-  // Allocate memory
-  NeuronValues  = (double*) malloc(sizeof(double) * NumberOfNodes);
-  DesiredValues = (double*) malloc(sizeof(double) * NumberOfNodes);
-  Errors = (double*) malloc(sizeof(double) * NumberOfNodes);
-
-  if(parent != NULL)
-    {		
-      ParentLayer = parent;
+  if(NumberOfChildNodes > 0)
+    {
+      total += 3 * (size_t) NumberOfNodes * childPadded + 4 * childPadded;
     }
 
-  if(child != NULL)
-    {
-      ChildLayer = child;
+  return total;
+}
 
-	
-      Weights = (double**) malloc(sizeof(double*) * NumberOfNodes);
-      WeightChanges = (double**) malloc(sizeof(double*) * NumberOfNodes);
-      for(i = 0; i<NumberOfNodes; i++)
-	{
-	  Weights[i] = (double*) malloc(sizeof(double) * NumberOfChildNodes);
-	  WeightChanges[i] = (double*) malloc(sizeof(double) * NumberOfChildNodes);
-	}
 
-      BiasValues = (double*) malloc(sizeof(double) * NumberOfChildNodes);
-      BiasWeights = (double*) malloc(sizeof(double) * NumberOfChildNodes);
-    } 
-  else 
+
+// Returns how many values this layer's part of a gradient buffer
+// takes up: the weight gradients, then the bias gradients, laid
+// out like Weights and BiasWeights.
+template <typename Real>
+size_t NeuralNetworkLayerT<Real>::GradientSize(void)
+{
+  size_t childPadded = PadToAlignment<Real>(NumberOfChildNodes);
+
+  if(NumberOfChildNodes > 0)
     {
-      Weights     = NULL;
-      BiasValues  = NULL;
-      BiasWeights = NULL;
+      return ((size_t) NumberOfNodes + 1) * childPadded;
     }
 
+  return 0;
+}
 
 
-  // Make sure everything contains zeros
-  for(i=0; i<NumberOfNodes; i++)
+
+// Returns how many values this layer's part of a tile scratch
+// buffer takes up: its outputs for BATCH_TILE samples, then its
+// errors for them, each row BatchStride long. The input layer's
+// values come straight from the caller, so it needs none.
+template <typename Real>
+size_t NeuralNetworkLayerT<Real>::TileSize(void)
+{
+  if(NumberOfParentNodes > 0)
     {
-      NeuronValues[i] = 0;
-      DesiredValues[i] = 0;
-      Errors[i] = 0;
-		
-      if(ChildLayer != NULL)
-	for(j=0; j<NumberOfChildNodes; j++)
-	  {
-	    Weights[i][j] = 0;
-	    WeightChanges[i][j] = 0;
-	  }
+      return 2 * (size_t) BATCH_TILE * PadToAlignment<Real>(NumberOfNodes);
     }
 
-  if(ChildLayer != NULL)
-    for(j=0; j<NumberOfChildNodes; j++)
-      {
-	BiasValues[j] = -1;
-	BiasWeights[j] = 0;
-      }
+  return 0;
 }
 
 
 
 
-// This function simply deallocates memory used
-void NeuralNetworkLayer::CleanUp(void)
+// This function sets up the arrays used by the neural network layer.
+// They are all carved out of block, which has to hold StorageSize()
+// zeroed values aligned to LAYER_ALIGNMENT, apart from the gradients,
+// which are this layer's GradientSize() values of the network's
+// gradient buffer.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::Initialize(NeuralNetworkLayerT* parent, NeuralNetworkLayerT* child,
+					   Real* block, Real* gradients)
 {
-  int	i;
+  int	 j;
+  int	 nodesPadded;
+
+  ParentLayer = parent;
+  ChildLayer  = child;
+
+  nodesPadded  = PadToAlignment<Real>(NumberOfNodes);
+  WeightStride = 0;
+  BatchStride  = (ParentLayer != NULL) ? nodesPadded : 0;
+
+  NeuronValues  = block; block += nodesPadded;
+  DesiredValues = block; block += nodesPadded;
+  Errors        = block; block += nodesPadded;
+
+  Weights         = NULL;
+  WeightChanges   = NULL;
+  WeightMoments   = NULL;
+  WeightGradients = NULL;
+  BiasValues      = NULL;
+  BiasWeights     = NULL;
+  BiasGradients   = NULL;
+  BiasChanges     = NULL;
+  BiasMoments     = NULL;
+  OptimizerSteps  = 0;
 
-  free(NeuronValues);
-  free(DesiredValues);
-  free(Errors);
-	
-  if(Weights != NULL)
+  if(ChildLayer != NULL)
     {
-      for(i = 0; i<NumberOfNodes; i++)
+      WeightStride    = PadToAlignment<Real>(NumberOfChildNodes);
+      Weights         = block; block += (size_t) NumberOfNodes * WeightStride;
+      WeightChanges   = block; block += (size_t) NumberOfNodes * WeightStride;
+      WeightMoments   = block; block += (size_t) NumberOfNodes * WeightStride;
+      BiasValues      = block; block += WeightStride;
+      BiasWeights     = block; block += WeightStride;
+      BiasChanges     = block; block += WeightStride;
+      BiasMoments     = block; block += WeightStride;
+      WeightGradients = gradients;
+      BiasGradients   = gradients + (size_t) NumberOfNodes * WeightStride;
+
+      for(j=0; j<NumberOfChildNodes; j++)
 	{
-	  free(Weights[i]);
-	  free(WeightChanges[i]);
+	  BiasValues[j] = -1;
 	}
+    } 
+}
+
+
 
-      free(Weights);
-      free(WeightChanges);
-    }
 
-  if(BiasValues != NULL) free(BiasValues);
-  if(BiasWeights != NULL) free(BiasWeights);
+// The memory belongs to the network, so this
+// just forgets where the layer's arrays were.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::CleanUp(void)
+{
+  Weights         = NULL;
+  WeightChanges   = NULL;
+  WeightMoments   = NULL;
+  WeightGradients = NULL;
+  NeuronValues    = NULL;
+  DesiredValues   = NULL;
+  Errors          = NULL;
+  BiasValues      = NULL;
+  BiasWeights     = NULL;
+  BiasGradients   = NULL;
+  BiasChanges     = NULL;
+  BiasMoments     = NULL;
 }
 
 
@@ -126,41 +230,34 @@ void NeuralNetworkLayer::CleanUp(void)
 
 
 // Called from initialize function for randomizing the weights
-// of a new neural network. 
-void NeuralNetworkLayer::RandomizeWeights(void)
+// of a new neural network. The weights are drawn from stream number
+// stream of the Philox generator seeded with seed, the weight from
+// node i to child node j being value i * NumberOfChildNodes + j of
+// it, and the bias weights following those. So a layer's weights
+// depend only on the seed and stream, never on when, or on which
+// thread, they were drawn.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::RandomizeWeights(unsigned long long seed, unsigned long long stream)
 {
-  int	i,j;
-  int	min = 0;
-  int	max = 200;
-  int	number;
-
-  srand( (unsigned)time( NULL ) );
+  int	       i,j;
+  int	       min = 0;
+  int	       max = 200;
+  int	       number;
+  PhiloxRandom random(seed, stream);
 
   for(i=0; i<NumberOfNodes; i++)
     {
       for(j=0; j<NumberOfChildNodes; j++)
 	{	
-	  number = (((abs(rand())%(max-min+1))+min));    
-    
-	  if(number>max)
-	    number = max;
-
-	  if(number<min)
-	    number = min;		
+	  number = random.NextBelow(max-min+1) + min;
 			
-	  Weights[i][j] = number / 100.0f - 1;
+	  Weights[i * WeightStride + j] = number / 100.0f - 1;
 	}
     }
 	
   for(j=0; j<NumberOfChildNodes; j++)
     {
-      number = (((abs(rand())%(max-min+1))+min));    
-    
-      if(number>max)
-	number = max;
-
-      if(number<min)
-	number = min;		
+      number = random.NextBelow(max-min+1) + min;
 			
       BiasWeights[j] = number / 100.0f - 1;		
     }
@@ -171,11 +268,16 @@ void NeuralNetworkLayer::RandomizeWeights(void)
 
 // This function calculates the errors of specific neurons.
 // It is called by the BackPropogate function for the overall
-// neural network.
-void NeuralNetworkLayer::CalculateErrors(void)
+// neural network. The sigmoid's derivative is taken from the
+// neuron's own output, y * (1 - y), so it is always the derivative
+// of whichever SigmoidMethod produced y, and never calls exp().
+template <typename Real>
+void NeuralNetworkLayerT<Real>::CalculateErrors(void)
 {
-  int		i, j;
-  double	sum;
+  int		i;
+  Real	sum;
+  Real*	row;
+  const NeuralKernels<Real>& kernels = GetNeuralKernels<Real>();
 	
   if(ChildLayer == NULL) // output layer
     {
@@ -195,11 +297,8 @@ void NeuralNetworkLayer::CalculateErrors(void)
     { // hidden layer
       for(i=0; i<NumberOfNodes; i++)
 	{
-	  sum = 0;
-	  for(j=0; j<NumberOfChildNodes; j++)
-	    {
-	      sum += ChildLayer->Errors[j] * Weights[i][j];	
-	    }
+	  row = Weights + i * WeightStride;
+	  sum = kernels.Dot(ChildLayer->Errors, row, NumberOfChildNodes);
 	  Errors[i] = sum * NeuronValues[i] * (1.0f - NeuronValues[i]);
 	}
     }
@@ -213,26 +312,136 @@ void NeuralNetworkLayer::CalculateErrors(void)
 // have any connections to children, it doesn't apply here. In this 
 // simple feed-forward style of neural network, each neuron in a layer
 // connects to every neuron in it's child layer. 
-void NeuralNetworkLayer::AdjustWeights(void)
+template <typename Real>
+void NeuralNetworkLayerT<Real>::AdjustWeights(void)
 {
-  int		i, j;	
-  double	dw;
+  int	i, j;
+  Real	rate, epsilon;
 
   if(ChildLayer != NULL)
     {
+      StartUpdate(rate, epsilon);
+
       for(i=0; i<NumberOfNodes; i++)
 	{
+	  UpdateRow(Weights + i * WeightStride,
+		    WeightChanges + i * WeightStride,
+		    WeightMoments + i * WeightStride,
+		    ChildLayer->Errors, NeuronValues[i],
+		    rate, epsilon, NumberOfChildNodes);
+	}
+
+      if(Optimizer == OPTIMIZER_SGD)
+	{
+	  for(j=0; j<NumberOfChildNodes; j++)
+	    {
+	      BiasWeights[j] += LearningRate * ChildLayer->Errors[j] * BiasValues[j];
+	    }
+	}
+      else
+	{
+	  // The bias gradients are borrowed for
+	  // the one sample, and cleared again
 	  for(j=0; j<NumberOfChildNodes; j++)
 	    {
-	      dw = LearningRate * ChildLayer->Errors[j] * NeuronValues[i];
-	      Weights[i][j] += dw + MomentumFactor * WeightChanges[i][j];			
-	      WeightChanges[i][j] = dw;
+	      BiasGradients[j] = ChildLayer->Errors[j] * BiasValues[j];
 	    }
+
+	  UpdateRow(BiasWeights, BiasChanges, BiasMoments, BiasGradients, 1,
+		    rate, epsilon, NumberOfChildNodes);
+
+	  memset(BiasGradients, 0, sizeof(Real) * NumberOfChildNodes);
 	}
+    }
+}
 
-      for(j=0; j<NumberOfChildNodes; j++)
+
+
+
+// Counts one more update, and works out the learning rate and
+// epsilon to give UpdateRow for it (see StepRate).
+template <typename Real>
+void NeuralNetworkLayerT<Real>::StartUpdate(Real& rate, Real& epsilon)
+{
+  OptimizerSteps++;
+
+  StepRate(OptimizerSteps, rate, epsilon);
+}
+
+
+
+// The learning rate and epsilon to give UpdateRow for update
+// number step. For Adam these take in the bias corrections for
+// its means both starting out at zero, as
+// rate * sqrt(1 - beta2^t) / (1 - beta1^t) and
+// epsilon * sqrt(1 - beta2^t), which comes to the same step
+// as correcting every mean separately.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::StepRate(long step, Real& rate, Real& epsilon) const
+{
+  double correction1, correction2;
+
+  rate	  = LearningRate;
+  epsilon = Epsilon;
+
+  if(Optimizer == OPTIMIZER_ADAM)
+    {
+      correction1 = 1 - pow((double) Beta1, (double) step);
+      correction2 = sqrt(1 - pow((double) Beta2, (double) step));
+
+      rate    = LearningRate * correction2 / correction1;
+      epsilon = Epsilon * correction2;
+    }
+}
+
+
+
+// One optimizer step for n weights w, with their parts of the
+// optimizer state, where weight j's gradient is gradients[j] * x
+template <typename Real>
+void NeuralNetworkLayerT<Real>::UpdateRow(Real* w, Real* changes, Real* moments,
+					  const Real* gradients, Real x,
+					  Real rate, Real epsilon, int n)
+{
+  const NeuralKernels<Real>& kernels = GetNeuralKernels<Real>();
+
+  switch(Optimizer)
+    {
+    case OPTIMIZER_RMSPROP:
+      kernels.RmsPropUpdate(w, moments, gradients, rate, x, Beta2, epsilon, n);
+      break;
+
+    case OPTIMIZER_ADAM:
+      kernels.AdamUpdate(w, changes, moments, gradients, rate, x, Beta1, Beta2, epsilon, n);
+      break;
+
+    default:
+      kernels.MomentumUpdate(w, changes, gradients, rate, x,
+			     UseMomentum ? MomentumFactor : 0, n);
+      break;
+    }
+}
+
+
+
+// Forgets the optimizer's state, the last weight changes and
+// running means alike, so the next update starts from scratch.
+// Plain SGD never touches the moments, so they're left alone
+// (and their pages never even get touched) until it's needed.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::ResetOptimizer(void)
+{
+  OptimizerSteps = 0;
+
+  if(ChildLayer != NULL)
+    {
+      memset(WeightChanges, 0, sizeof(Real) * NumberOfNodes * WeightStride);
+
+      if(Optimizer != OPTIMIZER_SGD)
 	{
-	  BiasWeights[j] += LearningRate * ChildLayer->Errors[j] * BiasValues[j];
+	  memset(WeightMoments, 0, sizeof(Real) * NumberOfNodes * WeightStride);
+	  memset(BiasChanges, 0, sizeof(Real) * WeightStride);
+	  memset(BiasMoments, 0, sizeof(Real) * WeightStride);
 	}
     }
 }
@@ -245,35 +454,238 @@ void NeuralNetworkLayer::AdjustWeights(void)
 // except the output layer. The output layer will use a linear activation function
 // if the boolean value LinearOutput is set to true. If that boolean is false,
 // the output layer will also use the sigmoid activation function
-void NeuralNetworkLayer::CalculateNeuronValues(void)
+//
+// The weighted sums are accumulated one parent row at a time, so
+// the parent's weight matrix is read front to back. Each sum still
+// adds its terms in parent order followed by the bias, exactly as
+// a per-neuron dot product would.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::CalculateNeuronValues(void)
 {
   int		i,j;
-  double	x;
+  const NeuralKernels<Real>& kernels = GetNeuralKernels<Real>();
 	
   if(ParentLayer != NULL)
     {
       for(j=0; j<NumberOfNodes; j++)
 	{
-	  x = 0;
+	  NeuronValues[j] = 0;
+	}
+
+      for(i=0; i<NumberOfParentNodes; i++)
+	{
+	  kernels.Axpy(ParentLayer->NeuronValues[i],
+		       ParentLayer->Weights + i * ParentLayer->WeightStride,
+		       NeuronValues, NumberOfNodes);
+	}	
+
+      for(j=0; j<NumberOfNodes; j++)
+	{
+	  NeuronValues[j] += ParentLayer->BiasValues[j] * ParentLayer->BiasWeights[j];
+	}
+
+      // Linear activation function leaves the sums alone,
+      // otherwise this is the logistic, or sigmoid activation function,
+      // evaluated however SigmoidMethod says
+      if(!((ChildLayer == NULL) && LinearOutput))
+	{
+	  kernels.ApplySigmoid(SigmoidMethod, NeuronValues, NumberOfNodes);
+	}
+    }
+}
+
+
+
+
+
+
+
+
+// The batched version of CalculateNeuronValues. Each of the rows of
+// parentValues holds one sample's parent layer outputs, and the matching
+// row of values receives this layer's outputs for that sample. The whole
+// block goes through one matrix multiply, so the parent's weights are
+// pulled into cache once per block rather than once per sample. Each
+// value comes out exactly as CalculateNeuronValues would compute it.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::CalculateNeuronValuesBatch(const Real* parentValues, int parentStride,
+						    Real* values, int stride, int rows) const
+{
+  int		r, j;
+  Real*	row;
+  const NeuralKernels<Real>& kernels = GetNeuralKernels<Real>();
+
+  if(ParentLayer == NULL)
+    {
+      return;
+    }
+
+  kernels.Gemm(parentValues, parentStride,
+	       ParentLayer->Weights, ParentLayer->WeightStride,
+	       values, stride, rows, NumberOfParentNodes, NumberOfNodes);
+
+  for(r=0; r<rows; r++)
+    {
+      row = values + r * stride;
+
+      for(j=0; j<NumberOfNodes; j++)
+	{
+	  row[j] += ParentLayer->BiasValues[j] * ParentLayer->BiasWeights[j];
+	}
+
+      if(!((ChildLayer == NULL) && LinearOutput))
+	{
+	  kernels.ApplySigmoid(SigmoidMethod, row, NumberOfNodes);
+	}
+    }
+}
+
+
+
+
+
 
-	  for(i=0; i<NumberOfParentNodes; i++)
+
+
+// The batched version of CalculateErrors, for a block of samples.
+// values holds this layer's outputs for each sample. For the output
+// layer, targets holds the desired outputs, and for the hidden layer
+// it holds the child layer's errors for the same samples. The errors
+// for each sample are written to the matching row of errors.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::CalculateErrorsBatch(const Real* values, int stride,
+					      const Real* targets, int targetStride,
+					      Real* errors, int errorStride, int rows)
+{
+  int		r, i;
+  Real	sum;
+  const Real*	value;
+  const Real*	target;
+  Real*	error;
+  const NeuralKernels<Real>& kernels = GetNeuralKernels<Real>();
+
+  for(r=0; r<rows; r++)
+    {
+      value  = values + r * stride;
+      target = targets + r * targetStride;
+      error  = errors + r * errorStride;
+
+      if(ChildLayer == NULL) // output layer
+	{
+	  for(i=0; i<NumberOfNodes; i++)
 	    {
-	      x += ParentLayer->NeuronValues[i] * ParentLayer->Weights[i][j];
-	    }	
-		
-	  x += ParentLayer->BiasValues[j] * ParentLayer->BiasWeights[j];
-			
-	  if((ChildLayer == NULL) && LinearOutput)
+	      error[i] = (target[i] - value[i]) * value[i] * (1.0f - value[i]);
+	    }
+	}
+      else if(ParentLayer != NULL) // hidden layer
+	{
+	  for(i=0; i<NumberOfNodes; i++)
+	    {
+	      sum = kernels.Dot(target, Weights + i * WeightStride, NumberOfChildNodes);
+	      error[i] = sum * value[i] * (1.0f - value[i]);
+	    }
+	}
+    }
+}
+
+
+
+
+// Adds the gradients of a block of samples to gradients, this layer's
+// part of a gradient buffer (see GradientSize), which is usually just
+// WeightGradients. values holds this layer's outputs and childErrors
+// the child layer's errors, one row per sample. Nothing changes in
+// the weights themselves until ApplyGradients is called.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::AccumulateGradients(const Real* values, int stride,
+					     const Real* childErrors, int childStride, int rows,
+					     Real* gradients)
+{
+  int	r, j;
+  Real* biasGradients;
+  const NeuralKernels<Real>& kernels = GetNeuralKernels<Real>();
+
+  if(ChildLayer != NULL)
+    {
+      biasGradients = gradients + (size_t) NumberOfNodes * WeightStride;
+
+      kernels.GemmTransA(values, stride, childErrors, childStride,
+			 gradients, WeightStride,
+			 rows, NumberOfNodes, NumberOfChildNodes);
+
+      for(r=0; r<rows; r++)
+	{
+	  for(j=0; j<NumberOfChildNodes; j++)
 	    {
-	      // Linear activation function
-	      NeuronValues[j] = x;
+	      biasGradients[j] += childErrors[r * childStride + j] * BiasValues[j];
 	    }
-	  else
+	}
+    }
+}
+
+
+
+
+// Applies the gradients gathered over numSamples samples as a single
+// weight adjustment, using the mean gradient in place of the single
+// sample one AdjustWeights uses, through the same optimizer. gradients
+// is this layer's part of a gradient buffer, as for AccumulateGradients,
+// and is cleared again afterwards, ready for the next mini-batch.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::ApplyGradients(int numSamples, Real* gradients)
+{
+  if((ChildLayer != NULL) && (numSamples > 0))
+    {
+      OptimizerSteps++;
+      ApplyGradients(numSamples, gradients, OptimizerSteps);
+    }
+}
+
+
+
+// The same, as update number step of the caller's own count, with
+// OptimizerSteps left alone. Nothing in the layer is written but
+// the weights and the optimizer's state, so threads updating the
+// weights without locking (see HogwildTrainerT) don't also keep
+// fighting over the layer's own cache lines.
+template <typename Real>
+void NeuralNetworkLayerT<Real>::ApplyGradients(int numSamples, Real* gradients, long step)
+{
+  int	i, j;
+  Real	scale, rate, epsilon;
+  Real* biasGradients;
+
+  if((ChildLayer != NULL) && (numSamples > 0))
+    {
+      scale	    = 1.0 / numSamples;
+      biasGradients = gradients + (size_t) NumberOfNodes * WeightStride;
+
+      StepRate(step, rate, epsilon);
+
+      for(i=0; i<NumberOfNodes; i++)
+	{
+	  UpdateRow(Weights + i * WeightStride,
+		    WeightChanges + i * WeightStride,
+		    WeightMoments + i * WeightStride,
+		    gradients + i * WeightStride,
+		    scale, rate, epsilon, NumberOfChildNodes);
+	}
+
+      if(Optimizer == OPTIMIZER_SGD)
+	{
+	  for(j=0; j<NumberOfChildNodes; j++)
 	    {
-	      //  This is the logistic, or sigmoid activation function
-	      NeuronValues[j] = 1.0f/(1+exp(-x));
+	      BiasWeights[j] += LearningRate * biasGradients[j] * scale;
 	    }
 	}
+      else
+	{
+	  UpdateRow(BiasWeights, BiasChanges, BiasMoments, biasGradients, scale,
+		    rate, epsilon, NumberOfChildNodes);
+	}
+
+      memset(gradients, 0, sizeof(Real) * NumberOfNodes * WeightStride);
+      memset(biasGradients, 0, sizeof(Real) * NumberOfChildNodes);
     }
 }
 
@@ -287,6 +699,109 @@ void NeuralNetworkLayer::CalculateNeuronValues(void)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // NeuralNetwork Class
 /////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename Real>
+NeuralNetworkT<Real>::NeuralNetworkT()
+{
+  NumberOfLayers  = 0;
+  Layers          = NULL;
+  Storage         = NULL;
+  Gradients       = NULL;
+  TileScratch     = NULL;
+  GradientSize    = 0;
+  TileScratchSize = 0;
+  StorageBytes    = 0;
+  Mapping         = NULL;
+  MappingSize     = 0;
+  RandomSeed      = time(NULL);
+}
+
+
+
+
+// Sets up the layers for a network of numLayers layers, sized by
+// layerSizes, and allocates the one block all of them live in: each
+// layer's own arrays, then the gradients, then the tile scratch. The
+// block is zeroed, so the weights still need to be randomized or
+// read in. It comes straight from mmap, whose pages are zero until
+// they're first touched, so the parts of it a network never uses
+// (the weights of a mapped one, say, the gradients of one only used
+// for inference, or the moments of one trained by plain SGD) never
+// take up any actual memory. Training settings (learning rate,
+// momentum, optimizer, sigmoid mode, linear output) carry over from
+// whatever network this replaces.
+template <typename Real>
+void NeuralNetworkT<Real>::Allocate(int numLayers, const int* layerSizes)
+{
+  int	 l;
+  size_t layerTotal = 0;
+  Real*	 block;
+  NeuralNetworkLayerT<Real> settings;
+
+  if(numLayers < 2)
+    {
+      cout<<"Error, a neural network needs at least 2 layers!"<<endl;
+      exit(1);
+    }
+
+  if(Layers != NULL)
+    {
+      settings = Layers[0];
+    }
+
+  CleanUp();
+
+  NumberOfLayers = numLayers;
+  Layers	 = new NeuralNetworkLayerT<Real>[numLayers];
+
+  for(l=0; l<numLayers; l++)
+    {
+      Layers[l].NumberOfNodes	    = layerSizes[l];
+      Layers[l].NumberOfParentNodes = (l > 0) ? layerSizes[l-1] : 0;
+      Layers[l].NumberOfChildNodes  = (l < numLayers-1) ? layerSizes[l+1] : 0;
+
+      Layers[l].LearningRate   = settings.LearningRate;
+      Layers[l].LinearOutput   = settings.LinearOutput;
+      Layers[l].UseMomentum    = settings.UseMomentum;
+      Layers[l].MomentumFactor = settings.MomentumFactor;
+      Layers[l].SigmoidMethod  = settings.SigmoidMethod;
+      Layers[l].Optimizer      = settings.Optimizer;
+      Layers[l].Beta1          = settings.Beta1;
+      Layers[l].Beta2          = settings.Beta2;
+      Layers[l].Epsilon        = settings.Epsilon;
+
+      Layers[l].GradientOffset = GradientSize;
+      Layers[l].TileOffset     = TileScratchSize;
+
+      layerTotal      += Layers[l].StorageSize();
+      GradientSize    += Layers[l].GradientSize();
+      TileScratchSize += Layers[l].TileSize();
+    }
+
+  // Allocate memory, which mmap zeroes for us
+  StorageBytes = sizeof(Real) * (layerTotal + GradientSize + TileScratchSize);
+  Storage      = (Real*) mmap(NULL, StorageBytes, PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(Storage == MAP_FAILED)
+    {
+      cout<<"Error, unable to allocate neural network!"<<endl;
+      exit(1);
+    }
+
+  Gradients   = Storage + layerTotal;
+  TileScratch = Gradients + GradientSize;
+
+  block = Storage;
+  for(l=0; l<numLayers; l++)
+    {
+      Layers[l].Initialize((l > 0) ? &Layers[l-1] : NULL,
+			   (l < numLayers-1) ? &Layers[l+1] : NULL,
+			   block, Gradients + Layers[l].GradientOffset);
+      block += Layers[l].StorageSize();
+    }
+}
+
+
+
 
 // Called to initialize a new neural network. If you're starting with an existing
 // neural net, you would call ReadData instead. The aiTrainer program would generally
@@ -294,42 +809,72 @@ void NeuralNetworkLayer::CalculateNeuronValues(void)
 // has been created that you're happy with, you're end application would generally
 // be calling ReadData instead, with the filename of the saved neural net. 
 //
-// It probably wouldn't be difficult to change this code to support multiple hidden
-// layers, however most simple applications will not require more than one hidden layer.
-// Indeed, many applications wouldn't even need a hidden layer, but this class is 
-// explicitely a 3 layer network. Determining the correct topology in a multiple hidden
+// layerSizes holds the number of neurons in each of the numLayers layers, input
+// layer first and output layer last, so { 4, 8, 4, 1 } is a network with two
+// hidden layers. Determining the correct topology in a multiple hidden
 // layer network would be rather cumbersome trial and error effort. If such a 
 // complicated neural network topology is needed, it may be more appropriate to 
 // explore evolutionary methods of automatically evolving appropriate neural net
 // topologies, using some implementation of the NEAT, rtNeat, or HyperNEAT algorithms 
-void NeuralNetwork::Initialize(int nNodesInput, int nNodesHidden, int nNodesOutput)
+template <typename Real>
+void NeuralNetworkT<Real>::Initialize(int numLayers, const int* layerSizes)
 {
-  InputLayer.NumberOfNodes       = nNodesInput;
-  InputLayer.NumberOfChildNodes  = nNodesHidden;
-  InputLayer.NumberOfParentNodes = 0;	
-  InputLayer.Initialize(nNodesInput, NULL, &HiddenLayer);
-  InputLayer.RandomizeWeights();
-	
-  HiddenLayer.NumberOfNodes = nNodesHidden;
-  HiddenLayer.NumberOfChildNodes = nNodesOutput;
-  HiddenLayer.NumberOfParentNodes = nNodesInput;		
-  HiddenLayer.Initialize(nNodesHidden, &InputLayer, &OutputLayer);
-  HiddenLayer.RandomizeWeights();
-	
-  OutputLayer.NumberOfNodes       = nNodesOutput;
-  OutputLayer.NumberOfChildNodes  = 0;
-  OutputLayer.NumberOfParentNodes = nNodesHidden;		
-  OutputLayer.Initialize(nNodesOutput, &HiddenLayer, NULL);	
+  int l;
+
+  Allocate(numLayers, layerSizes);
+
+  for(l=0; l<NumberOfLayers-1; l++)
+    {
+      Layers[l].RandomizeWeights(RandomSeed, RANDOM_STREAM_WEIGHTS + l);
+    }
+}
+
+
+
+// The original 3 layer network, with one hidden layer
+template <typename Real>
+void NeuralNetworkT<Real>::Initialize(int nNodesInput, int nNodesHidden, int nNodesOutput)
+{
+  int layerSizes[3] = { nNodesInput, nNodesHidden, nNodesOutput };
+
+  Initialize(3, layerSizes);
 }
 
 
 
 // Cleans up all the layers of the neural network. 
-void NeuralNetwork::CleanUp()
+template <typename Real>
+void NeuralNetworkT<Real>::CleanUp()
 {
-  InputLayer.CleanUp();
-  HiddenLayer.CleanUp();
-  OutputLayer.CleanUp();
+  int l;
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      Layers[l].CleanUp();
+    }
+
+  delete[] Layers;
+
+  if(Storage != NULL)
+    {
+      munmap(Storage, StorageBytes);
+    }
+
+  if(Mapping != NULL)
+    {
+      munmap(Mapping, MappingSize);
+    }
+
+  NumberOfLayers  = 0;
+  Layers          = NULL;
+  Storage         = NULL;
+  Gradients       = NULL;
+  TileScratch     = NULL;
+  GradientSize    = 0;
+  TileScratchSize = 0;
+  StorageBytes    = 0;
+  Mapping         = NULL;
+  MappingSize     = 0;
 }
 
 
@@ -338,11 +883,12 @@ void NeuralNetwork::CleanUp()
 // This function sets the input value for a specific
 // input neuron. It is used both in training, and in
 // the final application. 
-void NeuralNetwork::SetInput(int i, double value)
+template <typename Real>
+void NeuralNetworkT<Real>::SetInput(int i, Real value)
 {
-  if((i>=0) && (i<InputLayer.NumberOfNodes))
+  if((i>=0) && (i<Layers[0].NumberOfNodes))
     {
-      InputLayer.NeuronValues[i] = value;
+      Layers[0].NeuronValues[i] = value;
     }
 }
 
@@ -350,14 +896,17 @@ void NeuralNetwork::SetInput(int i, double value)
 
 // This function gets the output from a specific 
 // output neuron. Called after the feedforward function
-double NeuralNetwork::GetOutput(int i)
+template <typename Real>
+Real NeuralNetworkT<Real>::GetOutput(int i)
 {
-  if((i>=0) && (i<OutputLayer.NumberOfNodes))
+  NeuralNetworkLayerT<Real>& outputLayer = Layers[NumberOfLayers-1];
+
+  if((i>=0) && (i<outputLayer.NumberOfNodes))
     {
-      return OutputLayer.NeuronValues[i];
+      return outputLayer.NeuronValues[i];
     }
 
-  return (double) INT_MAX; // to indicate an error
+  return (Real) INT_MAX; // to indicate an error
 }
 
 
@@ -366,11 +915,14 @@ double NeuralNetwork::GetOutput(int i)
 // neural network the desired output. It uses this desired
 // value, plus the value it actually calculated to determine
 // an error rate
-void NeuralNetwork::SetDesiredOutput(int i, double value)
+template <typename Real>
+void NeuralNetworkT<Real>::SetDesiredOutput(int i, Real value)
 {
-  if((i>=0) && (i<OutputLayer.NumberOfNodes))
+  NeuralNetworkLayerT<Real>& outputLayer = Layers[NumberOfLayers-1];
+
+  if((i>=0) && (i<outputLayer.NumberOfNodes))
     {
-      OutputLayer.DesiredValues[i] = value;
+      outputLayer.DesiredValues[i] = value;
     }
 }
 
@@ -381,49 +933,292 @@ void NeuralNetwork::SetDesiredOutput(int i, double value)
 // calculate all the values of each layer. After this
 // function is done, the output neurons will contain 
 // the output values. 
-void NeuralNetwork::FeedForward(void)
+template <typename Real>
+void NeuralNetworkT<Real>::FeedForward(void)
 {
-  InputLayer.CalculateNeuronValues();
-  HiddenLayer.CalculateNeuronValues();
-  OutputLayer.CalculateNeuronValues();
+  int l;
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      Layers[l].CalculateNeuronValues();
+    }
 }
 
 
 
 
-// Used during training. The errors for the 
-// output and hidden layers are calculated, 
-// and then the weights are adjusted. 
-void NeuralNetwork::BackPropagate(void)
+// Evaluates the network on numSamples input vectors in one call.
+// inputs holds numSamples rows of input layer values, and outputs
+// receives numSamples rows of output layer values. The samples go
+// through in blocks of BATCH_TILE, each layer as a single matrix
+// multiply into its part of TileScratch. The network's own neuron
+// values (the ones SetInput/GetOutput use) are left untouched, and
+// every output matches what FeedForward would give for that sample
+// on its own.
+template <typename Real>
+void NeuralNetworkT<Real>::FeedForwardBatch(const Real* inputs, int numSamples, Real* outputs)
 {
-  OutputLayer.CalculateErrors();
-  HiddenLayer.CalculateErrors();
-
-  HiddenLayer.AdjustWeights();
-  InputLayer.AdjustWeights();
+  FeedForwardBatch(inputs, numSamples, outputs, TileScratch);
 }
 
 
 
-// This function is used to determine which
-// output neuron has the highest output value.
-// This would be useful in a neural net design 
-// with a "winner-takes-all" approach, where
+// FeedForwardBatch with the caller's own tile buffer of
+// TileScratchSize values (laid out like TileScratch) in place of the
+// network's. The network itself is only read, so any number of
+// threads can run batches through it at the same time, as long as
+// each has its own scratch, as with BackPropagateTile.
+template <typename Real>
+void NeuralNetworkT<Real>::FeedForwardBatch(const Real* inputs, int numSamples, Real* outputs,
+					    Real* scratch) const
+{
+  int	      first, rows, l;
+  int	      nInputs  = Layers[0].NumberOfNodes;
+  int	      nOutputs = Layers[NumberOfLayers-1].NumberOfNodes;
+  int	      parentStride;
+  const Real* parentValues;
+  Real*	      values;
+
+  for(first=0; first<numSamples; first+=BATCH_TILE)
+    {
+      rows = numSamples - first;
+      if(rows > BATCH_TILE)
+	{
+	  rows = BATCH_TILE;
+	}
+
+      parentValues = inputs + first * nInputs;
+      parentStride = nInputs;
+
+      for(l=1; l<NumberOfLayers-1; l++)
+	{
+	  values = scratch + Layers[l].TileOffset;
+
+	  Layers[l].CalculateNeuronValuesBatch(parentValues, parentStride,
+					       values, Layers[l].BatchStride, rows);
+
+	  parentValues = values;
+	  parentStride = Layers[l].BatchStride;
+	}
+
+      Layers[NumberOfLayers-1].CalculateNeuronValuesBatch(parentValues, parentStride,
+							  outputs + first * nOutputs, nOutputs, rows);
+    }
+}
+
+
+
+
+// Mini-batch training. Runs the numSamples rows of inputs through
+// the network, compares them against the matching rows of desired
+// outputs, and sums the gradients over all of them. The weights are
+// then adjusted once, by the mean gradient, with momentum applied
+// to that one update. Like FeedForwardBatch the samples go through
+// BATCH_TILE at a time as matrix multiplies, and the network's own
+// neuron values are left alone. Returns the mean of CalculateError
+// over the batch, measured before the update.
+template <typename Real>
+Real NeuralNetworkT<Real>::BackPropagateBatch(const Real* inputs, const Real* desired, int numSamples)
+{
+  int  first, rows;
+  int  nInputs  = Layers[0].NumberOfNodes;
+  int  nOutputs = Layers[NumberOfLayers-1].NumberOfNodes;
+  Real error    = 0;
+
+  for(first=0; first<numSamples; first+=BATCH_TILE)
+    {
+      rows = numSamples - first;
+      if(rows > BATCH_TILE)
+	{
+	  rows = BATCH_TILE;
+	}
+
+      BackPropagateTile(inputs + first * nInputs, desired + first * nOutputs, rows,
+			TileScratch, Gradients, error);
+    }
+
+  ApplyGradients(numSamples);
+
+  return (numSamples > 0) ? error / numSamples : 0;
+}
+
+
+
+
+// One tile of BackPropagateBatch: runs rows (at most BATCH_TILE)
+// samples forward and back, adds their gradients to gradients, and
+// adds each sample's CalculateError to error. scratch is a tile
+// buffer of TileScratchSize values and gradients a gradient buffer
+// of GradientSize values, laid out like TileScratch and Gradients.
+// The network itself is only read, so several threads can run tiles
+// at the same time, as long as each has its own scratch and gradients.
+template <typename Real>
+void NeuralNetworkT<Real>::BackPropagateTile(const Real* inputs, const Real* desired, int rows,
+					     Real* scratch, Real* gradients, Real& error)
+{
+  int	      r, j, l;
+  int	      nInputs  = Layers[0].NumberOfNodes;
+  int	      nOutputs = Layers[NumberOfLayers-1].NumberOfNodes;
+  Real	      diff;
+  const Real* parentValues;
+  int	      parentStride;
+  Real*	      values;
+  Real*	      errors;
+  Real*	      childErrors;
+  NeuralNetworkLayerT<Real>& outputLayer = Layers[NumberOfLayers-1];
+
+  parentValues = inputs;
+  parentStride = nInputs;
+
+  for(l=1; l<NumberOfLayers; l++)
+    {
+      values = scratch + Layers[l].TileOffset;
+
+      Layers[l].CalculateNeuronValuesBatch(parentValues, parentStride,
+					   values, Layers[l].BatchStride, rows);
+
+      parentValues = values;
+      parentStride = Layers[l].BatchStride;
+    }
+
+  // Each layer's errors follow its tile of values
+  values = scratch + outputLayer.TileOffset;
+  errors = values + BATCH_TILE * outputLayer.BatchStride;
+
+  for(r=0; r<rows; r++)
+    {
+      diff = 0;
+      for(j=0; j<nOutputs; j++)
+	{
+	  diff += pow(values[r * outputLayer.BatchStride + j] - desired[r * nOutputs + j], 2);
+	}
+      error += diff / nOutputs;
+    }
+
+  outputLayer.CalculateErrorsBatch(values, outputLayer.BatchStride, desired, nOutputs,
+				   errors, outputLayer.BatchStride, rows);
+
+  for(l=NumberOfLayers-2; l>0; l--)
+    {
+      values	  = scratch + Layers[l].TileOffset;
+      errors	  = values + BATCH_TILE * Layers[l].BatchStride;
+      childErrors = scratch + Layers[l+1].TileOffset + BATCH_TILE * Layers[l+1].BatchStride;
+
+      Layers[l].CalculateErrorsBatch(values, Layers[l].BatchStride,
+				     childErrors, Layers[l+1].BatchStride,
+				     errors, Layers[l].BatchStride, rows);
+    }
+
+  for(l=NumberOfLayers-2; l>=0; l--)
+    {
+      if(l > 0)
+	{
+	  parentValues = scratch + Layers[l].TileOffset;
+	  parentStride = Layers[l].BatchStride;
+	}
+      else
+	{
+	  parentValues = inputs;
+	  parentStride = nInputs;
+	}
+
+      childErrors = scratch + Layers[l+1].TileOffset + BATCH_TILE * Layers[l+1].BatchStride;
+
+      Layers[l].AccumulateGradients(parentValues, parentStride,
+				    childErrors, Layers[l+1].BatchStride, rows,
+				    gradients + Layers[l].GradientOffset);
+    }
+}
+
+
+
+
+// Adjusts the weights by the gradients summed in Gradients over
+// numSamples samples, and clears them for the next mini-batch.
+template <typename Real>
+void NeuralNetworkT<Real>::ApplyGradients(int numSamples)
+{
+  ApplyGradients(numSamples, Gradients);
+}
+
+
+
+
+// The same, for gradients summed into a gradient buffer of the
+// caller's own, laid out like Gradients (see BackPropagateTile).
+template <typename Real>
+void NeuralNetworkT<Real>::ApplyGradients(int numSamples, Real* gradients)
+{
+  int l;
+
+  for(l=NumberOfLayers-2; l>=0; l--)
+    {
+      Layers[l].ApplyGradients(numSamples, gradients + Layers[l].GradientOffset);
+    }
+}
+
+
+
+
+// The same again, as update number step of the caller's own count,
+// without touching the layers' OptimizerSteps (see the layer's
+// ApplyGradients).
+template <typename Real>
+void NeuralNetworkT<Real>::ApplyGradients(int numSamples, Real* gradients, long step)
+{
+  int l;
+
+  for(l=NumberOfLayers-2; l>=0; l--)
+    {
+      Layers[l].ApplyGradients(numSamples, gradients + Layers[l].GradientOffset, step);
+    }
+}
+
+
+
+
+// Used during training. The errors for the 
+// output and hidden layers are calculated, 
+// and then the weights are adjusted. 
+template <typename Real>
+void NeuralNetworkT<Real>::BackPropagate(void)
+{
+  int l;
+
+  for(l=NumberOfLayers-1; l>0; l--)
+    {
+      Layers[l].CalculateErrors();
+    }
+
+  for(l=NumberOfLayers-2; l>=0; l--)
+    {
+      Layers[l].AdjustWeights();
+    }
+}
+
+
+
+// This function is used to determine which
+// output neuron has the highest output value.
+// This would be useful in a neural net design 
+// with a "winner-takes-all" approach, where
 // you're looking for which output neuron 
 // has the highest activation. 
-int NeuralNetwork::GetMaxOutputID(void)
+template <typename Real>
+int NeuralNetworkT<Real>::GetMaxOutputID(void)
 {
   int		i, id;
-  double	maxval;
+  Real	maxval;
+  NeuralNetworkLayerT<Real>& outputLayer = Layers[NumberOfLayers-1];
 
-  maxval = OutputLayer.NeuronValues[0];
+  maxval = outputLayer.NeuronValues[0];
   id = 0;
 
-  for(i=1; i<OutputLayer.NumberOfNodes; i++)
+  for(i=1; i<outputLayer.NumberOfNodes; i++)
     {
-      if(OutputLayer.NeuronValues[i] > maxval)
+      if(outputLayer.NeuronValues[i] > maxval)
 	{
-	  maxval = OutputLayer.NeuronValues[i];
+	  maxval = outputLayer.NeuronValues[i];
 	  id = i;
 	}
     }
@@ -436,17 +1231,19 @@ int NeuralNetwork::GetMaxOutputID(void)
 // This function is used during training to determine
 // the error between the calculated output, and the
 // desired output put forward by the training data. 
-double NeuralNetwork::CalculateError(void)
+template <typename Real>
+Real NeuralNetworkT<Real>::CalculateError(void)
 {
   int		i;
-  double	error = 0;
+  Real	error = 0;
+  NeuralNetworkLayerT<Real>& outputLayer = Layers[NumberOfLayers-1];
 
-  for(i=0; i<OutputLayer.NumberOfNodes; i++)
+  for(i=0; i<outputLayer.NumberOfNodes; i++)
     {
-      error += pow(OutputLayer.NeuronValues[i] - OutputLayer.DesiredValues[i], 2);
+      error += pow(outputLayer.NeuronValues[i] - outputLayer.DesiredValues[i], 2);
     }
 
-  error = error / OutputLayer.NumberOfNodes;
+  error = error / outputLayer.NumberOfNodes;
 
   return error;
 }
@@ -455,11 +1252,15 @@ double NeuralNetwork::CalculateError(void)
 
 // The learning rate for all layers are set to the
 // same value with this function. 
-void NeuralNetwork::SetLearningRate(double rate)
+template <typename Real>
+void NeuralNetworkT<Real>::SetLearningRate(double rate)
 {
-  InputLayer.LearningRate  = rate;
-  HiddenLayer.LearningRate = rate;
-  OutputLayer.LearningRate = rate;
+  int l;
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      Layers[l].LearningRate = rate;
+    }
 } 
 
 
@@ -470,11 +1271,15 @@ void NeuralNetwork::SetLearningRate(double rate)
 // in this implementation. Something to fix going forward if 
 // I want neural nets to be able to do something besides
 // sigmoid activation functions for the input/hidden layer...
-void NeuralNetwork::SetLinearOutput(bool useLinear)
+template <typename Real>
+void NeuralNetworkT<Real>::SetLinearOutput(bool useLinear)
 {
-  InputLayer.LinearOutput  = useLinear;
-  HiddenLayer.LinearOutput = useLinear;
-  OutputLayer.LinearOutput = useLinear;
+  int l;
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      Layers[l].LinearOutput = useLinear;
+    }
 }
 
 
@@ -484,15 +1289,89 @@ void NeuralNetwork::SetLinearOutput(bool useLinear)
 // help alleviate the problem of hitting local minima/maxima. 
 // The concepts is, with a little extra momentum to the weight
 // adjustment, hoping that it can skip past local minima/maxima
-void NeuralNetwork::SetMomentum(bool useMomentum, double factor)
+template <typename Real>
+void NeuralNetworkT<Real>::SetMomentum(bool useMomentum, double factor)
 {
-  InputLayer.UseMomentum  = useMomentum;
-  HiddenLayer.UseMomentum = useMomentum;
-  OutputLayer.UseMomentum = useMomentum;
+  int l;
 
-  InputLayer.MomentumFactor  = factor;
-  HiddenLayer.MomentumFactor = factor;
-  OutputLayer.MomentumFactor = factor;
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      Layers[l].UseMomentum    = useMomentum;
+      Layers[l].MomentumFactor = factor;
+    }
+}
+
+
+
+
+// Sets the seed Initialize randomizes the weights from. A network
+// starts out seeded from the clock, so only a run that wants to be
+// repeatable needs to call this. It sticks across CleanUp.
+template <typename Real>
+void NeuralNetworkT<Real>::SetRandomSeed(unsigned long long seed)
+{
+  RandomSeed = seed;
+}
+
+
+
+
+// Forgets the weight changes momentum carries over, and any other
+// optimizer state, as if the network had just been read in. A brain
+// file doesn't hold them, so this is where a network read back from
+// one would start.
+template <typename Real>
+void NeuralNetworkT<Real>::ResetMomentum(void)
+{
+  int l;
+
+  for(l=0; l<NumberOfLayers-1; l++)
+    {
+      Layers[l].ResetOptimizer();
+    }
+}
+
+
+
+
+// Chooses the optimizer the weights are updated with, see
+// OptimizerMode in neuralKernels.h, starting it from scratch. Adam
+// gets the usual decays of 0.9 and 0.999, RMSProp a decay of 0.9.
+// Both want a far smaller learning rate than plain SGD, around
+// 0.001. Like the sigmoid mode it sticks across Initialize and
+// ReadData. UseMomentum and MomentumFactor only apply to SGD.
+template <typename Real>
+void NeuralNetworkT<Real>::SetOptimizer(OptimizerMode mode)
+{
+  int l;
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      Layers[l].ResetOptimizer();
+
+      Layers[l].Optimizer = mode;
+      Layers[l].Beta1	  = 0.9;
+      Layers[l].Beta2	  = (mode == OPTIMIZER_RMSPROP) ? 0.9 : 0.999;
+      Layers[l].Epsilon	  = 1e-8;
+    }
+}
+
+
+
+
+// Chooses how the sigmoid is evaluated, see SigmoidMode in
+// neuralKernels.h. Each network has its own setting, so a
+// trainer and an application can pick different ones. It
+// sticks across Initialize and ReadData.
+template <typename Real>
+void NeuralNetworkT<Real>::SetSigmoidMode(SigmoidMode mode)
+{
+  int l;
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      Layers[l].SigmoidMethod = mode;
+    }
 }
 
 
@@ -503,14 +1382,32 @@ void NeuralNetwork::SetMomentum(bool useMomentum, double factor)
 // This dump data is not easily human read,
 // however it's easy to parse by the software
 // for reading in saved networks. 
-void NeuralNetwork::DumpData(string filename)
+//
+// A 3 layer network starts with its three layer sizes, one per
+// line, exactly as it always has. Any other depth starts with a
+// "layers N" line followed by the N sizes. After that come the
+// input values, then the "i j weight" and "j bias" lines of each
+// layer in turn, and finally the "i value" output lines.
+//
+// The file is written under a temporary name and then renamed over
+// filename, so a brain is never left half written, and a network
+// mapped from filename itself (see ReadBinary) can still be saved.
+template <typename Real>
+void NeuralNetworkT<Real>::DumpData(string filename)
 {
-  int i, j;
-  ofstream brainFile(filename.c_str(), ios::out);
+  int i, j, l;
+  string   tempFilename = filename + ".tmp";
+  ofstream brainFile(tempFilename.c_str(), ios::out);
 
-  brainFile<<InputLayer.NumberOfNodes<<endl;
-  brainFile<<HiddenLayer.NumberOfNodes<<endl;
-  brainFile<<OutputLayer.NumberOfNodes<<endl;
+  if(NumberOfLayers != 3)
+    {
+      brainFile<<"layers "<<NumberOfLayers<<"\n";
+    }
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      brainFile<<Layers[l].NumberOfNodes<<"\n";
+    }
 
   // Added these to make sure you keep  fixed
   // point output. 9 decimal places should be 
@@ -518,43 +1415,41 @@ void NeuralNetwork::DumpData(string filename)
   brainFile.precision(9);
   brainFile.setf(ios::fixed);
 
-  for(i=0; i<InputLayer.NumberOfNodes; i++)
+  for(i=0; i<Layers[0].NumberOfNodes; i++)
     {
-      brainFile<<InputLayer.NeuronValues[i]<<endl;
+      brainFile<<Layers[0].NeuronValues[i]<<"\n";
     }
 
-  for(i=0; i<InputLayer.NumberOfNodes; i++)
+  for(l=0; l<NumberOfLayers-1; l++)
     {
-      for(j=0; j<InputLayer.NumberOfChildNodes; j++)
+      NeuralNetworkLayerT<Real>& layer = Layers[l];
+
+      for(i=0; i<layer.NumberOfNodes; i++)
 	{
-	  brainFile<<i<<" "<<j<<" "<<InputLayer.Weights[i][j]<<endl;
+	  for(j=0; j<layer.NumberOfChildNodes; j++)
+	    {
+	      brainFile<<i<<" "<<j<<" "<<layer.Weights[i * layer.WeightStride + j]<<"\n";
+	    }
 	}
-    }
-
-  for(j=0; j<InputLayer.NumberOfChildNodes; j++)
-    {
-      brainFile<<j<<" "<<InputLayer.BiasWeights[j]<<endl;
-    }
 
-  for(i=0; i<HiddenLayer.NumberOfNodes; i++)
-    {
-      for(j=0; j<HiddenLayer.NumberOfChildNodes; j++)
+      for(j=0; j<layer.NumberOfChildNodes; j++)
 	{
-	  brainFile<<i<<" "<<j<<" "<<HiddenLayer.Weights[i][j]<<endl;
+	  brainFile<<j<<" "<<layer.BiasWeights[j]<<"\n";
 	}
     }
 
-  for(j=0; j<HiddenLayer.NumberOfChildNodes; j++)
+  for(i=0; i<Layers[NumberOfLayers-1].NumberOfNodes; i++)
     {
-      brainFile<<j<<" "<<HiddenLayer.BiasWeights[j]<<endl;
+      brainFile<<i<<" "<<Layers[NumberOfLayers-1].NeuronValues[i]<<"\n";
     }
 
-  for(i=0; i<OutputLayer.NumberOfNodes; i++)
+  brainFile.close();
+
+  if(!brainFile || (rename(tempFilename.c_str(), filename.c_str()) != 0))
     {
-      brainFile<<i<<" "<<OutputLayer.NeuronValues[i]<<endl;
+      cout<<"Error, unable to write brain file "<<filename<<"!"<<endl;
+      exit(1);
     }
-
-  brainFile.close();
 }
 
 
@@ -562,110 +1457,570 @@ void NeuralNetwork::DumpData(string filename)
 
 
 // Call this with the name of a saved Neural
-// net instead of calling initialize
-void NeuralNetwork::ReadData(string filename)
+// net instead of calling initialize. It reads
+// both the original 3 layer files and the
+// "layers N" ones DumpData writes for other
+// depths, and hands binary ones to ReadBinary.
+template <typename Real>
+void NeuralNetworkT<Real>::ReadData(string filename)
 {
-  int i, j;
-  int readI, readJ;
+  int	      i, j, l;
+  int	      readI, readJ;
+  int	      numLayers;
+  string      header;
+  vector<int> layerSizes;
+
+  if(IsBinaryBrainFile(filename))
+    {
+      ReadBinary(filename);
+      return;
+    }
 
   ifstream brainFile(filename.c_str(), ios::in);
 
-  brainFile>>InputLayer.NumberOfNodes;
-  brainFile>>HiddenLayer.NumberOfNodes;
-  brainFile>>OutputLayer.NumberOfNodes;
+  brainFile>>header;
 
-//   cout<<"Read in nodes: ("<<InputLayer.NumberOfNodes<<", "
-//       <<HiddenLayer.NumberOfNodes<<", "
-//       <<OutputLayer.NumberOfNodes<<")"<<endl;
-  
-  InputLayer.NumberOfChildNodes  = HiddenLayer.NumberOfNodes;
-  InputLayer.NumberOfParentNodes = 0;
-  InputLayer.Initialize(InputLayer.NumberOfNodes, NULL, &HiddenLayer);
-
-  HiddenLayer.NumberOfParentNodes = InputLayer.NumberOfNodes;
-  HiddenLayer.NumberOfChildNodes  = OutputLayer.NumberOfNodes;
-  HiddenLayer.Initialize(HiddenLayer.NumberOfNodes, 
-			 &InputLayer, &OutputLayer);
-
-  OutputLayer.NumberOfParentNodes = HiddenLayer.NumberOfNodes;
-  OutputLayer.NumberOfChildNodes  = 0;
-  OutputLayer.Initialize(OutputLayer.NumberOfNodes, &HiddenLayer, NULL);
-  
+  if(header == "layers")
+    {
+      brainFile>>numLayers;
+    }
+  else
+    {
+      numLayers = 3;
+    }
+
+  if(!brainFile || (numLayers < 2))
+    {
+      cout<<"Error, bad brainfile in readData, unknown header!"<<endl;
+      brainFile.close();
+      exit(1);
+    }
 
+  layerSizes.resize(numLayers);
 
-  for (i = 0; i < InputLayer.NumberOfNodes; i++)
+  for(l=0; l<numLayers; l++)
     {
-      brainFile>>InputLayer.NeuronValues[i];
+      if((l == 0) && (header != "layers"))
+	{
+	  layerSizes[l] = atoi(header.c_str());
+	}
+      else
+	{
+	  brainFile>>layerSizes[l];
+	}
     }
+
+//   cout<<"Read in "<<numLayers<<" layers"<<endl;
   
-  for (i = 0; i < InputLayer.NumberOfNodes; i++)
+  Allocate(numLayers, &layerSizes[0]);
+
+
+  for (i = 0; i < Layers[0].NumberOfNodes; i++)
     {
-      for (j = 0; j < InputLayer.NumberOfChildNodes; j++)
+      ReadValue(brainFile, Layers[0].NeuronValues[i]);
+    }
+
+  for (l = 0; l < NumberOfLayers-1; l++)
+    {
+      NeuralNetworkLayerT<Real>& layer = Layers[l];
+
+      for (i = 0; i < layer.NumberOfNodes; i++)
+	{
+	  for (j = 0; j < layer.NumberOfChildNodes; j++)
+	    {
+	      brainFile>>readI;
+	      brainFile>>readJ;
+	      if ((readI != i) || (readJ != j))
+		{
+		  cout<<"Error, bad brainfile in readData, weights of layer "<<l<<"!"<<endl;
+		  brainFile.close();
+		  exit(1);
+		}
+	      ReadValue(brainFile, layer.Weights[i * layer.WeightStride + j]);
+	    }
+	}
+
+      for (i = 0; i < layer.NumberOfChildNodes; i++)
 	{
 	  brainFile>>readI;
-	  brainFile>>readJ;
-	  if ((readI != i) || (readJ != j))
+	  if (readI != i)
 	    {
-	      cout<<"Error, bad brainfile in readData 1!"<<endl;
+	      cout<<"Error, bad brainfile in readData, biases of layer "<<l<<"!"<<endl;
+	      cout<<"ReadI is: "<<readI<<" and i is: "<<i<<endl;
 	      brainFile.close();
 	      exit(1);
 	    }
-	  brainFile>>InputLayer.Weights[i][j];
+	  ReadValue(brainFile, layer.BiasWeights[i]);
 	}
     }
 
-  for (i = 0; i < InputLayer.NumberOfChildNodes; i++)
+  for (i = 0 ; i < Layers[NumberOfLayers-1].NumberOfNodes; i++)
     {
       brainFile>>readI;
       if (readI != i)
 	{
-	  cout<<"Error, bad brainfile in readData 2!"<<endl;
+	  cout<<"Error, bad brainfile in readData, output values!"<<endl;
 	  brainFile.close();
 	  exit(1);
 	}
-      brainFile>>InputLayer.BiasWeights[i];
+      ReadValue(brainFile, Layers[NumberOfLayers-1].NeuronValues[i]);
+    }
+
+  brainFile.close();
+}
+
+
+
+// 64 bit FNV-1a, a word at a time, over size bytes (a multiple of 8),
+// carrying on from hash, so a file can be checksummed a block at a time
+unsigned long long BrainChecksum(const void* data, size_t size, unsigned long long hash)
+{
+  size_t i;
+  const unsigned long long* words = (const unsigned long long*) data;
+
+  for(i=0; i<size/8; i++)
+    {
+      hash ^= words[i];
+      hash *= 1099511628211ULL;
+    }
+
+  return hash;
+}
+
+
+
+// Returns whether filename starts like a binary brain file
+bool IsBinaryBrainFile(string filename)
+{
+  char	   magic[8] = { 0 };
+  ifstream brainFile(filename.c_str(), ios::in | ios::binary);
+
+  brainFile.read(magic, sizeof(magic));
+
+  return brainFile && (memcmp(magic, BRAIN_FILE_MAGIC, sizeof(magic)) == 0);
+}
+
+
+
+// Writes count values, then zeros up to the next
+// LAYER_ALIGNMENT bytes, adding them to the checksum
+template <typename Real>
+static void WriteBrainBlock(ofstream& brainFile, const Real* values, size_t count,
+			    unsigned long long& checksum)
+{
+  size_t padded = PadToAlignment<Real>(count);
+  vector<Real> block(padded, (Real) 0);
+
+  memcpy(&block[0], values, sizeof(Real) * count);
+  brainFile.write((const char*) &block[0], sizeof(Real) * padded);
+  checksum = BrainChecksum(&block[0], sizeof(Real) * padded, checksum);
+}
+
+
+
+// How big a binary brain file of FileReal values has to be for
+// layers of these sizes, or 0 if they couldn't fit in maxSize bytes
+template <typename FileReal>
+static size_t BrainFileSize(int numLayers, const int* layerSizes, size_t maxSize)
+{
+  int	 l;
+  size_t rowBytes;
+  size_t size = sizeof(BrainFileHeader) + sizeof(int) * PadToAlignment<int>(numLayers);
+
+  for(l=0; l<numLayers; l++)
+    {
+      if((layerSizes[l] < 1) || ((size_t) layerSizes[l] > maxSize / sizeof(FileReal)))
+	{
+	  return 0;
+	}
     }
 
-  for (i = 0; i < HiddenLayer.NumberOfNodes; i++)
+  size += sizeof(FileReal) * (PadToAlignment<FileReal>(layerSizes[0]) +
+			      PadToAlignment<FileReal>(layerSizes[numLayers-1]));
+
+  for(l=0; l<numLayers-1; l++)
     {
-      for (j = 0; j < HiddenLayer.NumberOfChildNodes; j++)
+      rowBytes = sizeof(FileReal) * PadToAlignment<FileReal>(layerSizes[l+1]);
+
+      if((size_t) layerSizes[l] + 1 > maxSize / rowBytes)
 	{
-	  brainFile>>readI;
-	  brainFile>>readJ;
-	  if ((readI != i) || (readJ != j))
-	    {
-	      cout<<"Error, bad brainfile in readData 3!"<<endl;
-	      brainFile.close();
-	      exit(1);
-	    }
-	  brainFile>>HiddenLayer.Weights[i][j];
+	  return 0;
 	}
+
+      size += ((size_t) layerSizes[l] + 1) * rowBytes;
     }
 
-  for (i = 0; i < HiddenLayer.NumberOfChildNodes; i++)
+  return size;
+}
+
+
+
+// Reads count values of a binary brain file written with another
+// scalar type. The blocks are padded for that type, so this steps
+// the file pointer on past the padding.
+template <typename Real, typename FileReal>
+static void ConvertBrainBlock(const char*& file, Real* values, size_t count)
+{
+  const FileReal* fileValues = (const FileReal*) file;
+  size_t	  i;
+
+  for(i=0; i<count; i++)
     {
-      brainFile>>readI;
-      if (readI != i)
+      values[i] = (Real) fileValues[i];
+    }
+
+  file += sizeof(FileReal) * PadToAlignment<FileReal>(count);
+}
+
+
+
+// Copies everything after the layer sizes in a binary brain file of
+// FileReal values into network, already allocated to those sizes
+template <typename Real, typename FileReal>
+static void ConvertBrainFile(NeuralNetworkT<Real>& network, const char* file)
+{
+  int i, l;
+  int last = network.NumberOfLayers-1;
+
+  ConvertBrainBlock<Real, FileReal>(file, network.Layers[0].NeuronValues,
+				    network.Layers[0].NumberOfNodes);
+
+  for(l=0; l<last; l++)
+    {
+      NeuralNetworkLayerT<Real>& layer = network.Layers[l];
+
+      for(i=0; i<layer.NumberOfNodes; i++)
 	{
-	  cout<<"Error, bad brainfile in readData 4!"<<endl;
-	  cout<<"ReadI is: "<<readI<<" and i is: "<<i<<endl;
-	  brainFile.close();
-	  exit(1);
+	  ConvertBrainBlock<Real, FileReal>(file, layer.Weights + (size_t) i * layer.WeightStride,
+					    layer.NumberOfChildNodes);
 	}
-      brainFile>>HiddenLayer.BiasWeights[i];
+      ConvertBrainBlock<Real, FileReal>(file, layer.BiasWeights, layer.NumberOfChildNodes);
     }
 
-  for (i = 0 ; i < OutputLayer.NumberOfNodes; i++)
+  ConvertBrainBlock<Real, FileReal>(file, network.Layers[last].NeuronValues,
+				    network.Layers[last].NumberOfNodes);
+}
+
+
+
+
+// Saves the network as a binary brain file: a BrainFileHeader and
+// the blocks it describes, in this network's scalar type. ReadBinary
+// (or ReadData) loads one back without parsing anything. Like
+// DumpData, it writes a temporary file and renames it over filename.
+template <typename Real>
+void NeuralNetworkT<Real>::DumpBinary(string filename)
+{
+  int		     i, l;
+  BrainFileHeader    header;
+  unsigned long long checksum = BRAIN_CHECKSUM_SEED;
+  vector<int>	     layerSizes(NumberOfLayers);
+  string	     tempFilename = filename + ".tmp";
+  ofstream	     brainFile(tempFilename.c_str(), ios::out | ios::binary);
+
+  if(!brainFile)
     {
-      brainFile>>readI;
-      if (readI != i)
+      cout<<"Error, unable to write brain file "<<filename<<"!"<<endl;
+      exit(1);
+    }
+
+  // The header goes in last, once the checksum is known
+  memset(&header, 0, sizeof(header));
+  brainFile.write((const char*) &header, sizeof(header));
+
+  for(l=0; l<NumberOfLayers; l++)
+    {
+      layerSizes[l] = Layers[l].NumberOfNodes;
+    }
+  WriteBrainBlock(brainFile, &layerSizes[0], NumberOfLayers, checksum);
+
+  WriteBrainBlock(brainFile, Layers[0].NeuronValues, Layers[0].NumberOfNodes, checksum);
+
+  for(l=0; l<NumberOfLayers-1; l++)
+    {
+      NeuralNetworkLayerT<Real>& layer = Layers[l];
+
+      for(i=0; i<layer.NumberOfNodes; i++)
 	{
-	  cout<<"Error, bad brainfile in readData 5!"<<endl;
-	  brainFile.close();
-	  exit(1);
+	  WriteBrainBlock(brainFile, layer.Weights + (size_t) i * layer.WeightStride,
+			  layer.WeightStride, checksum);
 	}
-      brainFile>>OutputLayer.NeuronValues[i];
+      WriteBrainBlock(brainFile, layer.BiasWeights, layer.NumberOfChildNodes, checksum);
     }
 
+  WriteBrainBlock(brainFile, Layers[NumberOfLayers-1].NeuronValues,
+		  Layers[NumberOfLayers-1].NumberOfNodes, checksum);
+
+  memcpy(header.Magic, BRAIN_FILE_MAGIC, sizeof(header.Magic));
+  header.Version	= BRAIN_FILE_VERSION;
+  header.ScalarSize	= sizeof(Real);
+  header.NumberOfLayers = NumberOfLayers;
+  header.Alignment	= LAYER_ALIGNMENT;
+  header.FileSize	= brainFile.tellp();
+  header.Checksum	= checksum;
+
+  brainFile.seekp(0);
+  brainFile.write((const char*) &header, sizeof(header));
+
   brainFile.close();
+
+  if(!brainFile || (rename(tempFilename.c_str(), filename.c_str()) != 0))
+    {
+      cout<<"Error, unable to write brain file "<<filename<<"!"<<endl;
+      exit(1);
+    }
 }
+
+
+
+
+// Loads a binary brain file written by DumpBinary. The file is mapped
+// privately rather than read, and when it holds this network's scalar
+// type the layers' Weights and BiasWeights point straight into the
+// mapping, so loading costs the same however big the network is, and
+// only the pages of weights actually used are ever read from disk.
+// Training such a network still works, the pages it changes just get
+// copied (the file itself is never written). A file of the other
+// scalar type is converted into the network's own storage instead.
+// The checksum means reading every byte, so it is only checked when
+// verifyChecksum is set. The header is always checked.
+template <typename Real>
+void NeuralNetworkT<Real>::ReadBinary(string filename, bool verifyChecksum)
+{
+  int			 l, fd;
+  struct stat		 fileInfo;
+  void*			 mapping;
+  const BrainFileHeader* header;
+  const char*		 file;
+  const int*		 layerSizes;
+  size_t		 expectedSize;
+
+  fd = open(filename.c_str(), O_RDONLY);
+  if((fd < 0) || (fstat(fd, &fileInfo) != 0) || (fileInfo.st_size < (off_t) sizeof(BrainFileHeader)))
+    {
+      cout<<"Error, unable to open brain file "<<filename<<"!"<<endl;
+      exit(1);
+    }
+
+  mapping = mmap(NULL, fileInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(mapping == MAP_FAILED)
+    {
+      cout<<"Error, unable to map brain file "<<filename<<"!"<<endl;
+      exit(1);
+    }
+
+  header     = (const BrainFileHeader*) mapping;
+  file	     = (const char*) mapping + sizeof(BrainFileHeader);
+  layerSizes = (const int*) file;
+
+  if((memcmp(header->Magic, BRAIN_FILE_MAGIC, sizeof(header->Magic)) != 0) ||
+     (header->Version != BRAIN_FILE_VERSION) ||
+     ((header->ScalarSize != sizeof(float)) && (header->ScalarSize != sizeof(double))) ||
+     (header->Alignment != LAYER_ALIGNMENT) ||
+     (header->FileSize != (unsigned long long) fileInfo.st_size) ||
+     (header->NumberOfLayers < 2) ||
+     (header->NumberOfLayers > (header->FileSize - sizeof(BrainFileHeader)) / sizeof(int)))
+    {
+      cout<<"Error, bad brainfile in readBinary, bad header!"<<endl;
+      exit(1);
+    }
+
+  if(header->ScalarSize == sizeof(float))
+    expectedSize = BrainFileSize<float>(header->NumberOfLayers, layerSizes, header->FileSize);
+  else
+    expectedSize = BrainFileSize<double>(header->NumberOfLayers, layerSizes, header->FileSize);
+
+  if(expectedSize != header->FileSize)
+    {
+      cout<<"Error, bad brainfile in readBinary, wrong size for its layers!"<<endl;
+      exit(1);
+    }
+
+  if(verifyChecksum &&
+     (BrainChecksum(file, header->FileSize - sizeof(BrainFileHeader)) != header->Checksum))
+    {
+      cout<<"Error, bad brainfile in readBinary, checksum mismatch!"<<endl;
+      exit(1);
+    }
+
+  Allocate(header->NumberOfLayers, layerSizes);
+
+  file += sizeof(int) * PadToAlignment<int>(NumberOfLayers);
+
+  if(header->ScalarSize != sizeof(Real))
+    {
+      if(header->ScalarSize == sizeof(float))
+	ConvertBrainFile<Real, float>(*this, file);
+      else
+	ConvertBrainFile<Real, double>(*this, file);
+
+      munmap(mapping, header->FileSize);
+      return;
+    }
+
+  // Same scalar type, so just point the layers at the
+  // blocks, apart from the little input and output values
+  Mapping     = mapping;
+  MappingSize = header->FileSize;
+
+  memcpy(Layers[0].NeuronValues, file, sizeof(Real) * Layers[0].NumberOfNodes);
+  file += sizeof(Real) * PadToAlignment<Real>(Layers[0].NumberOfNodes);
+
+  for(l=0; l<NumberOfLayers-1; l++)
+    {
+      Layers[l].Weights	    = (Real*) file;
+      file += sizeof(Real) * Layers[l].NumberOfNodes * Layers[l].WeightStride;
+      Layers[l].BiasWeights = (Real*) file;
+      file += sizeof(Real) * Layers[l].WeightStride;
+    }
+
+  memcpy(Layers[NumberOfLayers-1].NeuronValues, file,
+	 sizeof(Real) * Layers[NumberOfLayers-1].NumberOfNodes);
+}
+
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// NeuralNetworkContext Class
+/////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename Real>
+NeuralNetworkContextT<Real>::NeuralNetworkContextT()
+{
+  Network      = NULL;
+  Storage      = NULL;
+  NeuronValues = NULL;
+}
+
+
+
+
+// Sets the context up to run network, which has to be initialized
+// (or read in) first. This has to be called again if the network
+// is read in again or changes shape.
+template <typename Real>
+void NeuralNetworkContextT<Real>::Initialize(const NeuralNetworkT<Real>& network)
+{
+  int	 l;
+  size_t total = 0;
+  Real*	 block;
+
+  CleanUp();
+
+  Network      = &network;
+  NeuronValues = new Real*[network.NumberOfLayers];
+
+  for(l=0; l<network.NumberOfLayers; l++)
+    {
+      total += PadToAlignment<Real>(network.Layers[l].NumberOfNodes);
+    }
+
+  if(posix_memalign((void**) &Storage, LAYER_ALIGNMENT, sizeof(Real) * total) != 0)
+    {
+      cout<<"Error, unable to allocate neural network context!"<<endl;
+      exit(1);
+    }
+  memset(Storage, 0, sizeof(Real) * total);
+
+  block = Storage;
+  for(l=0; l<network.NumberOfLayers; l++)
+    {
+      NeuronValues[l] = block;
+      block += PadToAlignment<Real>(network.Layers[l].NumberOfNodes);
+    }
+}
+
+
+
+
+template <typename Real>
+void NeuralNetworkContextT<Real>::CleanUp(void)
+{
+  free(Storage);
+  delete[] NeuronValues;
+
+  Network      = NULL;
+  Storage      = NULL;
+  NeuronValues = NULL;
+}
+
+
+
+
+// The context's own versions of the network's
+// SetInput, GetOutput, FeedForward and
+// GetMaxOutputID, with the same results.
+template <typename Real>
+void NeuralNetworkContextT<Real>::SetInput(int i, Real value)
+{
+  if((i>=0) && (i<Network->Layers[0].NumberOfNodes))
+    {
+      NeuronValues[0][i] = value;
+    }
+}
+
+
+
+template <typename Real>
+Real NeuralNetworkContextT<Real>::GetOutput(int i)
+{
+  int outputLayer = Network->NumberOfLayers-1;
+
+  if((i>=0) && (i<Network->Layers[outputLayer].NumberOfNodes))
+    {
+      return NeuronValues[outputLayer][i];
+    }
+
+  return (Real) INT_MAX; // to indicate an error
+}
+
+
+
+// Each layer goes through as a batch of one sample (so the row
+// strides don't matter), which only reads the network, and so
+// any number of contexts can run it side by side.
+template <typename Real>
+void NeuralNetworkContextT<Real>::FeedForward(void)
+{
+  int l;
+
+  for(l=1; l<Network->NumberOfLayers; l++)
+    {
+      Network->Layers[l].CalculateNeuronValuesBatch(NeuronValues[l-1], 0,
+						    NeuronValues[l], 0, 1);
+    }
+}
+
+
+
+template <typename Real>
+int NeuralNetworkContextT<Real>::GetMaxOutputID(void)
+{
+  int	      i, id;
+  const Real* outputs = NeuronValues[Network->NumberOfLayers-1];
+
+  id = 0;
+
+  for(i=1; i<Network->Layers[Network->NumberOfLayers-1].NumberOfNodes; i++)
+    {
+      if(outputs[i] > outputs[id])
+	{
+	  id = i;
+	}
+    }
+
+  return id;
+}
+
+
+
+// The scalar types networks are built for
+template class NeuralNetworkLayerT<float>;
+template class NeuralNetworkLayerT<double>;
+template class NeuralNetworkT<float>;
+template class NeuralNetworkT<double>;
+template class NeuralNetworkContextT<float>;
+template class NeuralNetworkContextT<double>;
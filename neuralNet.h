@@ -15,68 +15,261 @@ using namespace std;
 #ifndef NEURALNET_H
 #define NEURALNET_H
 
+#include "neuralKernels.h"
+#include "philoxRandom.h"
+
+// Everything a layer owns is carved out of one block aligned
+// to this many bytes, so each array starts on its own cache line.
+#define LAYER_ALIGNMENT 64
+
+// Number of samples FeedForwardBatch pushes through
+// each layer at a time. Its scratch space is sized for this.
+#define BATCH_TILE 64
+
+
+// Binary brain files (see NeuralNetworkT::DumpBinary) start with
+// this header, followed by the layer sizes as NumberOfLayers ints,
+// then the input layer's values, each layer's weights and bias
+// weights, and the output layer's values. Every block is laid out
+// exactly as it is in memory, rows WeightStride apart, and padded
+// to LAYER_ALIGNMENT bytes, so a mapped file can be used as is.
+// Checksum covers everything after the header.
+#define BRAIN_FILE_MAGIC   "NNBRAIN"
+#define BRAIN_FILE_VERSION 1
+
+struct BrainFileHeader
+{
+  char			Magic[8];
+  unsigned int		Version;
+  unsigned int		ScalarSize;	// sizeof(float) or sizeof(double)
+  unsigned int		NumberOfLayers;
+  unsigned int		Alignment;	// always LAYER_ALIGNMENT
+  unsigned long long	FileSize;
+  unsigned long long	Checksum;
+  char			Unused[LAYER_ALIGNMENT - 40];
+};
+
+#define BRAIN_CHECKSUM_SEED 14695981039346656037ULL
+
+bool IsBinaryBrainFile(string filename);
+unsigned long long BrainChecksum(const void* data, size_t size,
+				 unsigned long long hash = BRAIN_CHECKSUM_SEED);
+
+
 // This class implements the layers used in the neural network. 
-// The parent-child relationship is such that the input layer
-// is the parent to the hidden layer, and the hidden layer
-// is the parent to the output layer. The input layer has
-// no parent, and the output layer has no child. 
-class NeuralNetworkLayer
+// The parent-child relationship is such that each layer is the
+// parent of the next one in the network: the input layer is the
+// parent of the first hidden layer, and the last hidden layer is
+// the parent of the output layer. The input layer has no parent,
+// and the output layer has no child. 
+//
+// Weights, WeightChanges and WeightMoments are stored row-major, one
+// row per neuron in this layer, with WeightStride elements per row
+// (NumberOfChildNodes padded out to a whole cache line). Weight
+// i -> j lives at Weights[i * WeightStride + j], so the forward
+// pass, error calculation and weight adjustment all walk the
+// rows in order. WeightChanges and WeightMoments, with BiasChanges
+// and BiasMoments for the bias weights, hold the optimizer's state
+// (see OptimizerMode): the last changes for momentum, or RMSProp's
+// mean squared gradients in WeightMoments, or Adam's mean gradients
+// in WeightChanges and mean squared ones in WeightMoments. Each
+// update streams through a weight row and its state rows together.
+// WeightGradients and BiasGradients, laid out the same way, collect
+// the summed gradients of a mini-batch until they are applied in
+// one update.
+//
+// A layer doesn't allocate anything itself. The network works out
+// how much room each layer needs with StorageSize, allocates one
+// block for all of them, and hands each layer its part of it in
+// Initialize. Gradients and the batched passes' scratch space are
+// kept apart from the weights, in buffers with one part per layer:
+// a layer's gradients start GradientOffset values into a gradient
+// buffer, and its outputs and errors for a tile of BATCH_TILE
+// samples (rows BatchStride apart) start TileOffset values into a
+// tile buffer. That way several threads can each have their own.
+//
+// The scalar type used for weights, activations and errors is a
+// template parameter. Only float and double are instantiated.
+template <typename Real>
+class NeuralNetworkLayerT
 {
  public:
   int		NumberOfNodes;
   int		NumberOfChildNodes;
   int		NumberOfParentNodes;
-  double**	Weights;
-  double**	WeightChanges;
-  double*	NeuronValues;
-  double*	DesiredValues;
-  double*	Errors;
-  double*	BiasWeights;
-  double*	BiasValues;
-  double	LearningRate;
+  int		WeightStride;
+  int		BatchStride;
+  size_t	GradientOffset;
+  size_t	TileOffset;
+  Real*	Weights;
+  Real*	WeightChanges;
+  Real*	WeightMoments;
+  Real*	WeightGradients;
+  Real*	NeuronValues;
+  Real*	DesiredValues;
+  Real*	Errors;
+  Real*	BiasWeights;
+  Real*	BiasValues;
+  Real*	BiasGradients;
+  Real*	BiasChanges;
+  Real*	BiasMoments;
+  Real	LearningRate;
 
   bool		LinearOutput;
   bool		UseMomentum;
-  double	MomentumFactor;
+  Real	MomentumFactor;
+  SigmoidMode	SigmoidMethod;
+  OptimizerMode	Optimizer;
+  Real	Beta1;		// Adam's mean gradient decay
+  Real	Beta2;		// RMSProp's and Adam's mean square decay
+  Real	Epsilon;
+  long		OptimizerSteps;	// updates since the state was last reset
 
-  NeuralNetworkLayer*		ParentLayer;
-  NeuralNetworkLayer*		ChildLayer;
+  NeuralNetworkLayerT*		ParentLayer;
+  NeuralNetworkLayerT*		ChildLayer;
 
-  NeuralNetworkLayer();
+  NeuralNetworkLayerT();
 
-  void	Initialize(int	NumNodes, NeuralNetworkLayer* parent, NeuralNetworkLayer* child);
+  size_t StorageSize(void);
+  size_t GradientSize(void);
+  size_t TileSize(void);
+  void	Initialize(NeuralNetworkLayerT* parent, NeuralNetworkLayerT* child,
+		   Real* block, Real* gradients);
   void	CleanUp(void);
-  void	RandomizeWeights(void);
+  void	RandomizeWeights(unsigned long long seed, unsigned long long stream);
   void	CalculateErrors(void);
   void	AdjustWeights(void);	
   void	CalculateNeuronValues(void);
+  void	CalculateNeuronValuesBatch(const Real* parentValues, int parentStride,
+				   Real* values, int stride, int rows) const;
+  void	CalculateErrorsBatch(const Real* values, int stride,
+			     const Real* targets, int targetStride,
+			     Real* errors, int errorStride, int rows);
+  void	AccumulateGradients(const Real* values, int stride,
+			    const Real* childErrors, int childStride, int rows,
+			    Real* gradients);
+  void	ApplyGradients(int numSamples, Real* gradients);
+  void	ApplyGradients(int numSamples, Real* gradients, long step);
+  void	ResetOptimizer(void);
+
+ private:
+  void	StartUpdate(Real& rate, Real& epsilon);
+  void	StepRate(long step, Real& rate, Real& epsilon) const;
+  void	UpdateRow(Real* w, Real* changes, Real* moments, const Real* gradients,
+		  Real x, Real rate, Real epsilon, int n);
 };
 
 
 
 
-// Implements a 3-Layer neural network with one input layer, one hidden layer, and one output layer
-class NeuralNetwork 
+// Implements a feed-forward neural network with an input layer, any
+// number of hidden layers, and an output layer. Layers[0] is the
+// input layer and Layers[NumberOfLayers-1] the output layer. Every
+// layer, the network's Gradients (GradientSize values) and the
+// TileScratch (TileScratchSize values) the batched passes use, all
+// live in the one Storage block allocated by Initialize or ReadData,
+// so neither the forward nor the backward pass ever allocates. A
+// network read from a binary brain file uses the weights where they
+// lie in the mapped file instead of its own copy of them (see
+// ReadBinary).
+//
+// The neuron values SetInput, FeedForward and GetOutput work on are
+// the network's own, so only one caller can use those at a time. To
+// run one network from several threads at once, give each thread a
+// NeuralNetworkContextT of its own instead (see below), or for
+// batches, a tile buffer of its own to pass FeedForwardBatch.
+template <typename Real>
+class NeuralNetworkT 
 {
  public:
-  NeuralNetworkLayer	InputLayer;
-  NeuralNetworkLayer	HiddenLayer;
-  NeuralNetworkLayer	OutputLayer;
+  int				NumberOfLayers;
+  NeuralNetworkLayerT<Real>*	Layers;
+  Real*			Storage;
+  Real*			Gradients;
+  Real*			TileScratch;
+  size_t			GradientSize;
+  size_t			TileScratchSize;
+  size_t			StorageBytes;
+  void*				Mapping;
+  size_t			MappingSize;
+  unsigned long long		RandomSeed;
+
+  NeuralNetworkT();
 
   void	 Initialize(int nNodesInput, int nNodesHidden, int nNodesOutput);
+  void	 Initialize(int numLayers, const int* layerSizes);
   void	 CleanUp();
-  void	 SetInput(int i, double value);
-  double GetOutput(int i);
-  void	 SetDesiredOutput(int i, double value);
+  void	 SetInput(int i, Real value);
+  Real	 GetOutput(int i);
+  void	 SetDesiredOutput(int i, Real value);
   void	 FeedForward(void);
+  void	 FeedForwardBatch(const Real* inputs, int numSamples, Real* outputs);
+  void	 FeedForwardBatch(const Real* inputs, int numSamples, Real* outputs,
+			  Real* scratch) const;
   void	 BackPropagate(void);
+  Real	 BackPropagateBatch(const Real* inputs, const Real* desired, int numSamples);
+  void	 BackPropagateTile(const Real* inputs, const Real* desired, int rows,
+			   Real* scratch, Real* gradients, Real& error);
+  void	 ApplyGradients(int numSamples);
+  void	 ApplyGradients(int numSamples, Real* gradients);
+  void	 ApplyGradients(int numSamples, Real* gradients, long step);
   int	 GetMaxOutputID(void);
-  double CalculateError(void);
+  Real	 CalculateError(void);
   void	 SetLearningRate(double rate);
   void	 SetLinearOutput(bool useLinear);
   void	 SetMomentum(bool useMomentum, double factor);
+  void	 SetRandomSeed(unsigned long long seed);
+  void	 SetOptimizer(OptimizerMode mode);
+  void	 ResetMomentum(void);
+  void	 SetSigmoidMode(SigmoidMode mode);
   void	 DumpData(string filename);
   void   ReadData(string filename);
+  void	 DumpBinary(string filename);
+  void	 ReadBinary(string filename, bool verifyChecksum = false);
+
+ private:
+  void	 Allocate(int numLayers, const int* layerSizes);
 };
 
+
+
+
+// The neuron values for one caller running a NeuralNetworkT forward,
+// kept apart from the network so that any number of contexts can run
+// the same network at the same time. The network is only read, and
+// has to stay as it is (not be trained or read in again) for as long
+// as its contexts are in use. NeuronValues[l] holds layer l's values,
+// each layer's on its own cache lines.
+template <typename Real>
+class NeuralNetworkContextT
+{
+ public:
+  const NeuralNetworkT<Real>*	Network;
+  Real*				Storage;
+  Real**			NeuronValues;
+
+  NeuralNetworkContextT();
+
+  void	 Initialize(const NeuralNetworkT<Real>& network);
+  void	 CleanUp(void);
+  void	 SetInput(int i, Real value);
+  Real	 GetOutput(int i);
+  void	 FeedForward(void);
+  int	 GetMaxOutputID(void);
+};
+
+
+
+
+// The original double precision network, used for training, and
+// a single precision one that halves the memory traffic (and doubles
+// the SIMD width) for inference. Both read and write the same text
+// brain files.
+typedef NeuralNetworkLayerT<double>	NeuralNetworkLayer;
+typedef NeuralNetworkT<double>		NeuralNetwork;
+typedef NeuralNetworkLayerT<float>	NeuralNetworkLayerF;
+typedef NeuralNetworkT<float>		NeuralNetworkF;
+typedef NeuralNetworkContextT<double>	NeuralNetworkContext;
+typedef NeuralNetworkContextT<float>	NeuralNetworkContextF;
+
 #endif   // NEURALNET_H
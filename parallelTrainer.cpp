@@ -0,0 +1,226 @@
+#include "parallelTrainer.h"
+#include "neuralKernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+/*
+  See parallelTrainer.h. Each shard's gradient buffer has one extra
+  value on the end for the shard's summed error, so the errors are
+  reduced along with the gradients, and every buffer starts on its
+  own cache line so no two threads ever write to the same line.
+*/
+//---------------------------------------------------------------------------
+
+// Below this many values per tree level, adding the shard buffers
+// together isn't worth waking the other threads for
+#define PARALLEL_REDUCE_MIN 16384
+
+
+
+static void* AllocateAligned(size_t bytes)
+{
+  void* memory;
+
+  if(posix_memalign(&memory, LAYER_ALIGNMENT, bytes) != 0)
+    {
+      cout<<"Error, unable to allocate parallel trainer buffers!"<<endl;
+      exit(1);
+    }
+
+  memset(memory, 0, bytes);
+  return memory;
+}
+
+
+
+
+template <typename Real>
+ParallelTrainerT<Real>::ParallelTrainerT()
+{
+  Network	 = NULL;
+  NumberOfThreads = 0;
+  MaxShards	 = 0;
+  GradientStride = 0;
+  ShardGradients = NULL;
+  ThreadScratch	 = NULL;
+}
+
+
+
+template <typename Real>
+ParallelTrainerT<Real>::~ParallelTrainerT()
+{
+  CleanUp();
+}
+
+
+
+
+// Sets up numThreads threads to train network, in batches of at
+// most maxBatchSize samples. The network has to be initialized (or
+// read in) first, and this has to be called again if it changes shape.
+template <typename Real>
+void ParallelTrainerT<Real>::Initialize(NeuralNetworkT<Real>* network, int numThreads, int maxBatchSize)
+{
+  int	 t;
+  size_t perLine = LAYER_ALIGNMENT / sizeof(Real);
+
+  CleanUp();
+
+  if(numThreads < 1)
+    {
+      numThreads = 1;
+    }
+
+  Network	 = network;
+  NumberOfThreads = numThreads;
+  MaxShards	 = (maxBatchSize + BATCH_TILE - 1) / BATCH_TILE;
+  GradientStride = ((Network->GradientSize + 1 + perLine - 1) / perLine) * perLine;
+  ShardGradients = (Real*) AllocateAligned(sizeof(Real) * GradientStride * MaxShards);
+
+  ThreadScratch = new Real*[numThreads];
+  for(t=0; t<numThreads; t++)
+    {
+      ThreadScratch[t] = (Real*) AllocateAligned(sizeof(Real) * Network->TileScratchSize);
+    }
+
+  Pool.Start(numThreads);
+}
+
+
+
+template <typename Real>
+void ParallelTrainerT<Real>::CleanUp(void)
+{
+  int t;
+
+  if(ThreadScratch != NULL)
+    {
+      for(t=0; t<NumberOfThreads; t++)
+	{
+	  free(ThreadScratch[t]);
+	}
+      delete[] ThreadScratch;
+    }
+
+  Pool.Stop();
+  free(ShardGradients);
+
+  Network	 = NULL;
+  NumberOfThreads = 0;
+  MaxShards	 = 0;
+  ShardGradients = NULL;
+  ThreadScratch	 = NULL;
+}
+
+
+
+
+// Runs one shard of the batch on whichever thread picked it up,
+// into the shard's own gradient buffer
+template <typename Real>
+void ParallelTrainerT<Real>::ShardTask(void* data, int shard, int thread)
+{
+  ParallelTrainerT* trainer   = (ParallelTrainerT*) data;
+  NeuralNetworkT<Real>* network = trainer->Network;
+  int	first	 = shard * BATCH_TILE;
+  int	rows	 = trainer->BatchSamples - first;
+  int	nInputs	 = network->Layers[0].NumberOfNodes;
+  int	nOutputs = network->Layers[network->NumberOfLayers-1].NumberOfNodes;
+  Real* gradients = trainer->ShardGradients + shard * trainer->GradientStride;
+  Real	error	 = 0;
+
+  if(rows > BATCH_TILE)
+    {
+      rows = BATCH_TILE;
+    }
+
+  memset(gradients, 0, sizeof(Real) * trainer->GradientStride);
+
+  network->BackPropagateTile(trainer->BatchInputs + first * nInputs,
+			     trainer->BatchDesired + first * nOutputs, rows,
+			     trainer->ThreadScratch[thread], gradients, error);
+
+  gradients[network->GradientSize] = error;
+}
+
+
+
+
+// Adds shard 2 * pair * ReduceStep + ReduceStep into
+// shard 2 * pair * ReduceStep, gradients and error both
+template <typename Real>
+void ParallelTrainerT<Real>::ReduceTask(void* data, int pair, int thread)
+{
+  ParallelTrainerT* trainer = (ParallelTrainerT*) data;
+  size_t target = (size_t) 2 * pair * trainer->ReduceStep;
+  size_t source = target + trainer->ReduceStep;
+  const NeuralKernels<Real>& kernels = GetNeuralKernels<Real>();
+
+  kernels.Axpy(1, trainer->ShardGradients + source * trainer->GradientStride,
+	       trainer->ShardGradients + target * trainer->GradientStride,
+	       trainer->GradientStride);
+}
+
+
+
+
+// The parallel version of NeuralNetworkT::BackPropagateBatch, with
+// the same arguments and result: one weight update by the mean
+// gradient of the numSamples samples, returning their mean error.
+template <typename Real>
+Real ParallelTrainerT<Real>::BackPropagateBatch(const Real* inputs, const Real* desired, int numSamples)
+{
+  int  numShards = (numSamples + BATCH_TILE - 1) / BATCH_TILE;
+  int  numPairs, pair;
+  Real error;
+
+  if(numShards > MaxShards)
+    {
+      cout<<"Error, batch of "<<numSamples<<" samples is bigger than the parallel trainer was set up for!"<<endl;
+      exit(1);
+    }
+
+  if(numSamples <= 0)
+    {
+      return 0;
+    }
+
+  BatchInputs  = inputs;
+  BatchDesired = desired;
+  BatchSamples = numSamples;
+
+  Pool.Run(ShardTask, this, numShards);
+
+  // Shard s + step goes into shard s, for every s that's a multiple
+  // of 2 * step, doubling step until everything is in shard 0
+  for(ReduceStep=1; ReduceStep<numShards; ReduceStep*=2)
+    {
+      numPairs = (numShards - ReduceStep + 2 * ReduceStep - 1) / (2 * ReduceStep);
+
+      if(numPairs * GradientStride >= PARALLEL_REDUCE_MIN)
+	{
+	  Pool.Run(ReduceTask, this, numPairs);
+	}
+      else
+	{
+	  for(pair=0; pair<numPairs; pair++)
+	    {
+	      ReduceTask(this, pair, 0);
+	    }
+	}
+    }
+
+  error = ShardGradients[Network->GradientSize];
+
+  Network->ApplyGradients(numSamples, ShardGradients);
+
+  return error / numSamples;
+}
+
+
+
+// The scalar types networks are built for
+template class ParallelTrainerT<float>;
+template class ParallelTrainerT<double>;
@@ -0,0 +1,62 @@
+//---------------------------------------------------------------------------
+/*
+  Data-parallel mini-batch training for a NeuralNetworkT. Each batch
+  is cut into shards of BATCH_TILE samples. The worker threads run
+  the shards through NeuralNetworkT::BackPropagateTile, each shard
+  summing its gradients into a buffer of its own. The shard buffers
+  are then added together pairwise, in a tree that only depends on
+  the number of shards, and the network is updated once by the total.
+
+  Since neither the shards nor the order they're added in depend on
+  the thread count, the weights come out bit for bit the same with
+  any number of threads, one included. (They aren't the same bits as
+  NeuralNetworkT::BackPropagateBatch gives, which adds everything up
+  in one running sum, but agree with it to rounding.)
+
+  A batch only has one shard per BATCH_TILE samples, so to keep N
+  threads busy it needs at least N * BATCH_TILE samples in it.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef PARALLELTRAINER_H
+#define PARALLELTRAINER_H
+
+#include "neuralNet.h"
+#include "threadPool.h"
+
+
+template <typename Real>
+class ParallelTrainerT
+{
+ public:
+  ParallelTrainerT();
+  ~ParallelTrainerT();
+
+  void	Initialize(NeuralNetworkT<Real>* network, int numThreads, int maxBatchSize);
+  void	CleanUp(void);
+  Real	BackPropagateBatch(const Real* inputs, const Real* desired, int numSamples);
+
+ private:
+  static void ShardTask(void* data, int shard, int thread);
+  static void ReduceTask(void* data, int pair, int thread);
+
+  NeuralNetworkT<Real>* Network;
+  ThreadPool		Pool;
+  int			NumberOfThreads;
+  int			MaxShards;
+  size_t		GradientStride;	// GradientSize, padded to a cache line
+  Real*			ShardGradients;	// MaxShards buffers, GradientStride apart
+  Real**		ThreadScratch;	// one tile buffer per thread
+
+  // The batch being worked on
+  const Real*		BatchInputs;
+  const Real*		BatchDesired;
+  int			BatchSamples;
+  int			ReduceStep;
+};
+
+
+typedef ParallelTrainerT<double>	ParallelTrainer;
+typedef ParallelTrainerT<float>		ParallelTrainerF;
+
+#endif   // PARALLELTRAINER_H
@@ -0,0 +1,144 @@
+//---------------------------------------------------------------------------
+/*
+  Philox4x32-10, the counter-based random number generator from
+  Salmon, Moraes, Dror and Shaw, "Parallel Random Numbers: As Easy as
+  1, 2, 3" (SC11). Every random value is a pure function of a 64 bit
+  seed, a 64 bit stream number and the value's position in the
+  stream, so there's no shared state to contend on. Any thread can
+  jump straight to any position in any stream, and a run with the
+  same seed gives the same values however the work is split up.
+
+  Each kind of use draws from its own streams (see RANDOM_STREAM_*),
+  so adding draws to one never shifts the values another one sees.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef PHILOXRANDOM_H
+#define PHILOXRANDOM_H
+
+
+// Stream numbers for each use of random numbers.
+// The low 32 bits pick, say, a layer or an epoch.
+#define RANDOM_STREAM_WEIGHTS	(1ULL << 32)	// + layer number
+#define RANDOM_STREAM_SAMPLING	(2ULL << 32)	// + anything a trainer likes
+#define RANDOM_STREAM_SHUFFLE	(3ULL << 32)	// + epoch number
+#define RANDOM_STREAM_VALIDATION (4ULL << 32)	// picking validation samples
+#define RANDOM_STREAM_DROPS	(5ULL << 32)	// simulated box drops
+#define RANDOM_STREAM_EVOLUTION	(6ULL << 32)	// + generation number
+
+
+class PhiloxRandom
+{
+ public:
+  PhiloxRandom(unsigned long long seed = 0, unsigned long long stream = 0)
+    {
+      Seed(seed, stream);
+    }
+
+  // Starts stream number stream of the generator
+  // seeded with seed, from the beginning
+  void Seed(unsigned long long seed, unsigned long long stream)
+    {
+      Key[0]	 = (unsigned int) seed;
+      Key[1]	 = (unsigned int) (seed >> 32);
+      Counter[2] = (unsigned int) stream;
+      Counter[3] = (unsigned int) (stream >> 32);
+      SetPosition(0);
+    }
+
+  // Jumps to the position'th 32 bit value of the stream
+  void SetPosition(unsigned long long position)
+    {
+      Counter[0] = (unsigned int) (position / 4);
+      Counter[1] = (unsigned int) (position / 4 >> 32);
+      Used	 = position % 4;
+      Generate();
+    }
+
+  // The next 32 random bits
+  unsigned int NextInt(void)
+    {
+      if(Used == 4)
+	{
+	  if(++Counter[0] == 0)
+	    {
+	      Counter[1]++;
+	    }
+	  Generate();
+	  Used = 0;
+	}
+
+      return Block[Used++];
+    }
+
+  // A value from 0 to n-1, always from exactly one NextInt, so
+  // positions stay predictable. (Multiplying rather than rejecting
+  // leaves a bias of under n / 2^32, far too small to matter here.)
+  unsigned int NextBelow(unsigned int n)
+    {
+      return (unsigned int) (((unsigned long long) NextInt() * n) >> 32);
+    }
+
+  // A value in [0, 1), with 53 random bits, from two NextInts
+  double NextDouble(void)
+    {
+      unsigned long long high = NextInt() >> 5;
+      unsigned long long low  = NextInt() >> 6;
+
+      return (high * 67108864.0 + low) / 9007199254740992.0;
+    }
+
+  // Fisher-Yates shuffles count values into a random order
+  template <typename T>
+  void Shuffle(T* values, long count)
+    {
+      long i, j;
+      T	   swap;
+
+      for(i=count-1; i>0; i--)
+	{
+	  j = NextBelow(i + 1);
+
+	  swap	    = values[i];
+	  values[i] = values[j];
+	  values[j] = swap;
+	}
+    }
+
+ private:
+  unsigned int Key[2];
+  unsigned int Counter[4];	// position / 4, then the stream
+  unsigned int Block[4];	// Philox of Counter
+  int	       Used;		// values of Block handed out
+
+  // Ten Philox rounds of Counter under Key, into Block
+  void Generate(void)
+    {
+      unsigned int	 c0 = Counter[0], c1 = Counter[1], c2 = Counter[2], c3 = Counter[3];
+      unsigned int	 k0 = Key[0], k1 = Key[1];
+      unsigned long long product0, product1;
+      int		 round;
+
+      for(round=0; round<10; round++)
+	{
+	  product0 = 0xD2511F53ULL * c0;
+	  product1 = 0xCD9E8D57ULL * c2;
+
+	  c0 = (unsigned int) (product1 >> 32) ^ c1 ^ k0;
+	  c2 = (unsigned int) (product0 >> 32) ^ c3 ^ k1;
+	  c1 = (unsigned int) product1;
+	  c3 = (unsigned int) product0;
+
+	  k0 += 0x9E3779B9;
+	  k1 += 0xBB67AE85;
+	}
+
+      Block[0] = c0;
+      Block[1] = c1;
+      Block[2] = c2;
+      Block[3] = c3;
+    }
+};
+
+
+#endif   // PHILOXRANDOM_H
@@ -0,0 +1,523 @@
+#include "quantizedNet.h"
+#include "neuralKernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <fstream>
+
+//---------------------------------------------------------------------------
+/*
+  Fixed point inference engine for trained neural networks. See
+  quantizedNet.h for the number formats.
+*/
+//---------------------------------------------------------------------------
+
+
+// Weighted sums are accumulated in 32 bits. Keeping every input,
+// weight and bias term below this bound guarantees that can't
+// overflow, however the values happen to line up.
+#define ACCUMULATOR_LIMIT (1 << 30)
+
+
+// Rounds a count of values up to a whole number of SIMD blocks
+static int PadToBlocks(int count)
+{
+  return ((count + QUANTIZED_PADDING - 1) / QUANTIZED_PADDING) * QUANTIZED_PADDING;
+}
+
+
+
+static void* AllocateAligned(size_t bytes)
+{
+  void* block;
+
+  if(posix_memalign(&block, LAYER_ALIGNMENT, bytes) != 0)
+    {
+      cout<<"Error, unable to allocate quantized network!"<<endl;
+      exit(1);
+    }
+
+  memset(block, 0, bytes);
+  return block;
+}
+
+
+
+// The Q14 sigmoid table, sampled every 1/SIGMOID_STEPS_PER_UNIT
+// from -SIGMOID_RANGE to SIGMOID_RANGE
+struct IntegerSigmoidTable
+{
+  short Values[SIGMOID_TABLE_SIZE];
+
+  IntegerSigmoidTable()
+  {
+    int	   i;
+    double z;
+
+    for(i=0; i<SIGMOID_TABLE_SIZE; i++)
+      {
+	z	  = (double) i / SIGMOID_STEPS_PER_UNIT - SIGMOID_RANGE;
+	Values[i] = (short) lrint(ACTIVATION_ONE / (1 + exp(-z)));
+      }
+  }
+};
+
+
+// Built the first time any network runs. The static's
+// initialization is thread safe, so a fleet of agents can all
+// start feeding forward at once.
+static const short* SigmoidTable(void)
+{
+  static const IntegerSigmoidTable table;
+
+  return table.Values;
+}
+
+
+
+// Integer sigmoid of a Q10 weighted sum, giving a Q14 activation.
+// Linear interpolation between table entries keeps the error
+// around 1e-4, about the same as the Q14 rounding itself.
+static short IntegerSigmoid(int z)
+{
+  const short* table	= SigmoidTable();
+  const int    stepBits = 6;   // log2(PREACTIVATION_ONE / SIGMOID_STEPS_PER_UNIT)
+  const int    stepMask = (1 << stepBits) - 1;
+  int	       t, index, fraction;
+
+  t = z + SIGMOID_RANGE * PREACTIVATION_ONE;
+
+  if(t <= 0)
+    {
+      return table[0];
+    }
+
+  if(t >= 2 * SIGMOID_RANGE * PREACTIVATION_ONE)
+    {
+      return table[SIGMOID_TABLE_SIZE - 1];
+    }
+
+  index	   = t >> stepBits;
+  fraction = t & stepMask;
+
+  return (short) (table[index] +
+		  (((table[index+1] - table[index]) * fraction + (1 << (stepBits - 1))) >> stepBits));
+}
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// QuantizedLayer Class
+/////////////////////////////////////////////////////////////////////////////////////////////////
+QuantizedLayer::QuantizedLayer()
+{
+  NumberOfInputs  = 0;
+  NumberOfOutputs = 0;
+  InputStride	  = 0;
+  Weights	  = NULL;
+  Biases	  = NULL;
+  WeightScale	  = 1;
+  Multiplier	  = 0;
+  Shift		  = 0;
+  LinearOutput	  = false;
+}
+
+
+
+void QuantizedLayer::Initialize(int numInputs, int numOutputs)
+{
+  NumberOfInputs  = numInputs;
+  NumberOfOutputs = numOutputs;
+  InputStride	  = PadToBlocks(numInputs);
+
+  Weights = (short*) AllocateAligned(sizeof(short) * NumberOfOutputs * InputStride);
+  Biases  = (int*) AllocateAligned(sizeof(int) * NumberOfOutputs);
+}
+
+
+
+void QuantizedLayer::CleanUp(void)
+{
+  free(Weights);
+  free(Biases);
+
+  Weights = NULL;
+  Biases  = NULL;
+}
+
+
+
+// Builds this layer from the weights a NeuralNetworkLayer holds for
+// its children. One scale factor covers all the weights and bias
+// terms of the layer, chosen as large as possible while still
+// keeping the 32 bit sums safe for this many inputs.
+void QuantizedLayer::Quantize(const NeuralNetworkLayer& parent)
+{
+  int	 i, j;
+  int	 exponent;
+  int	 limit;
+  double maxAbs = 0;
+  double bias, factor, mantissa;
+
+  const NeuralNetworkLayer* child = parent.ChildLayer;
+
+  LinearOutput = (child->ChildLayer == NULL) && child->LinearOutput;
+
+  for(i=0; i<NumberOfInputs; i++)
+    {
+      for(j=0; j<NumberOfOutputs; j++)
+	{
+	  maxAbs = fmax(maxAbs, fabs(parent.Weights[i * parent.WeightStride + j]));
+	}
+    }
+
+  for(j=0; j<NumberOfOutputs; j++)
+    {
+      maxAbs = fmax(maxAbs, fabs(parent.BiasValues[j] * parent.BiasWeights[j]));
+    }
+
+  // Each of the inputs plus the bias can contribute at most
+  // limit * ACTIVATION_ONE to the sum
+  limit = ACCUMULATOR_LIMIT / (ACTIVATION_ONE * (NumberOfInputs + 1));
+  if(limit > 32767)
+    {
+      limit = 32767;
+    }
+
+  WeightScale = (maxAbs > 0) ? maxAbs / limit : 1;
+
+  for(j=0; j<NumberOfOutputs; j++)
+    {
+      for(i=0; i<NumberOfInputs; i++)
+	{
+	  Weights[j * InputStride + i] =
+	    (short) lrint(parent.Weights[i * parent.WeightStride + j] / WeightScale);
+	}
+
+      bias      = parent.BiasValues[j] * parent.BiasWeights[j];
+      Biases[j] = (int) lrint(bias / WeightScale * ACTIVATION_ONE);
+    }
+
+  // The factor taking a sum to Q10 is WeightScale * 1024 / 16384,
+  // held as a 15 bit multiplier and a right shift
+  factor     = WeightScale * PREACTIVATION_ONE / ACTIVATION_ONE;
+  mantissa   = frexp(factor, &exponent);
+  Multiplier = (int) lrint(mantissa * 32768);
+  Shift	     = 15 - exponent;
+
+  if(Multiplier == 32768)
+    {
+      Multiplier /= 2;
+      Shift--;
+    }
+}
+
+
+
+// Runs one layer. inputs holds InputStride Q14 values (zero padded).
+// The Q14 activations go to outputs, and if realOutputs isn't NULL
+// the same values are also written there as floats.
+void QuantizedLayer::CalculateOutputs(const short* inputs, short* outputs, float* realOutputs)
+{
+  int	    j;
+  int	    sum, z;
+  short	    value;
+  long long product;
+  double    real;
+  const QuantizedKernels& kernels = GetQuantizedKernels();
+
+  for(j=0; j<NumberOfOutputs; j++)
+    {
+      sum = kernels.DotInt16(inputs, Weights + j * InputStride, InputStride) + Biases[j];
+
+      if(LinearOutput)
+	{
+	  real  = sum * WeightScale;
+	  value = (short) lrint(fmax(fmin(real, 32767), -32768));
+	  real /= ACTIVATION_ONE;
+	}
+      else
+	{
+	  product = (long long) sum * Multiplier;
+	  z	  = (int) ((product + (1LL << (Shift - 1))) >> Shift);
+	  value	  = IntegerSigmoid(z);
+	  real	  = (double) value / ACTIVATION_ONE;
+	}
+
+      if(outputs != NULL)
+	{
+	  outputs[j] = value;
+	}
+
+      if(realOutputs != NULL)
+	{
+	  realOutputs[j] = (float) real;
+	}
+    }
+}
+
+
+
+
+
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// QuantizedNeuralNetwork Class
+/////////////////////////////////////////////////////////////////////////////////////////////////
+QuantizedNeuralNetwork::QuantizedNeuralNetwork()
+{
+  InputValues  = NULL;
+  HiddenValues = NULL;
+  OutputValues = NULL;
+}
+
+
+
+void QuantizedNeuralNetwork::AllocateActivations(void)
+{
+  InputValues  = (short*) AllocateAligned(sizeof(short) * HiddenLayer.InputStride);
+  HiddenValues = (short*) AllocateAligned(sizeof(short) * OutputLayer.InputStride);
+  OutputValues = (float*) AllocateAligned(sizeof(float) * OutputLayer.NumberOfOutputs);
+}
+
+
+
+// Builds the fixed point version of a trained network, in place of
+// whatever this one held before. Only networks with exactly one
+// hidden layer can be quantized.
+void QuantizedNeuralNetwork::Quantize(const NeuralNetwork& network)
+{
+  if(network.NumberOfLayers != 3)
+    {
+      cout<<"Error, only 3 layer networks can be quantized!"<<endl;
+      exit(1);
+    }
+
+  CleanUp();
+
+  HiddenLayer.Initialize(network.Layers[0].NumberOfNodes, network.Layers[1].NumberOfNodes);
+  HiddenLayer.Quantize(network.Layers[0]);
+
+  OutputLayer.Initialize(network.Layers[1].NumberOfNodes, network.Layers[2].NumberOfNodes);
+  OutputLayer.Quantize(network.Layers[1]);
+
+  AllocateActivations();
+}
+
+
+
+void QuantizedNeuralNetwork::CleanUp(void)
+{
+  HiddenLayer.CleanUp();
+  OutputLayer.CleanUp();
+
+  free(InputValues);
+  free(HiddenValues);
+  free(OutputValues);
+
+  InputValues  = NULL;
+  HiddenValues = NULL;
+  OutputValues = NULL;
+}
+
+
+
+// Inputs are clamped to the Q14 range, -2.0 to just under 2.0
+void QuantizedNeuralNetwork::SetInput(int i, float value)
+{
+  if((i>=0) && (i<HiddenLayer.NumberOfInputs))
+    {
+      value = fmaxf(fminf(value, 32767.0f / ACTIVATION_ONE), -2.0f);
+      InputValues[i] = (short) lrintf(value * ACTIVATION_ONE);
+    }
+}
+
+
+
+float QuantizedNeuralNetwork::GetOutput(int i)
+{
+  if((i>=0) && (i<OutputLayer.NumberOfOutputs))
+    {
+      return OutputValues[i];
+    }
+
+  return (float) INT_MAX; // to indicate an error
+}
+
+
+
+void QuantizedNeuralNetwork::FeedForward(void)
+{
+  HiddenLayer.CalculateOutputs(InputValues, HiddenValues, NULL);
+  OutputLayer.CalculateOutputs(HiddenValues, NULL, OutputValues);
+}
+
+
+
+// Compares this network against the double precision one it was
+// built from, and returns the largest difference seen in any output.
+// Every combination of -1, 0 and 1 on the inputs is tried (for up to
+// 8 inputs), followed by numSamples inputs drawn uniformly from -1
+// to 1, which is the range the simulator feeds the network.
+double QuantizedNeuralNetwork::MeasureError(NeuralNetwork& network, int numSamples)
+{
+  int	       i, k, code, numCorners;
+  int	       numInputs  = HiddenLayer.NumberOfInputs;
+  int	       numOutputs = OutputLayer.NumberOfOutputs;
+  double       worst	  = 0;
+  double       value;
+  unsigned int state	  = 12345;
+
+  numCorners = 0;
+  if(numInputs <= 8)
+    {
+      numCorners = 1;
+      for(i=0; i<numInputs; i++)
+	{
+	  numCorners *= 3;
+	}
+    }
+
+  for(k=0; k<numCorners+numSamples; k++)
+    {
+      code = k;
+
+      for(i=0; i<numInputs; i++)
+	{
+	  if(k < numCorners)
+	    {
+	      value = (code % 3) - 1.0;
+	      code /= 3;
+	    }
+	  else
+	    {
+	      // Plain LCG, so the samples are the same every run
+	      state = state * 1664525u + 1013904223u;
+	      value = (state >> 8) / 8388608.0 - 1.0;
+	    }
+
+	  SetInput(i, value);
+	  network.SetInput(i, value);
+	}
+
+      FeedForward();
+      network.FeedForward();
+
+      for(i=0; i<numOutputs; i++)
+	{
+	  worst = fmax(worst, fabs(GetOutput(i) - network.GetOutput(i)));
+	}
+    }
+
+  return worst;
+}
+
+
+
+// Saves the quantized network as text, in the same
+// spirit as NeuralNetwork::DumpData. A header line
+// marks it as a quantized brain.
+void QuantizedNeuralNetwork::DumpData(string filename)
+{
+  int		  i, j, l;
+  QuantizedLayer* layers[2] = { &HiddenLayer, &OutputLayer };
+  ofstream	  brainFile(filename.c_str(), ios::out);
+
+  brainFile<<"QBRAIN 1"<<"\n";
+  brainFile<<HiddenLayer.NumberOfInputs<<"\n";
+  brainFile<<HiddenLayer.NumberOfOutputs<<"\n";
+  brainFile<<OutputLayer.NumberOfOutputs<<"\n";
+
+  brainFile.precision(17);
+
+  for(l=0; l<2; l++)
+    {
+      QuantizedLayer& layer = *layers[l];
+
+      brainFile<<layer.LinearOutput<<" "<<layer.WeightScale<<" "
+	       <<layer.Multiplier<<" "<<layer.Shift<<"\n";
+
+      for(j=0; j<layer.NumberOfOutputs; j++)
+	{
+	  for(i=0; i<layer.NumberOfInputs; i++)
+	    {
+	      brainFile<<layer.Weights[j * layer.InputStride + i]<<" ";
+	    }
+	  brainFile<<layer.Biases[j]<<"\n";
+	}
+    }
+
+  brainFile.close();
+}
+
+
+
+// Loads a network saved by DumpData, in place of
+// whatever this one held before
+void QuantizedNeuralNetwork::ReadData(string filename)
+{
+  int		  i, j, l;
+  int		  version;
+  int		  nInputs, nHidden, nOutputs;
+  string	  magic;
+  QuantizedLayer* layers[2] = { &HiddenLayer, &OutputLayer };
+  ifstream	  brainFile(filename.c_str(), ios::in);
+
+  brainFile>>magic>>version;
+  if(!brainFile || (magic != "QBRAIN") || (version != 1))
+    {
+      cout<<"Error, "<<filename<<" is not a quantized brain file!"<<endl;
+      exit(1);
+    }
+
+  brainFile>>nInputs>>nHidden>>nOutputs;
+  if(!brainFile || (nInputs <= 0) || (nHidden <= 0) || (nOutputs <= 0))
+    {
+      cout<<"Error, bad layer sizes in quantized brainfile "<<filename<<"!"<<endl;
+      brainFile.close();
+      exit(1);
+    }
+
+  CleanUp();
+
+  HiddenLayer.Initialize(nInputs, nHidden);
+  OutputLayer.Initialize(nHidden, nOutputs);
+
+  for(l=0; l<2; l++)
+    {
+      QuantizedLayer& layer = *layers[l];
+
+      // CalculateOutputs rounds by 1 << (Shift - 1)
+      brainFile>>layer.LinearOutput>>layer.WeightScale>>layer.Multiplier>>layer.Shift;
+      if(!brainFile || (layer.Shift < 1) || (layer.Shift > 62))
+	{
+	  cout<<"Error, bad layer scaling in quantized brainfile "<<filename<<"!"<<endl;
+	  brainFile.close();
+	  exit(1);
+	}
+
+      for(j=0; j<layer.NumberOfOutputs; j++)
+	{
+	  for(i=0; i<layer.NumberOfInputs; i++)
+	    {
+	      brainFile>>layer.Weights[j * layer.InputStride + i];
+	    }
+	  brainFile>>layer.Biases[j];
+	}
+    }
+
+  if(!brainFile)
+    {
+      cout<<"Error, bad quantized brainfile in ReadData!"<<endl;
+      brainFile.close();
+      exit(1);
+    }
+
+  brainFile.close();
+
+  AllocateActivations();
+}
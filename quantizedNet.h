@@ -0,0 +1,86 @@
+//---------------------------------------------------------------------------
+/*
+  Fixed point, inference only version of a trained NeuralNetwork.
+  Weights are 16 bit integers with one scale factor per layer,
+  activations are 16 bit Q14 values (16384 is 1.0), the weighted sums
+  are accumulated in 32 bits, and the sigmoid is an interpolated
+  integer lookup table. A quantized brain is a quarter the size of the
+  double precision one, and its dot products run as integer SIMD.
+
+  Build one with Quantize from a loaded NeuralNetwork, or load one
+  saved with DumpData. MeasureError reports how far the outputs stray
+  from the double precision network they came from.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef QUANTIZEDNET_H
+#define QUANTIZEDNET_H
+
+#include "neuralNet.h"
+
+// Fixed point formats used throughout
+#define ACTIVATION_ONE	16384	// Q14 activations
+#define PREACTIVATION_ONE 1024	// Q10 weighted sums, fed to the sigmoid table
+
+// The sigmoid table covers weighted sums from -SIGMOID_RANGE to
+// SIGMOID_RANGE, in steps of 1/SIGMOID_STEPS_PER_UNIT
+#define SIGMOID_RANGE		8
+#define SIGMOID_STEPS_PER_UNIT	16
+#define SIGMOID_TABLE_SIZE	(2 * SIGMOID_RANGE * SIGMOID_STEPS_PER_UNIT + 1)
+
+
+// One layer of weights in the quantized network, connecting
+// NumberOfInputs neurons to NumberOfOutputs neurons. Unlike
+// NeuralNetworkLayer, each row holds the weights *into* one
+// output neuron, so every output is a single contiguous dot
+// product. Rows are InputStride long, zero padded to a multiple
+// of QUANTIZED_PADDING.
+class QuantizedLayer
+{
+ public:
+  int		NumberOfInputs;
+  int		NumberOfOutputs;
+  int		InputStride;
+  short*	Weights;
+  int*		Biases;		// in accumulator units
+  double	WeightScale;	// real weight = Weights * WeightScale
+  int		Multiplier;	// accumulator -> Q10 is
+  int		Shift;		// (sum * Multiplier) >> Shift
+  bool		LinearOutput;
+
+  QuantizedLayer();
+
+  void	Initialize(int numInputs, int numOutputs);
+  void	CleanUp(void);
+  void	Quantize(const NeuralNetworkLayer& parent);
+  void	CalculateOutputs(const short* inputs, short* outputs, float* realOutputs);
+};
+
+
+
+
+class QuantizedNeuralNetwork
+{
+ public:
+  QuantizedLayer	HiddenLayer;
+  QuantizedLayer	OutputLayer;
+  short*		InputValues;
+  short*		HiddenValues;
+  float*		OutputValues;
+
+  QuantizedNeuralNetwork();
+
+  void	 Quantize(const NeuralNetwork& network);
+  void	 CleanUp(void);
+  void	 SetInput(int i, float value);
+  float	 GetOutput(int i);
+  void	 FeedForward(void);
+  double MeasureError(NeuralNetwork& network, int numSamples);
+  void	 DumpData(string filename);
+  void	 ReadData(string filename);
+
+ private:
+  void	 AllocateActivations(void);
+};
+
+#endif   // QUANTIZEDNET_H
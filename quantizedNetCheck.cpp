@@ -0,0 +1,177 @@
+/*******************************************************************
+Quantized neural network check
+
+Checks the .qbrain files brainQuantizer writes can be read back. For
+random 4-N-1 networks and the trained brains in ./brains, a network
+is quantized, saved with DumpData and read back with ReadData, and
+the one read back has to give exactly the same outputs as the one
+saved, and stay as close to the double precision network. Both are
+quantized or read in a second time on top of what they already hold,
+which has to give the same again. Prints what went wrong and exits
+with 1 if anything did.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+using namespace std;
+
+#include <stdio.h>
+#include "neuralNet.h"
+#include "quantizedNet.h"
+#include "philoxRandom.h"
+
+
+
+
+// Random inputs each network is run on
+#define CHECK_SAMPLES 100000
+
+// The most a quantized output may stray from the double precision
+// one, several times what the Q14 formats account for
+#define CHECK_MAX_ERROR 0.005
+
+// Scratch quantized brain file
+#define CHECK_QBRAIN "quantizedNetCheck.tmp.qbrain"
+
+
+int failures = 0;
+
+
+
+
+void fail(const string& what)
+{
+  cout<<"Error, "<<what<<endl;
+  failures++;
+}
+
+
+
+
+// Runs saved and loaded on the same random inputs, and
+// counts the outputs that aren't the same bit for bit
+long countMismatches(QuantizedNeuralNetwork& saved, QuantizedNeuralNetwork& loaded,
+		     int numInputs, int numOutputs)
+{
+  PhiloxRandom random(1, RANDOM_STREAM_SAMPLING);
+  float	       input, expected, got;
+  long	       s, mismatches = 0;
+  int	       i;
+
+  for (s = 0; s < CHECK_SAMPLES; s++)
+    {
+      for (i = 0; i < numInputs; i++)
+	{
+	  input = 2 * random.NextDouble() - 1;
+	  saved.SetInput(i, input);
+	  loaded.SetInput(i, input);
+	}
+
+      saved.FeedForward();
+      loaded.FeedForward();
+
+      for (i = 0; i < numOutputs; i++)
+	{
+	  expected = saved.GetOutput(i);
+	  got	   = loaded.GetOutput(i);
+
+	  if (memcmp(&expected, &got, sizeof(float)) != 0)
+	    mismatches++;
+	}
+    }
+
+  return mismatches;
+}
+
+
+
+
+void checkNetwork(NeuralNetwork& brain, const string& name)
+{
+  QuantizedNeuralNetwork saved;
+  QuantizedNeuralNetwork loaded;
+  int			 numInputs  = brain.Layers[0].NumberOfNodes;
+  int			 numOutputs = brain.Layers[2].NumberOfNodes;
+  long			 mismatches;
+  double		 error;
+  int			 pass;
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      saved.Quantize(brain);
+      saved.DumpData(CHECK_QBRAIN);
+      loaded.ReadData(CHECK_QBRAIN);
+
+      mismatches = countMismatches(saved, loaded, numInputs, numOutputs);
+      if (mismatches > 0)
+	fail(name + ": " + to_string(mismatches) + " outputs differ after ReadData");
+
+      error = loaded.MeasureError(brain, CHECK_SAMPLES);
+      if (error > CHECK_MAX_ERROR)
+	fail(name + ": read back network is off by up to " + to_string(error));
+    }
+
+  saved.CleanUp();
+  loaded.CleanUp();
+  remove(CHECK_QBRAIN);
+}
+
+
+
+
+// A random 4-Hidden-1 network
+void checkRandom(int hidden)
+{
+  NeuralNetwork brain;
+
+  brain.SetRandomSeed(hidden);
+  brain.Initialize(4, hidden, 1);
+
+  checkNetwork(brain, "random 4-" + to_string(hidden) + "-1");
+
+  brain.CleanUp();
+}
+
+
+
+
+// One of the trained brains shipped in ./brains
+void checkTrained(int hidden)
+{
+  NeuralNetwork brain;
+  string	filename = "./brains/trainedBrain_" + to_string(hidden) + "_HiddenNodes";
+
+  brain.ReadData(filename);
+
+  checkNetwork(brain, filename);
+
+  brain.CleanUp();
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  int hidden;
+
+  checkRandom(1);
+  checkRandom(8);
+  checkRandom(32);
+
+  for (hidden = 1; hidden <= 5; hidden++)
+    checkTrained(hidden);
+
+  if (failures > 0)
+    {
+      cout<<failures<<" quantized neural network checks failed"<<endl;
+      exit(1);
+    }
+
+  cout<<"Quantized neural network checks passed"<<endl;
+  return 0;
+}
@@ -0,0 +1,526 @@
+/*******************************************************************
+Sweep runner
+
+Trains many network configurations at once, one per core at a
+time, to find the hidden layer sizes, learning rate and momentum
+factor that suit a training data set, rather than running
+trainScript by hand once per hidden node count.
+
+Every combination of the -hidden, -rates and -momentum lists is
+trained with an EpochTrainer, all of them on the same training and
+validation samples. The sweep goes in rounds of successive halving:
+each round trains every configuration still in the running for
+twice as many more epochs as the round before, then cuts the worse
+scoring half of them (by validation error), until only the winners
+are left. So most of the training time goes to the configurations
+that look promising, and the weak ones are dropped early.
+
+The winning brains are written to the output directory, along with
+a results table of every configuration and how far it got.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+using namespace std;
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include "neuralNet.h"
+#include "epochTrainer.h"
+#include "trainingSet.h"
+#include "threadPool.h"
+#include "timer.h"
+
+
+
+
+// The shape of the samples aiTrainer trains on,
+// for text data sets, which don't record it
+#define INPUTNEURONS  4
+#define OUTPUTNEURONS 1
+
+
+// Sweep settings, from the command line
+string	 trainingDataSetFilename;
+string	 outputDirectory;
+string	 hiddenList	    = "1,2,3,4,5,8";
+string	 rateList	    = "0.05,0.1,0.2,0.4";
+string	 momentumList	    = "0,0.5,0.9";
+int	 firstEpochs	    = 4;
+int	 numWinners	    = 3;
+int	 numThreads	    = 0;
+int	 batchSize	    = 0;
+int	 patience	    = 10;
+double	 validationFraction = 0.1;
+unsigned long long randomSeed = time(NULL);
+bool	 useFloat	    = false;
+OptimizerMode optimizerMode = OPTIMIZER_SGD;
+
+
+
+// One configuration being swept, and how it's doing
+template <typename Real>
+struct SweepConfig
+{
+  string		Hidden;		// as given, e.g. "8" or "8x4"
+  double		LearningRate;
+  double		Momentum;
+
+  NeuralNetworkT<Real>*	Brain;
+  EpochTrainerT<Real>*	Trainer;
+  int			RoundCut;	// zero while still in the running
+  bool			Plateaued;	// stopped improving, so no more training
+  double		Seconds;
+};
+
+
+// What a round hands each task
+template <typename Real>
+struct SweepRound
+{
+  vector< SweepConfig<Real>* > Configs;
+  int			       Epochs;
+};
+
+
+
+
+void printUsageInfo()
+{
+  cout<<"Usage: "<<endl<<endl;
+  cout<<"sweepRunner [trainingDataSetFilename or directory] [outputDirectory] [options]"<<endl<<endl;
+  cout<<"Options:"<<endl;
+  cout<<"  -hidden L    Comma separated hidden layer sizes to try, with x between the"<<endl;
+  cout<<"               sizes of several hidden layers, e.g. 4,8,8x4 (default "<<hiddenList<<")"<<endl;
+  cout<<"  -rates L     Comma separated learning rates to try (default "<<rateList<<")"<<endl;
+  cout<<"  -momentum L  Comma separated momentum factors to try, 0 for none (default "<<momentumList<<")"<<endl;
+  cout<<"  -optimizer M Train everything with optimizer M: sgd (default), rmsprop or adam."<<endl;
+  cout<<"               The momentum factors only matter to sgd."<<endl;
+  cout<<"  -epochs N    Epochs to train everything for in the first round, doubling"<<endl;
+  cout<<"               every round after (default "<<firstEpochs<<")"<<endl;
+  cout<<"  -winners N   Stop halving at N configurations, and save their brains (default "<<numWinners<<")"<<endl;
+  cout<<"  -threads N   Train N configurations at a time (default one per core)"<<endl;
+  cout<<"  -batch N     Train in mini-batches of N samples instead of one at a time"<<endl;
+  cout<<"  -validation F  Hold back fraction F of the samples to score on (default "<<validationFraction<<")"<<endl;
+  cout<<"  -patience N  Stop training a configuration after N epochs without improving (default "<<patience<<")"<<endl;
+  cout<<"  -seed N      Seed the random weights, validation split and sample order with N"<<endl;
+  cout<<"  -float       Train in single precision instead of double"<<endl;
+}
+
+
+
+
+// Splits a comma separated list
+vector<string> splitList(const string& list, char separator)
+{
+  vector<string> items;
+  string	 item;
+  istringstream	 stream(list);
+
+  while (getline(stream, item, separator))
+    {
+      if (!item.empty())
+	items.push_back(item);
+    }
+
+  return items;
+}
+
+
+
+
+// Loads a binary training set, or every text data set named,
+// or in the directory named, into trainingSet
+template <typename Real>
+void loadSweepSet(const string& filename, TrainingSetT<Real>& trainingSet)
+{
+  DIR*		 directory;
+  struct dirent* entry;
+  vector<string> filenames;
+  unsigned int	 i;
+
+  if (IsBinaryTrainingSet(filename))
+    {
+      trainingSet.ReadData(filename);
+    }
+  else
+    {
+      directory = opendir(filename.c_str());
+      if (directory == NULL)
+	{
+	  filenames.push_back(filename);
+	}
+      else
+	{
+	  while ((entry = readdir(directory)) != NULL)
+	    {
+	      if (entry->d_name[0] != '.')
+		filenames.push_back(filename + "/" + entry->d_name);
+	    }
+	  closedir(directory);
+
+	  sort(filenames.begin(), filenames.end());
+	}
+
+      trainingSet.Initialize(INPUTNEURONS, OUTPUTNEURONS);
+      for (i = 0; i < filenames.size(); i++)
+	{
+	  trainingSet.ImportText(filenames[i]);
+	}
+    }
+
+  if (trainingSet.NumberOfSamples < 2)
+    {
+      cout<<"Not enough samples in "<<filename<<" to train and validate on"<<endl;
+      exit(1);
+    }
+}
+
+
+
+
+// Builds a new brain for every combination of the lists, each
+// with an EpochTrainer of its own over the shared trainingSet
+template <typename Real>
+void buildConfigs(const TrainingSetT<Real>& trainingSet, vector< SweepConfig<Real>* >& configs)
+{
+  vector<string> hiddens   = splitList(hiddenList, ',');
+  vector<string> rates	   = splitList(rateList, ',');
+  vector<string> momentums = splitList(momentumList, ',');
+  unsigned int	 h, r, m, i;
+
+  for (h = 0; h < hiddens.size(); h++)
+    {
+      vector<string> sizes = splitList(hiddens[h], 'x');
+      vector<int>    layerSizes;
+
+      layerSizes.push_back(trainingSet.NumberOfInputs);
+      for (i = 0; i < sizes.size(); i++)
+	{
+	  layerSizes.push_back(atoi(sizes[i].c_str()));
+	  if (layerSizes.back() < 1)
+	    {
+	      cout<<"Bad hidden layer sizes "<<hiddens[h]<<endl;
+	      exit(1);
+	    }
+	}
+      layerSizes.push_back(trainingSet.NumberOfOutputs);
+
+      for (r = 0; r < rates.size(); r++)
+	{
+	  for (m = 0; m < momentums.size(); m++)
+	    {
+	      SweepConfig<Real>* config = new SweepConfig<Real>;
+
+	      config->Hidden	   = hiddens[h];
+	      config->LearningRate = atof(rates[r].c_str());
+	      config->Momentum	   = atof(momentums[m].c_str());
+	      config->RoundCut	   = 0;
+	      config->Plateaued	   = false;
+	      config->Seconds	   = 0;
+
+	      // Every configuration of the same shape starts from the same weights
+	      config->Brain = new NeuralNetworkT<Real>;
+	      config->Brain->SetRandomSeed(randomSeed);
+	      config->Brain->Initialize(layerSizes.size(), &layerSizes[0]);
+	      config->Brain->SetLearningRate(config->LearningRate);
+	      config->Brain->SetOptimizer(optimizerMode);
+	      config->Brain->SetMomentum(config->Momentum > 0, config->Momentum);
+
+	      config->Trainer = new EpochTrainerT<Real>;
+	      config->Trainer->SetBatching(batchSize, 0);
+	      config->Trainer->SetStopping(INT_MAX, patience);
+	      config->Trainer->Initialize(config->Brain, &trainingSet, validationFraction, randomSeed);
+
+	      configs.push_back(config);
+	    }
+	}
+    }
+
+  if (configs.empty())
+    {
+      printUsageInfo();
+      exit(1);
+    }
+}
+
+
+
+
+// Trains one configuration of the round for the round's epochs,
+// or until it stops improving. Each task only touches its own
+// configuration, so any number of them can run at once.
+template <typename Real>
+void trainConfigTask(void* data, int task, int thread)
+{
+  SweepRound<Real>*  round  = (SweepRound<Real>*) data;
+  SweepConfig<Real>* config = round->Configs[task];
+  Timer		     timer;
+  int		     epoch;
+
+  for (epoch = 0; (epoch < round->Epochs) && !config->Plateaued; epoch++)
+    {
+      config->Plateaued = !config->Trainer->NextEpoch();
+    }
+
+  config->Seconds += timer.total();
+}
+
+
+
+
+// Best validation error first, with anything
+// that blew up to NaN at the very end
+template <typename Real>
+bool betterConfig(const SweepConfig<Real>* a, const SweepConfig<Real>* b)
+{
+  if (std::isnan(a->Trainer->BestError))
+    return false;
+  if (std::isnan(b->Trainer->BestError))
+    return true;
+
+  return a->Trainer->BestError < b->Trainer->BestError;
+}
+
+
+
+
+// Writes a line of the results table
+template <typename Real>
+void writeResult(ostream& out, int rank, const SweepConfig<Real>* config)
+{
+  out<<setw(4)<<rank<<"  "<<setw(10)<<config->Hidden<<"  "<<setw(8)<<config->LearningRate
+     <<"  "<<setw(8)<<config->Momentum<<"  "<<setw(6)<<config->Trainer->Epoch
+     <<"  "<<setw(6)<<config->Trainer->BestEpoch<<"  "<<setw(12)<<config->Trainer->BestError
+     <<"  "<<setw(12)<<config->Trainer->TrainingError<<"  "<<setw(8)<<config->Seconds<<"  ";
+
+  if (config->RoundCut > 0)
+    out<<"cut in round "<<config->RoundCut;
+  else
+    out<<"winner";
+
+  out<<"\n";
+}
+
+
+
+
+template <typename Real>
+void runSweep()
+{
+  TrainingSetT<Real>	       trainingSet;
+  vector< SweepConfig<Real>* > configs;
+  SweepRound<Real>	       round;
+  ThreadPool		       pool;
+  Timer			       timer;
+  int			       roundNumber, keep;
+  unsigned int		       i;
+  string		       resultsFilename = outputDirectory + "/sweepResults.txt";
+  ofstream		       resultsFile;
+
+  loadSweepSet(trainingDataSetFilename, trainingSet);
+  buildConfigs(trainingSet, configs);
+
+  cout<<"Sweeping "<<configs.size()<<" configurations on "<<trainingSet.NumberOfSamples
+      <<" samples, "<<numThreads<<" at a time (random seed "<<randomSeed<<")"<<endl;
+
+  pool.Start(numThreads);
+
+  round.Configs = configs;
+  round.Epochs	= firstEpochs;
+
+  for (roundNumber = 1; ; roundNumber++)
+    {
+      pool.Run(trainConfigTask<Real>, &round, round.Configs.size());
+
+      stable_sort(round.Configs.begin(), round.Configs.end(), betterConfig<Real>);
+
+      cout<<"Round "<<roundNumber<<": trained "<<round.Configs.size()<<" configurations for "
+	  <<round.Epochs<<" epochs, best "<<round.Configs[0]->Hidden<<" hidden, rate "
+	  <<round.Configs[0]->LearningRate<<", momentum "<<round.Configs[0]->Momentum
+	  <<", validation error "<<round.Configs[0]->Trainer->BestError<<endl;
+
+      if ((int) round.Configs.size() <= numWinners)
+	{
+	  break;
+	}
+
+      keep = (round.Configs.size() + 1) / 2;
+      if (keep < numWinners)
+	{
+	  keep = numWinners;
+	}
+
+      for (i = keep; i < round.Configs.size(); i++)
+	{
+	  round.Configs[i]->RoundCut = roundNumber;
+	}
+
+      round.Configs.resize(keep);
+      round.Epochs *= 2;
+    }
+
+  pool.Stop();
+
+  mkdir(outputDirectory.c_str(), 0755);
+
+  // The winners, best first, at their best scoring weights
+  for (i = 0; i < round.Configs.size(); i++)
+    {
+      ostringstream brainFilename;
+
+      brainFilename<<outputDirectory<<"/sweepBrain_"<<i+1;
+
+      round.Configs[i]->Trainer->RestoreBest();
+      round.Configs[i]->Brain->DumpData(brainFilename.str());
+
+      cout<<"Saved "<<round.Configs[i]->Hidden<<" hidden, rate "<<round.Configs[i]->LearningRate
+	  <<", momentum "<<round.Configs[i]->Momentum<<" as "<<brainFilename.str()<<endl;
+    }
+
+  // Everything, in the order it finished in: the
+  // winners, then by the round it was cut in
+  stable_sort(configs.begin(), configs.end(), betterConfig<Real>);
+  for (i = 0; i < round.Configs.size(); i++)
+    {
+      configs.erase(find(configs.begin(), configs.end(), round.Configs[i]));
+    }
+  stable_sort(configs.begin(), configs.end(), [](const SweepConfig<Real>* a, const SweepConfig<Real>* b)
+	      { return a->RoundCut > b->RoundCut; });
+  configs.insert(configs.begin(), round.Configs.begin(), round.Configs.end());
+
+  resultsFile.open(resultsFilename.c_str(), ios::out);
+  resultsFile<<"rank      hidden      rate  momentum  epochs    best  valid error  train error   seconds  result\n";
+  for (i = 0; i < configs.size(); i++)
+    {
+      writeResult(resultsFile, i+1, configs[i]);
+    }
+  resultsFile.close();
+
+  if (!resultsFile)
+    {
+      cout<<"Error, unable to write "<<resultsFilename<<"!"<<endl;
+      exit(1);
+    }
+
+  cout<<"Sweep took "<<timer.total()<<" seconds, results in "<<resultsFilename<<endl;
+
+  for (i = 0; i < configs.size(); i++)
+    {
+      configs[i]->Trainer->CleanUp();
+      configs[i]->Brain->CleanUp();
+      delete configs[i]->Trainer;
+      delete configs[i]->Brain;
+      delete configs[i];
+    }
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+    {
+      printUsageInfo();
+      return 0;
+    }
+
+  trainingDataSetFilename = argv[1];
+  outputDirectory	  = argv[2];
+  numThreads		  = thread::hardware_concurrency();
+
+  for (int i = 3; i < argc; i++)
+    {
+      if ((strcmp(argv[i], "-hidden") == 0) && (i+1 < argc))
+	{
+	  hiddenList = argv[++i];
+	}
+      else if ((strcmp(argv[i], "-rates") == 0) && (i+1 < argc))
+	{
+	  rateList = argv[++i];
+	}
+      else if ((strcmp(argv[i], "-momentum") == 0) && (i+1 < argc))
+	{
+	  momentumList = argv[++i];
+	}
+      else if ((strcmp(argv[i], "-optimizer") == 0) && (i+1 < argc))
+	{
+	  i++;
+	  if (strcmp(argv[i], "sgd") == 0)
+	    optimizerMode = OPTIMIZER_SGD;
+	  else if (strcmp(argv[i], "rmsprop") == 0)
+	    optimizerMode = OPTIMIZER_RMSPROP;
+	  else if (strcmp(argv[i], "adam") == 0)
+	    optimizerMode = OPTIMIZER_ADAM;
+	  else
+	    {
+	      printUsageInfo();
+	      return 0;
+	    }
+	}
+      else if ((strcmp(argv[i], "-epochs") == 0) && (i+1 < argc))
+	{
+	  firstEpochs = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-winners") == 0) && (i+1 < argc))
+	{
+	  numWinners = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-threads") == 0) && (i+1 < argc))
+	{
+	  numThreads = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-batch") == 0) && (i+1 < argc))
+	{
+	  batchSize = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-validation") == 0) && (i+1 < argc))
+	{
+	  validationFraction = atof(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-patience") == 0) && (i+1 < argc))
+	{
+	  patience = atoi(argv[++i]);
+	}
+      else if ((strcmp(argv[i], "-seed") == 0) && (i+1 < argc))
+	{
+	  randomSeed = strtoull(argv[++i], NULL, 10);
+	}
+      else if (strcmp(argv[i], "-float") == 0)
+	{
+	  useFloat = true;
+	}
+      else
+	{
+	  printUsageInfo();
+	  return 0;
+	}
+    }
+
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numWinners < 1)
+    numWinners = 1;
+  if (firstEpochs < 1)
+    firstEpochs = 1;
+
+  if (useFloat)
+    runSweep<float>();
+  else
+    runSweep<double>();
+
+  return 0;
+}
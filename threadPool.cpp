@@ -0,0 +1,203 @@
+#include "threadPool.h"
+
+//---------------------------------------------------------------------------
+/*
+  See threadPool.h. Each call to Run bumps Generation, which is what
+  the parked workers wait on, and then waits for BusyWorkers to drop
+  back to zero. Tasks are claimed one at a time from NextTask.
+*/
+//---------------------------------------------------------------------------
+
+ThreadPool::ThreadPool()
+{
+  CurrentTask	= NULL;
+  CurrentData	= NULL;
+  NumberOfTasks = 0;
+  OneTaskPerThread = false;
+  NextTask	= 0;
+  BusyWorkers	= 0;
+  Generation	= 0;
+  Stopping	= false;
+}
+
+
+
+ThreadPool::~ThreadPool()
+{
+  Stop();
+}
+
+
+
+// Starts numThreads - 1 workers, the caller of Run being the
+// last thread. Generation carries on from before any Stop, so
+// new workers start out having seen it, rather than running
+// the last Run's task over again.
+void ThreadPool::Start(int numThreads)
+{
+  unsigned int generation;
+  int	       i;
+
+  Stop();
+
+  {
+    lock_guard<mutex> guard(Lock);
+    Stopping	= false;
+    BusyWorkers = 0;
+    generation	= Generation;
+  }
+
+  for(i=1; i<numThreads; i++)
+    {
+      Workers.push_back(thread(&ThreadPool::WorkerLoop, this, i, generation));
+    }
+}
+
+
+
+void ThreadPool::Stop(void)
+{
+  unsigned int i;
+
+  {
+    lock_guard<mutex> guard(Lock);
+    Stopping = true;
+  }
+  WorkReady.notify_all();
+
+  for(i=0; i<Workers.size(); i++)
+    {
+      Workers[i].join();
+    }
+
+  Workers.clear();
+}
+
+
+
+int ThreadPool::NumberOfThreads(void)
+{
+  return Workers.size() + 1;
+}
+
+
+
+// Runs tasks 0 to numTasks-1 and waits for all of them. A single
+// task, or a pool of one thread, just runs on the calling thread.
+void ThreadPool::Run(Task task, void* data, int numTasks)
+{
+  int i;
+
+  if((numTasks <= 1) || Workers.empty())
+    {
+      for(i=0; i<numTasks; i++)
+	{
+	  task(data, i, 0);
+	}
+      return;
+    }
+
+  {
+    lock_guard<mutex> guard(Lock);
+
+    CurrentTask	  = task;
+    CurrentData	  = data;
+    NumberOfTasks = numTasks;
+    OneTaskPerThread = false;
+    NextTask	  = 0;
+    BusyWorkers	  = Workers.size();
+    Generation++;
+  }
+  WorkReady.notify_all();
+
+  RunTasks(0);
+
+  unique_lock<mutex> guard(Lock);
+  while(BusyWorkers > 0)
+    {
+      WorkDone.wait(guard);
+    }
+}
+
+
+
+// Runs task number t on thread number t, for every thread in the
+// pool, and waits for all of them. For work that has to stay on one
+// thread, such as anything timed per thread.
+void ThreadPool::RunOnEachThread(Task task, void* data)
+{
+  if(Workers.empty())
+    {
+      task(data, 0, 0);
+      return;
+    }
+
+  {
+    lock_guard<mutex> guard(Lock);
+
+    CurrentTask	  = task;
+    CurrentData	  = data;
+    NumberOfTasks = Workers.size() + 1;
+    OneTaskPerThread = true;
+    BusyWorkers	  = Workers.size();
+    Generation++;
+  }
+  WorkReady.notify_all();
+
+  RunTasks(0);
+
+  unique_lock<mutex> guard(Lock);
+  while(BusyWorkers > 0)
+    {
+      WorkDone.wait(guard);
+    }
+}
+
+
+
+void ThreadPool::WorkerLoop(int thread, unsigned int seen)
+{
+  for(;;)
+    {
+      {
+	unique_lock<mutex> guard(Lock);
+	while(!Stopping && (Generation == seen))
+	  {
+	    WorkReady.wait(guard);
+	  }
+
+	if(Stopping)
+	  {
+	    return;
+	  }
+
+	seen = Generation;
+      }
+
+      RunTasks(thread);
+
+      {
+	lock_guard<mutex> guard(Lock);
+	BusyWorkers--;
+      }
+      WorkDone.notify_one();
+    }
+}
+
+
+
+void ThreadPool::RunTasks(int thread)
+{
+  int task;
+
+  if(OneTaskPerThread)
+    {
+      CurrentTask(CurrentData, thread, thread);
+      return;
+    }
+
+  while((task = NextTask.fetch_add(1)) < NumberOfTasks)
+    {
+      CurrentTask(CurrentData, task, thread);
+    }
+}
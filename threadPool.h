@@ -0,0 +1,62 @@
+//---------------------------------------------------------------------------
+/*
+  A small fixed-size pool of worker threads. Run hands out numbered
+  tasks to every thread in the pool, the calling thread included,
+  and returns once all of them are done. The threads stay parked
+  between calls, so there's no thread creation cost per call.
+
+  Which thread runs which task is not fixed (except with
+  RunOnEachThread, where thread number t runs task number t), so
+  anything that has to come out the same on every run should depend
+  only on the task number, never on the thread number. The thread
+  number is for picking per-thread scratch space.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+using namespace std;
+
+
+class ThreadPool
+{
+ public:
+  // Runs task number task on thread number thread,
+  // data is whatever was passed to Run
+  typedef void (*Task)(void* data, int task, int thread);
+
+  ThreadPool();
+  ~ThreadPool();
+
+  void	Start(int numThreads);
+  void	Stop(void);
+  int	NumberOfThreads(void);
+  void	Run(Task task, void* data, int numTasks);
+  void	RunOnEachThread(Task task, void* data);
+
+ private:
+  void	WorkerLoop(int thread, unsigned int seen);
+  void	RunTasks(int thread);
+
+  vector<thread>	Workers;
+  mutex			Lock;
+  condition_variable	WorkReady;
+  condition_variable	WorkDone;
+
+  Task			CurrentTask;
+  void*			CurrentData;
+  int			NumberOfTasks;
+  bool			OneTaskPerThread;
+  atomic<int>		NextTask;
+  int			BusyWorkers;
+  unsigned int		Generation;
+  bool			Stopping;
+};
+
+#endif   // THREADPOOL_H
@@ -0,0 +1,126 @@
+/*******************************************************************
+Thread pool check
+
+Runs the thread pool through the ways it gets used, including being
+started again after it's already run something, as the trainers'
+Initialize does, and checks every task runs exactly once a call and
+nothing runs when nothing's been asked for. Prints what went wrong
+and exits with 1 if anything did.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <cstdlib>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <thread>
+using namespace std;
+
+#include "threadPool.h"
+
+
+
+
+// Counts how many times each task has run
+struct TaskCounts
+{
+  vector< atomic<int> > Counts;
+  atomic<int>		Total;
+
+  TaskCounts(int numTasks) : Counts(numTasks)
+  {
+    Clear();
+  }
+
+  void Clear(void)
+  {
+    for (unsigned int i = 0; i < Counts.size(); i++)
+      Counts[i] = 0;
+    Total = 0;
+  }
+};
+
+
+int failures = 0;
+
+
+
+
+void countTask(void* data, int task, int thread)
+{
+  TaskCounts* counts = (TaskCounts*) data;
+
+  counts->Counts[task]++;
+  counts->Total++;
+}
+
+
+
+
+void expect(const char* what, int got, int wanted)
+{
+  if (got != wanted)
+    {
+      cout<<"Error, "<<what<<": "<<got<<" instead of "<<wanted<<endl;
+      failures++;
+    }
+}
+
+
+
+
+// Checks each of numTasks tasks ran once, then waits a moment
+// to check no worker runs any of them again by itself
+void checkRun(TaskCounts& counts, int numTasks, const char* what)
+{
+  int i;
+
+  for (i = 0; i < numTasks; i++)
+    expect(what, counts.Counts[i], 1);
+
+  this_thread::sleep_for(chrono::milliseconds(50));
+  expect(what, counts.Total, numTasks);
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  ThreadPool pool;
+  TaskCounts tasks(1000);
+  TaskCounts eachThread(4);
+  int	     start;
+
+  // Restarting, as the trainers' Initialize does, mustn't run
+  // the last call's task again. The counts outlive every
+  // restart, so a worker that did would show up in them.
+  for (start = 0; start < 3; start++)
+    {
+      pool.Start(4);
+
+      this_thread::sleep_for(chrono::milliseconds(50));
+      expect("Tasks run again by Start", tasks.Total + eachThread.Total, start == 0 ? 0 : 1004);
+
+      tasks.Clear();
+      pool.Run(countTask, &tasks, 1000);
+      checkRun(tasks, 1000, "Run");
+
+      eachThread.Clear();
+      pool.RunOnEachThread(countTask, &eachThread);
+      checkRun(eachThread, 4, "RunOnEachThread");
+    }
+
+  pool.Stop();
+
+  if (failures > 0)
+    {
+      cout<<failures<<" thread pool checks failed"<<endl;
+      exit(1);
+    }
+
+  cout<<"Thread pool checks passed"<<endl;
+  return 0;
+}
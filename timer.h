@@ -35,7 +35,7 @@ class Timer
      return timeDifference(&startTime, &currentTime);
    }
 
- float reset()
+ void reset()
    {
      gettimeofday(&startTime, NULL);
      lastTime = startTime;
@@ -0,0 +1,487 @@
+#include "trainingSet.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//---------------------------------------------------------------------------
+/*
+  See trainingSet.h. Inputs and Desired always point at the arrays
+  in use, whether those are OwnInputs/OwnDesired or the mapped file.
+*/
+//---------------------------------------------------------------------------
+
+// Rounds a byte count up to a whole number of LAYER_ALIGNMENT blocks
+static size_t PadBytes(size_t bytes)
+{
+  return ((bytes + LAYER_ALIGNMENT - 1) / LAYER_ALIGNMENT) * LAYER_ALIGNMENT;
+}
+
+
+
+// Returns whether filename starts like a binary training set
+bool IsBinaryTrainingSet(string filename)
+{
+  char	   magic[8] = { 0 };
+  ifstream setFile(filename.c_str(), ios::in | ios::binary);
+
+  setFile.read(magic, sizeof(magic));
+
+  return setFile && (memcmp(magic, TRAINING_SET_MAGIC, sizeof(magic)) == 0);
+}
+
+
+
+// Writes count values, then zeros up to the next
+// LAYER_ALIGNMENT bytes, adding them to the checksum
+template <typename Real>
+static void WriteSetBlock(ofstream& setFile, const Real* values, size_t count,
+			  unsigned long long& checksum)
+{
+  vector<char> block(PadBytes(sizeof(Real) * count), 0);
+
+  if(count > 0)
+    {
+      memcpy(&block[0], values, sizeof(Real) * count);
+      setFile.write(&block[0], block.size());
+      checksum = BrainChecksum(&block[0], block.size(), checksum);
+    }
+}
+
+
+
+// Copies count values of another scalar type
+template <typename Real, typename FileReal>
+static void ConvertSetBlock(const char* file, vector<Real>& values, size_t count)
+{
+  const FileReal* fileValues = (const FileReal*) file;
+  size_t	  i;
+
+  values.resize(count);
+
+  for(i=0; i<count; i++)
+    {
+      values[i] = (Real) fileValues[i];
+    }
+}
+
+
+
+
+template <typename Real>
+TrainingSetT<Real>::TrainingSetT()
+{
+  NumberOfInputs  = 0;
+  NumberOfOutputs = 0;
+  NumberOfSamples = 0;
+  Inputs	  = NULL;
+  Desired	  = NULL;
+  Mapping	  = NULL;
+  MappingSize	  = 0;
+}
+
+
+
+
+// Starts an empty set of samples with numInputs
+// inputs and numOutputs desired outputs each
+template <typename Real>
+void TrainingSetT<Real>::Initialize(int numInputs, int numOutputs)
+{
+  CleanUp();
+
+  NumberOfInputs  = numInputs;
+  NumberOfOutputs = numOutputs;
+}
+
+
+
+template <typename Real>
+void TrainingSetT<Real>::CleanUp(void)
+{
+  if(Mapping != NULL)
+    {
+      munmap(Mapping, MappingSize);
+    }
+
+  OwnInputs.clear();
+  OwnDesired.clear();
+
+  NumberOfInputs  = 0;
+  NumberOfOutputs = 0;
+  NumberOfSamples = 0;
+  Inputs	  = NULL;
+  Desired	  = NULL;
+  Mapping	  = NULL;
+  MappingSize	  = 0;
+}
+
+
+
+template <typename Real>
+void TrainingSetT<Real>::UpdatePointers(void)
+{
+  Inputs  = OwnInputs.empty() ? NULL : &OwnInputs[0];
+  Desired = OwnDesired.empty() ? NULL : &OwnDesired[0];
+}
+
+
+
+
+// Appends one sample to a set built in memory
+template <typename Real>
+void TrainingSetT<Real>::AddSample(const Real* inputs, const Real* desired)
+{
+  if(Mapping != NULL)
+    {
+      cout<<"Error, can't add samples to a mapped training set!"<<endl;
+      exit(1);
+    }
+
+  OwnInputs.insert(OwnInputs.end(), inputs, inputs + NumberOfInputs);
+  OwnDesired.insert(OwnDesired.end(), desired, desired + NumberOfOutputs);
+  NumberOfSamples++;
+
+  UpdatePointers();
+}
+
+
+
+
+// Appends every sample in a text data set. The values are read as
+// floats, as aiTrainer always has read them, so a set imported here
+// trains exactly like the text file did.
+template <typename Real>
+void TrainingSetT<Real>::ImportText(string filename)
+{
+  int	   i;
+  ifstream setFile(filename.c_str(), ios::in);
+  vector<float> values(NumberOfInputs + NumberOfOutputs);
+  vector<Real>  sample(NumberOfInputs + NumberOfOutputs);
+
+  if(!setFile)
+    {
+      cout<<"Error, unable to open training set "<<filename<<"!"<<endl;
+      exit(1);
+    }
+
+  for(;;)
+    {
+      for(i=0; i<NumberOfInputs+NumberOfOutputs; i++)
+	{
+	  if(!(setFile>>values[i]))
+	    break;
+	  sample[i] = values[i];
+	}
+
+      if(i == 0)
+	{
+	  break;
+	}
+
+      if(i < NumberOfInputs+NumberOfOutputs)
+	{
+	  cout<<"Error, incomplete sample at the end of training set "<<filename<<"!"<<endl;
+	  exit(1);
+	}
+
+      AddSample(&sample[0], &sample[NumberOfInputs]);
+    }
+
+  setFile.close();
+}
+
+
+
+
+// Saves the set as a binary training set in this set's scalar type.
+// Like NeuralNetworkT::DumpBinary, it writes a temporary file and
+// renames it over filename.
+template <typename Real>
+void TrainingSetT<Real>::DumpData(string filename)
+{
+  TrainingSetHeader  header;
+  unsigned long long checksum = BRAIN_CHECKSUM_SEED;
+  string	     tempFilename = filename + ".tmp";
+  ofstream	     setFile(tempFilename.c_str(), ios::out | ios::binary);
+
+  memset(&header, 0, sizeof(header));
+  setFile.write((const char*) &header, sizeof(header));
+
+  WriteSetBlock(setFile, Inputs, (size_t) NumberOfSamples * NumberOfInputs, checksum);
+  header.DesiredOffset = setFile.tellp();
+  WriteSetBlock(setFile, Desired, (size_t) NumberOfSamples * NumberOfOutputs, checksum);
+
+  memcpy(header.Magic, TRAINING_SET_MAGIC, sizeof(header.Magic));
+  header.Version	 = TRAINING_SET_VERSION;
+  header.ScalarSize	 = sizeof(Real);
+  header.NumberOfInputs	 = NumberOfInputs;
+  header.NumberOfOutputs = NumberOfOutputs;
+  header.NumberOfSamples = NumberOfSamples;
+  header.FileSize	 = setFile.tellp();
+  header.Checksum	 = checksum;
+
+  setFile.seekp(0);
+  setFile.write((const char*) &header, sizeof(header));
+  setFile.close();
+
+  if(!setFile || (rename(tempFilename.c_str(), filename.c_str()) != 0))
+    {
+      cout<<"Error, unable to write training set "<<filename<<"!"<<endl;
+      exit(1);
+    }
+}
+
+
+
+
+// Loads a binary training set saved by DumpData. The file is mapped
+// rather than read, and a set of this scalar type is used right where
+// it lies, marked for sequential reading so the kernel reads ahead of
+// the trainer. A set of the other scalar type is converted into the
+// set's own arrays instead. The header and sizes are always checked,
+// and the checksum too, since a set is read end to end in any case.
+template <typename Real>
+void TrainingSetT<Real>::ReadData(string filename)
+{
+  int			   fd;
+  struct stat		   fileInfo;
+  void*			   mapping;
+  const TrainingSetHeader* header;
+  const char*		   file;
+  size_t		   inputBytes, desiredBytes;
+
+  CleanUp();
+
+  fd = open(filename.c_str(), O_RDONLY);
+  if((fd < 0) || (fstat(fd, &fileInfo) != 0) || (fileInfo.st_size < (off_t) sizeof(TrainingSetHeader)))
+    {
+      cout<<"Error, unable to open training set "<<filename<<"!"<<endl;
+      exit(1);
+    }
+
+  mapping = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(mapping == MAP_FAILED)
+    {
+      cout<<"Error, unable to map training set "<<filename<<"!"<<endl;
+      exit(1);
+    }
+
+  header = (const TrainingSetHeader*) mapping;
+  file	 = (const char*) mapping;
+
+  if((memcmp(header->Magic, TRAINING_SET_MAGIC, sizeof(header->Magic)) != 0) ||
+     (header->Version != TRAINING_SET_VERSION) ||
+     ((header->ScalarSize != sizeof(float)) && (header->ScalarSize != sizeof(double))) ||
+     (header->FileSize != (unsigned long long) fileInfo.st_size) ||
+     (header->NumberOfInputs < 1) || (header->NumberOfOutputs < 1) ||
+     (header->NumberOfInputs > header->FileSize) || (header->NumberOfOutputs > header->FileSize) ||
+     (header->NumberOfSamples > header->FileSize / header->ScalarSize /
+      (header->NumberOfInputs + header->NumberOfOutputs)))
+    {
+      cout<<"Error, bad training set "<<filename<<", bad header!"<<endl;
+      exit(1);
+    }
+
+  inputBytes   = PadBytes(header->ScalarSize * header->NumberOfSamples * header->NumberOfInputs);
+  desiredBytes = PadBytes(header->ScalarSize * header->NumberOfSamples * header->NumberOfOutputs);
+
+  if((header->DesiredOffset != sizeof(TrainingSetHeader) + inputBytes) ||
+     (header->FileSize != header->DesiredOffset + desiredBytes))
+    {
+      cout<<"Error, bad training set "<<filename<<", wrong size for its samples!"<<endl;
+      exit(1);
+    }
+
+  madvise(mapping, header->FileSize, MADV_SEQUENTIAL);
+
+  if(BrainChecksum(file + sizeof(TrainingSetHeader), header->FileSize - sizeof(TrainingSetHeader))
+     != header->Checksum)
+    {
+      cout<<"Error, bad training set "<<filename<<", checksum mismatch!"<<endl;
+      exit(1);
+    }
+
+  NumberOfInputs  = header->NumberOfInputs;
+  NumberOfOutputs = header->NumberOfOutputs;
+  NumberOfSamples = header->NumberOfSamples;
+
+  if(header->ScalarSize == sizeof(Real))
+    {
+      Mapping	  = mapping;
+      MappingSize = header->FileSize;
+      Inputs	  = (const Real*) (file + sizeof(TrainingSetHeader));
+      Desired	  = (const Real*) (file + header->DesiredOffset);
+      return;
+    }
+
+  if(header->ScalarSize == sizeof(float))
+    {
+      ConvertSetBlock<Real, float>(file + sizeof(TrainingSetHeader), OwnInputs,
+				   NumberOfSamples * NumberOfInputs);
+      ConvertSetBlock<Real, float>(file + header->DesiredOffset, OwnDesired,
+				   NumberOfSamples * NumberOfOutputs);
+    }
+  else
+    {
+      ConvertSetBlock<Real, double>(file + sizeof(TrainingSetHeader), OwnInputs,
+				    NumberOfSamples * NumberOfInputs);
+      ConvertSetBlock<Real, double>(file + header->DesiredOffset, OwnDesired,
+				    NumberOfSamples * NumberOfOutputs);
+    }
+
+  munmap(mapping, header->FileSize);
+  UpdatePointers();
+}
+
+
+
+template <typename Real>
+TrainingSetWriterT<Real>::TrainingSetWriterT()
+{
+  NumberOfInputs  = 0;
+  NumberOfOutputs = 0;
+  NumberOfSamples = 0;
+  SamplesWritten  = 0;
+  File		  = -1;
+  DesiredOffset	  = 0;
+  FileSize	  = 0;
+}
+
+
+
+
+// Starts writing a binary training set of numSamples samples to
+// filename. The file is laid out and sized for all of them up
+// front, padding included, so each sample goes straight to its
+// place in the inputs and desired outputs arrays.
+template <typename Real>
+void TrainingSetWriterT<Real>::Open(string filename, int numInputs, int numOutputs, long numSamples)
+{
+  NumberOfInputs  = numInputs;
+  NumberOfOutputs = numOutputs;
+  NumberOfSamples = numSamples;
+  SamplesWritten  = 0;
+  Filename	  = filename;
+  TempFilename	  = filename + ".tmp";
+
+  DesiredOffset = sizeof(TrainingSetHeader) + PadBytes(sizeof(Real) * numSamples * numInputs);
+  FileSize	= DesiredOffset + PadBytes(sizeof(Real) * numSamples * numOutputs);
+
+  File = open(TempFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if((File < 0) || (ftruncate(File, FileSize) != 0))
+    {
+      cout<<"Error, unable to write training set "<<filename<<"!"<<endl;
+      exit(1);
+    }
+}
+
+
+
+// Writes the next count samples, count rows of
+// inputs and count rows of desired outputs
+template <typename Real>
+void TrainingSetWriterT<Real>::WriteSamples(const Real* inputs, const Real* desired, long count)
+{
+  if(SamplesWritten + count > NumberOfSamples)
+    {
+      cout<<"Error, more samples than training set "<<Filename<<" was opened for!"<<endl;
+      exit(1);
+    }
+
+  WriteAt(inputs, sizeof(Real) * count * NumberOfInputs,
+	  sizeof(TrainingSetHeader) + sizeof(Real) * SamplesWritten * NumberOfInputs);
+  WriteAt(desired, sizeof(Real) * count * NumberOfOutputs,
+	  DesiredOffset + sizeof(Real) * SamplesWritten * NumberOfOutputs);
+
+  SamplesWritten += count;
+}
+
+
+
+template <typename Real>
+void TrainingSetWriterT<Real>::WriteAt(const void* data, size_t size, size_t offset)
+{
+  ssize_t written;
+
+  while(size > 0)
+    {
+      written = pwrite(File, data, size, offset);
+      if(written <= 0)
+	{
+	  cout<<"Error, unable to write training set "<<Filename<<"!"<<endl;
+	  exit(1);
+	}
+
+      data    = (const char*) data + written;
+      size   -= written;
+      offset += written;
+    }
+}
+
+
+
+// Finishes the set once every sample is written: reads the file
+// back through a mapping for the checksum (the samples went in
+// out of checksum order), fills in the header, and renames the
+// file into place
+template <typename Real>
+void TrainingSetWriterT<Real>::Close(void)
+{
+  TrainingSetHeader header;
+  void*		    mapping;
+
+  if(SamplesWritten != NumberOfSamples)
+    {
+      cout<<"Error, only "<<SamplesWritten<<" of the "<<NumberOfSamples
+	  <<" samples were written to training set "<<Filename<<"!"<<endl;
+      exit(1);
+    }
+
+  mapping = mmap(NULL, FileSize, PROT_READ, MAP_SHARED, File, 0);
+  if(mapping == MAP_FAILED)
+    {
+      cout<<"Error, unable to map training set "<<Filename<<"!"<<endl;
+      exit(1);
+    }
+
+  madvise(mapping, FileSize, MADV_SEQUENTIAL);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.Magic, TRAINING_SET_MAGIC, sizeof(header.Magic));
+  header.Version	 = TRAINING_SET_VERSION;
+  header.ScalarSize	 = sizeof(Real);
+  header.NumberOfInputs	 = NumberOfInputs;
+  header.NumberOfOutputs = NumberOfOutputs;
+  header.NumberOfSamples = NumberOfSamples;
+  header.DesiredOffset	 = DesiredOffset;
+  header.FileSize	 = FileSize;
+  header.Checksum	 = BrainChecksum((const char*) mapping + sizeof(TrainingSetHeader),
+					 FileSize - sizeof(TrainingSetHeader));
+
+  munmap(mapping, FileSize);
+
+  WriteAt(&header, sizeof(header), 0);
+
+  if((close(File) != 0) || (rename(TempFilename.c_str(), Filename.c_str()) != 0))
+    {
+      cout<<"Error, unable to write training set "<<Filename<<"!"<<endl;
+      exit(1);
+    }
+
+  File = -1;
+}
+
+
+
+// The scalar types networks are built for
+template class TrainingSetT<float>;
+template class TrainingSetT<double>;
+template class TrainingSetWriterT<float>;
+template class TrainingSetWriterT<double>;
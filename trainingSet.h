@@ -0,0 +1,123 @@
+//---------------------------------------------------------------------------
+/*
+  A set of training samples packed into two contiguous arrays: every
+  sample's inputs, one row of NumberOfInputs values per sample, and
+  every sample's desired outputs, one row of NumberOfOutputs values
+  per sample. Those are exactly the layouts the batched training
+  passes read, so a trainer walks straight through both arrays from
+  start to finish, and never opens a file per sample.
+
+  A set can be imported from the text data sets aiTrainer has always
+  read (each sample its input values then its desired output values,
+  separated by whitespace), or saved to and loaded from a binary file
+  laid out like the arrays themselves. A binary set of the same
+  scalar type is used where it lies in the mapped file, so it is
+  never parsed or copied, however many samples it holds.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef TRAININGSET_H
+#define TRAININGSET_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "neuralNet.h"
+
+
+// Binary training set files start with this header, followed by the
+// inputs array and then the desired outputs array, each one starting
+// on a LAYER_ALIGNMENT boundary. Checksum covers everything after the
+// header, and is the same 64 bit FNV-1a brain files use.
+#define TRAINING_SET_MAGIC   "NNTRSET"
+#define TRAINING_SET_VERSION 1
+
+struct TrainingSetHeader
+{
+  char			Magic[8];
+  unsigned int		Version;
+  unsigned int		ScalarSize;	// sizeof(float) or sizeof(double)
+  unsigned int		NumberOfInputs;
+  unsigned int		NumberOfOutputs;
+  unsigned long long	NumberOfSamples;
+  unsigned long long	DesiredOffset;	// bytes from the start of the file
+  unsigned long long	FileSize;
+  unsigned long long	Checksum;
+  char			Unused[LAYER_ALIGNMENT - 56];
+};
+
+bool IsBinaryTrainingSet(string filename);
+
+
+template <typename Real>
+class TrainingSetT
+{
+ public:
+  int		NumberOfInputs;
+  int		NumberOfOutputs;
+  long		NumberOfSamples;
+  const Real*	Inputs;
+  const Real*	Desired;
+
+  TrainingSetT();
+
+  void	Initialize(int numInputs, int numOutputs);
+  void	CleanUp(void);
+  void	AddSample(const Real* inputs, const Real* desired);
+  void	ImportText(string filename);
+  void	DumpData(string filename);
+  void	ReadData(string filename);
+
+ private:
+  void	UpdatePointers(void);
+
+  // The arrays of a set built in memory, or converted
+  // from a binary file of the other scalar type
+  vector<Real>	OwnInputs;
+  vector<Real>	OwnDesired;
+
+  void*		Mapping;
+  size_t	MappingSize;
+};
+
+
+// Writes a binary training set straight to the file, some samples
+// at a time, for sets too big to build in memory first. Open sizes
+// the file for numSamples samples, WriteSamples adds them in order,
+// and Close works out the checksum and renames the finished file
+// over filename, so a half written set is never left under that
+// name. Reads exactly like a set saved by DumpData.
+template <typename Real>
+class TrainingSetWriterT
+{
+ public:
+  int		NumberOfInputs;
+  int		NumberOfOutputs;
+  long		NumberOfSamples;
+  long		SamplesWritten;
+
+  TrainingSetWriterT();
+
+  void	Open(string filename, int numInputs, int numOutputs, long numSamples);
+  void	WriteSamples(const Real* inputs, const Real* desired, long count);
+  void	Close(void);
+
+ private:
+  void	WriteAt(const void* data, size_t size, size_t offset);
+
+  string	Filename;
+  string	TempFilename;
+  int		File;
+  size_t	DesiredOffset;
+  size_t	FileSize;
+};
+
+
+typedef TrainingSetT<double>		TrainingSet;
+typedef TrainingSetT<float>		TrainingSetF;
+typedef TrainingSetWriterT<double>	TrainingSetWriter;
+typedef TrainingSetWriterT<float>	TrainingSetWriterF;
+
+#endif   // TRAININGSET_H
@@ -0,0 +1,433 @@
+#include "world.h"
+#include "philoxRandom.h"
+#include "math.h"
+#include "mathVector.h"
+
+//---------------------------------------------------------------------------
+/*
+  See world.h. This is the game logic that used to live in
+  autoAgentMain.cpp's globals, tick for tick the same, less the
+  drawing and the printing. Step reports what happened to the box,
+  and leaves telling anyone about it to the caller.
+*/
+//---------------------------------------------------------------------------
+
+World::World()
+{
+  Reset();
+}
+
+
+
+// Puts everything back the way the simulator starts up:
+// the agent in the middle, no box, no wind or colour
+// shift, and no score
+void World::Reset(void)
+{
+  AgentX	   = 100.0;
+  Motion	   = STOP;
+  BoxX		   = 0.0;
+  BoxY		   = 0.0;
+  Color		   = BLUE;
+  BoxActive	   = false;
+  BoxAngle	   = 0.0;
+  Direction	   = BOX_LEFT;
+  WindFactor	   = 0.0;
+  ColorShiftFactor = 0.0;
+  NumBluesCaught   = 0;
+  NumBluesMissed   = 0;
+  NumRedsHitBy	   = 0;
+  NumRedsDodged	   = 0;
+}
+
+
+
+
+// Drops a box of the given colour from (x, y), unless there's
+// one falling already. Returns whether it was dropped.
+bool World::DropBox(BoxColor color, float x, float y)
+{
+  if (BoxActive)
+    {
+      return false;
+    }
+
+  Color	    = color;
+  BoxX	    = x;
+  BoxY	    = y;
+  BoxActive = true;
+
+  return true;
+}
+
+
+
+
+// Sets the world up for scenario: moves the agent, sets the
+// wind and colour shift, and drops the box, replacing any box
+// that's already falling
+void World::StartDrop(const DropScenario& scenario)
+{
+  AgentX	   = scenario.AgentX;
+  WindFactor	   = scenario.WindFactor;
+  ColorShiftFactor = scenario.ColorShiftFactor;
+  BoxActive	   = false;
+
+  DropBox(scenario.Color, scenario.BoxX, scenario.BoxY);
+}
+
+
+
+
+// Drop number drop of the random drops seeded with seed. The wind
+// is anything from -maxWind to maxWind, and the colour shift from
+// 0 to maxColorShift. Each drop is made from its own stretch of
+// the RANDOM_STREAM_DROPS stream, so any drop can be had on its
+// own, on any thread, and always comes out the same.
+DropScenario RandomDrop(unsigned long long seed, unsigned long long drop,
+			float maxWind, float maxColorShift)
+{
+  DropScenario scenario;
+  PhiloxRandom random(seed, RANDOM_STREAM_DROPS);
+
+  random.SetPosition(drop * DROP_RANDOM_VALUES);
+
+  scenario.AgentX	    = DROP_AGENT_MIN + (DROP_AGENT_MAX - DROP_AGENT_MIN) * random.NextDouble();
+  scenario.Color	    = (random.NextBelow(2) == 0) ? BLUE : RED;
+  scenario.BoxX		    = DROP_BOX_MIN_X + (DROP_BOX_MAX_X - DROP_BOX_MIN_X) * random.NextDouble();
+  scenario.BoxY		    = DROP_BOX_MIN_Y + (DROP_BOX_MAX_Y - DROP_BOX_MIN_Y) * random.NextDouble();
+  scenario.WindFactor	    = maxWind * (2 * random.NextDouble() - 1);
+  scenario.ColorShiftFactor = maxColorShift * random.NextDouble();
+
+  return scenario;
+}
+
+
+
+
+// Advances the world by one tick. The brain, a context for a
+// network with WORLD_INPUTS inputs, moves the agent. With no brain,
+// the agent moves by Motion instead, for manual control.
+WorldEvent World::Step(NeuralNetworkContextF* brain)
+{
+  WorldEvent event = WORLD_NO_EVENT;
+  float	     inputs[WORLD_INPUTS];
+  int	     i;
+
+  // In this mode, the keyboard controls
+  // the position of the "agent", no
+  // neural net is used
+  if (brain == NULL)
+    {
+      ManualMoveAgent();
+    }
+
+  // If there is a box, we need to animate it,
+  // and calculate the angle to it to feed
+  // into the neural network
+  if (BoxActive)
+    {
+      event = AnimateBox();
+      CalculateVectors();
+    }
+
+  // This is where the magic happens.
+  // Feed the inputs through the network,
+  // and move by its output.
+  if (brain != NULL)
+    {
+      GetInputs(inputs);
+
+      for (i = 0; i < WORLD_INPUTS; i++)
+	{
+	  brain->SetInput(i, inputs[i]);
+	}
+
+      brain->FeedForward();
+      MoveAgent(brain->GetOutput(0));
+    }
+
+  return event;
+}
+
+
+
+
+// This function moves the box downwards,
+// and checks for collision with the ground
+// and the agent itself. The score is changed
+// based on the collision detection.
+// It also will apply the "wind" to the box
+// to move it side to side.
+WorldEvent World::AnimateBox(void)
+{
+  WorldEvent event = WORLD_NO_EVENT;
+
+  // The box moves downwards at a constant rate
+  BoxY -= 1.0;
+
+  // The box will move side to side
+  // depending on the "wind"
+  BoxX += WindFactor;
+
+  // Keep the box on the screen.
+  if (BoxX < 3)
+    {
+      BoxX = 3;
+    }
+
+  if (BoxX > 197)
+    {
+      BoxX = 197;
+    }
+
+  // All of the collision detection code...
+  // It's at the collision height of the agent platform...
+  if (((BoxY-3) <= 8) && (BoxY > 0.0))
+    {
+      if ((fabs(BoxX - AgentX)) <= 11.0)
+	{
+	  switch (Color)
+	    {
+	    case BLUE:
+	      event = WORLD_BLUE_CAUGHT;
+	      NumBluesCaught++;
+	      break;
+
+	    case RED:
+	      event = WORLD_RED_HIT;
+	      NumRedsHitBy++;
+	      break;
+	    }
+
+	  BoxActive = false;
+	}
+    }
+
+  // Ok, the agent wasn't underneath the falling box,
+  // check for when it lands on the ground...
+  if (BoxY <= 0.0)
+    {
+      BoxY = 0.0;
+      switch (Color)
+	{
+	case BLUE:
+	  event = WORLD_BLUE_MISSED;
+	  NumBluesMissed++;
+	  break;
+
+	case RED:
+	  event = WORLD_RED_DODGED;
+	  NumRedsDodged++;
+	  break;
+	}
+
+      BoxActive = false;
+    }
+
+  return event;
+}
+
+
+
+
+// This simple function calculates
+// the angle to the box from the agent
+// using simple vector math.
+void World::CalculateVectors(void)
+{
+  CVec3 agent(AgentX, 0.0f, 0.0f);
+  CVec3 box(BoxX, BoxY, 0.0f);
+  CVec3 upVector(0.0f, 1.0f, 0.0f);
+  CVec3 toBoxVector;
+
+  // Create the vector from the agent
+  // to the box, and normalize it
+  toBoxVector = box - agent;
+  toBoxVector.Normalize();
+
+  // Find the angle
+  BoxAngle = acosf(upVector.Dot(toBoxVector));
+
+  // Convert it to degrees for easier reading
+  // in debug statements
+  BoxAngle *= RAD2DEG;
+
+  // Figure out if the box is to the left or right,
+  // since the angle is unsigned on it's own, and
+  // doesn't give an indication which direction
+  // the box is.
+  if (box.x <= agent.x)
+    {
+      Direction = BOX_LEFT;
+    }
+  else
+    {
+      Direction = BOX_RIGHT;
+    }
+}
+
+
+
+
+// Scales the state of the world into the WORLD_INPUTS
+// values the neural net takes, each from -1.0 to 1.0:
+// the agent's position, the box's colour, the angle to
+// the box, and whether there is a box at all
+void World::GetInputs(float* inputs) const
+{
+  float codedAngle;
+
+  // We should never see any angle
+  // greater than 92 degrees, so
+  // this is a safe divisor to make
+  // sure we never see a scaled angle
+  // greater than 1.0.
+  codedAngle = BoxAngle / 92.0;
+
+  // The angle itself doesn't tell us
+  // a direction to the box. If it's
+  // to the left, make the angle negative
+  if (Direction == BOX_LEFT)
+    {
+      codedAngle *= -1.0;
+    }
+
+  // -1 is all the way left, 0 is center,
+  // and 1.0 is all the way to the right
+  inputs[0] = (AgentX - 100.0f) / 92.0f;
+
+  // -1.0 is red, and 1.0 is blue, less
+  // however far the colours are shifted
+  if (Color == RED)
+    {
+      inputs[1] = -1.0 + ColorShiftFactor;
+    }
+  else
+    {
+      inputs[1] = 1.0 - ColorShiftFactor;
+    }
+
+  inputs[2] = codedAngle;
+
+  // 1.0 if there is a box falling,
+  // or -1.0 if there isn't
+  inputs[3] = BoxActive ? 1.0 : -1.0;
+}
+
+
+
+
+// This function takes the output
+// from the neural network, and
+// translates it into movement
+// of the agent
+void World::MoveAgent(float movementValue)
+{
+  const float movementFactor = 5.0;
+
+  // Convert this output to a negative value
+  // for left movement, and positive for
+  // right movement. 0.5 should be sitting still,
+  // and make the movements a bit bigger
+  AgentX += (movementValue - 0.5f) * movementFactor;
+
+  // Make sure the agent stays on the screen
+  if (AgentX < 8.0)
+    {
+      AgentX = 8.0;
+    }
+
+  if (AgentX > 192.0)
+    {
+      AgentX = 192.0;
+    }
+}
+
+
+
+
+// For controlling the agent with the
+// keyboard, for program testing. Moves
+// by Motion, and stops at the edges.
+void World::ManualMoveAgent(void)
+{
+  switch (Motion)
+    {
+    case LEFT:
+      AgentX -= 1.0;
+
+      if (AgentX < 8.0)
+	{
+	  Motion = STOP;
+	  AgentX = 8.0;
+	}
+      break;
+
+    case RIGHT:
+      AgentX += 1.0;
+
+      if (AgentX > 192.0)
+	{
+	  Motion = STOP;
+	  AgentX = 192.0;
+	}
+      break;
+
+    default:
+      return;
+    }
+}
+
+
+
+
+// What a scripted expert would output as the brain, for training
+// brains on: get under a blue box, and out from under a red one.
+// It sees the box's true colour, however shifted it looks. Under a
+// blue box it moves straight to it, slowing down to stop right
+// under it. A red box it runs from at full speed until it's
+// EXPERT_DODGE_DISTANCE away, heading the other way past the box
+// if there isn't room against the wall. With no box it sits still.
+float World::ExpertMovement(void) const
+{
+  const float movementFactor = 5.0;
+  float	      difference     = BoxX - AgentX;
+  float	      movement;
+  bool	      left;
+
+  if (!BoxActive)
+    {
+      return 0.5;
+    }
+
+  if (Color == BLUE)
+    {
+      // The output that moves the agent by difference,
+      // as far as one step can go
+      movement = 0.5f + difference / movementFactor;
+      movement = (movement < 0.0f) ? 0.0f : movement;
+      movement = (movement > 1.0f) ? 1.0f : movement;
+
+      return movement;
+    }
+
+  if (fabs(difference) >= EXPERT_DODGE_DISTANCE)
+    {
+      return 0.5;
+    }
+
+  // Away from the box, or towards the middle if
+  // it's right overhead, unless the wall's in the way
+  if (difference != 0)
+    left = (difference > 0);
+  else
+    left = (AgentX > 100.0f);
+
+  if (left && (BoxX - EXPERT_DODGE_DISTANCE < 8.0f))
+    left = false;
+  else if (!left && (BoxX + EXPERT_DODGE_DISTANCE > 192.0f))
+    left = true;
+
+  return left ? 0.0f : 1.0f;
+}
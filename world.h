@@ -0,0 +1,147 @@
+//---------------------------------------------------------------------------
+/*
+  The box catcher/dodger game, with no graphics and no clock. A World
+  holds everything the game is: where the agent and the box are, the
+  wind and colour shift, and the score. Step advances it by one tick
+  (one 15 ms frame in the windowed simulator), letting a brain move
+  the agent if it's given one. Nothing is global or static, so any
+  number of worlds can be stepped side by side, on any threads, as
+  fast as the CPU will go.
+
+  The screen is 200 x 150 units. The agent is a 16 unit wide sled
+  along the bottom, and the box is 6 units square.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "neuralNet.h"
+
+
+// For converting radians to degrees
+// My brain doesn't work in radians
+#define RAD2DEG 57.29578
+
+// The number of values GetInputs fills in,
+// the number of inputs a brain needs
+#define WORLD_INPUTS 4
+
+
+enum BoxColor
+  {
+    BLUE,
+    RED
+  };
+
+enum AgentMotion
+  {
+    LEFT,
+    RIGHT,
+    STOP
+  };
+
+enum BoxDirection
+  {
+    BOX_LEFT,
+    BOX_RIGHT
+  };
+
+
+// The ranges random drops are picked from. The agent starts
+// anywhere it can be, and the box anywhere on screen above the
+// height it could be caught at.
+#define DROP_AGENT_MIN	8.0f
+#define DROP_AGENT_MAX	192.0f
+#define DROP_BOX_MIN_X	3.0f
+#define DROP_BOX_MAX_X	197.0f
+#define DROP_BOX_MIN_Y	12.0f
+#define DROP_BOX_MAX_Y	150.0f
+
+// The scripted expert dodges a red box until it's at least
+// this far to one side, a bit more than the 11 it takes
+#define EXPERT_DODGE_DISTANCE 14.0f
+
+// The number of random values each drop has, enough for the
+// eleven it uses, so drops start at known stream positions
+#define DROP_RANDOM_VALUES 12
+
+
+// What happened to the box on a step, if anything
+enum WorldEvent
+  {
+    WORLD_NO_EVENT,
+    WORLD_BLUE_CAUGHT,
+    WORLD_BLUE_MISSED,
+    WORLD_RED_HIT,
+    WORLD_RED_DODGED
+  };
+
+
+// Everything that sets up one episode: where the agent starts, the
+// box's colour and where it's dropped from, and the wind and colour
+// shift it falls through
+struct DropScenario
+{
+  float		AgentX;
+  BoxColor	Color;
+  float		BoxX;
+  float		BoxY;
+  float		WindFactor;
+  float		ColorShiftFactor;
+};
+
+DropScenario RandomDrop(unsigned long long seed, unsigned long long drop,
+			float maxWind, float maxColorShift);
+
+
+class World
+{
+ public:
+  // The agent can only move left and right.
+  // Motion is only used for manual control.
+  float		AgentX;
+  AgentMotion	Motion;
+
+  // The box, if BoxActive
+  float		BoxX;
+  float		BoxY;
+  BoxColor	Color;
+  bool		BoxActive;
+
+  // Angle and direction to the box from the agent
+  float		BoxAngle;
+  BoxDirection	Direction;
+
+  // To confuse the brain with things it wasn't trained on.
+  // WindFactor blows the box sideways, from -1.5 to 1.5, and
+  // ColorShiftFactor mixes the box colours, from 0 (pure red
+  // or blue) to 1.0 (the same purple either way).
+  float		WindFactor;
+  float		ColorShiftFactor;
+
+  // The score
+  int		NumBluesCaught;
+  int		NumBluesMissed;
+  int		NumRedsHitBy;
+  int		NumRedsDodged;
+
+  World();
+
+  void		Reset(void);
+  bool		DropBox(BoxColor color, float x, float y);
+  void		StartDrop(const DropScenario& scenario);
+  WorldEvent	Step(NeuralNetworkContextF* brain);
+
+  // The parts of a Step, for running brains some other way
+  WorldEvent	AnimateBox(void);
+  void		CalculateVectors(void);
+  void		GetInputs(float* inputs) const;
+  void		MoveAgent(float movementValue);
+  void		ManualMoveAgent(void);
+
+  float		ExpertMovement(void) const;
+};
+
+
+#endif   // WORLD_H
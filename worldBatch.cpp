@@ -0,0 +1,467 @@
+#include "worldBatch.h"
+#include "math.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//---------------------------------------------------------------------------
+/*
+  See worldBatch.h. Step works through the worlds a stage at a time,
+  the same stages, in the same order and with the same float
+  arithmetic, as World::Step, so a world gives the same positions
+  and scores either way for the same brain outputs. Each stage
+  computes every world's new values and then keeps the old ones
+  where the stage doesn't apply, rather than branching per world.
+  With SSE2 (every x86-64) the stages take four worlds at a time,
+  and the scalar loops finish off the rest.
+*/
+//---------------------------------------------------------------------------
+
+WorldBatch::WorldBatch()
+{
+  NumberOfWorlds = 0;
+}
+
+
+
+// Sets up numWorlds worlds, each the way World starts
+void WorldBatch::Initialize(int numWorlds)
+{
+  CleanUp();
+
+  NumberOfWorlds = numWorlds;
+
+  AgentX.resize(numWorlds);
+  BoxX.resize(numWorlds);
+  BoxY.resize(numWorlds);
+  Color.resize(numWorlds);
+  BoxActive.resize(numWorlds);
+  BoxAngle.resize(numWorlds);
+  Direction.resize(numWorlds);
+  WindFactor.resize(numWorlds);
+  ColorShiftFactor.resize(numWorlds);
+
+  NumBluesCaught.resize(numWorlds);
+  NumBluesMissed.resize(numWorlds);
+  NumRedsHitBy.resize(numWorlds);
+  NumRedsDodged.resize(numWorlds);
+
+  Events.resize(numWorlds);
+  Inputs.resize((size_t) numWorlds * WORLD_INPUTS);
+
+  Reset();
+}
+
+
+
+void WorldBatch::CleanUp(void)
+{
+  NumberOfWorlds = 0;
+
+  AgentX.clear();
+  BoxX.clear();
+  BoxY.clear();
+  Color.clear();
+  BoxActive.clear();
+  BoxAngle.clear();
+  Direction.clear();
+  WindFactor.clear();
+  ColorShiftFactor.clear();
+
+  NumBluesCaught.clear();
+  NumBluesMissed.clear();
+  NumRedsHitBy.clear();
+  NumRedsDodged.clear();
+
+  Events.clear();
+  Inputs.clear();
+  Outputs.clear();
+  Scratch.clear();
+}
+
+
+
+
+// Puts every world back the way World::Reset does
+void WorldBatch::Reset(void)
+{
+  World start;
+  int	w;
+
+  for(w=0; w<NumberOfWorlds; w++)
+    {
+      SetWorld(w, start);
+      Events[w] = WORLD_NO_EVENT;
+    }
+}
+
+
+
+// Drops a box in one world, as World::DropBox does
+bool WorldBatch::DropBox(int world, BoxColor color, float x, float y)
+{
+  if(BoxActive[world])
+    {
+      return false;
+    }
+
+  Color[world]	   = color;
+  BoxX[world]	   = x;
+  BoxY[world]	   = y;
+  BoxActive[world] = true;
+
+  return true;
+}
+
+
+
+
+// Sets one world up for scenario, as World::StartDrop does
+void WorldBatch::StartDrop(int world, const DropScenario& scenario)
+{
+  AgentX[world]		  = scenario.AgentX;
+  WindFactor[world]	  = scenario.WindFactor;
+  ColorShiftFactor[world] = scenario.ColorShiftFactor;
+  BoxActive[world]	  = false;
+
+  DropBox(world, scenario.Color, scenario.BoxX, scenario.BoxY);
+}
+
+
+
+
+// The box falls, blows sideways, and is caught or lands
+// (World::AnimateBox), in worlds first to last-1 that have a
+// box falling. Returns how many boxes came down.
+static int AnimateBoxes(WorldBatch& b, int first, int last)
+{
+  int	w, active, caught, landed, blue;
+  int	ended = 0;
+  float x, y;
+
+  for(w=first; w<last; w++)
+    {
+      active = b.BoxActive[w];
+      blue   = (b.Color[w] == BLUE);
+
+      y = b.BoxY[w] - 1.0f;
+      x = b.BoxX[w] + b.WindFactor[w];
+      x = (x < 3) ? 3 : x;
+      x = (x > 197) ? 197 : x;
+
+      caught = active & ((y - 3.0f) <= 8.0f) & (y > 0.0f) & (fabsf(x - b.AgentX[w]) <= 11.0f);
+      landed = active & (y <= 0.0f);
+
+      b.BoxY[w]	     = active ? (landed ? 0.0f : y) : b.BoxY[w];
+      b.BoxX[w]	     = active ? x : b.BoxX[w];
+      b.BoxActive[w] = active & !(caught | landed);
+      b.Events[w]    = caught ? (blue ? WORLD_BLUE_CAUGHT : WORLD_RED_HIT) :
+		       landed ? (blue ? WORLD_BLUE_MISSED : WORLD_RED_DODGED) : WORLD_NO_EVENT;
+
+      b.NumBluesCaught[w] += caught & blue;
+      b.NumRedsHitBy[w]	  += caught & !blue;
+      b.NumBluesMissed[w] += landed & blue;
+      b.NumRedsDodged[w]  += landed & !blue;
+      ended		  += caught | landed;
+    }
+
+  return ended;
+}
+
+
+
+// The cosine of the angle to the box (World::CalculateVectors) for
+// worlds first to last-1, if they had a box falling at the start of
+// the step. Dotting the normalized vector to the box with straight
+// up leaves its y. The acosf is left to the caller.
+static void FindBoxes(WorldBatch& b, int first, int last)
+{
+  int	w, active;
+  float dx, y, magnitude;
+
+  for(w=first; w<last; w++)
+    {
+      dx	= b.BoxX[w] - b.AgentX[w];
+      y		= b.BoxY[w];
+      magnitude = dx*dx + y*y;
+      y		= (magnitude == 0) ? y : y * (1.0f / sqrtf(magnitude));
+      active	= b.BoxActive[w] | (b.Events[w] != WORLD_NO_EVENT);
+
+      b.BoxAngle[w]  = active ? y : b.BoxAngle[w];
+      b.Direction[w] = active ? ((b.BoxX[w] <= b.AgentX[w]) ? BOX_LEFT : BOX_RIGHT) : b.Direction[w];
+    }
+}
+
+
+
+// Moves agents first to last-1 by the brain's outputs, nOutputs
+// a world, as World::MoveAgent does
+static void MoveAgents(WorldBatch& b, int first, int last, int nOutputs)
+{
+  int	w;
+  float x;
+
+  for(w=first; w<last; w++)
+    {
+      x = b.AgentX[w] + (b.Outputs[(size_t) w * nOutputs] - 0.5f) * 5.0f;
+      x = (x < 8.0f) ? 8.0f : x;
+      x = (x > 192.0f) ? 192.0f : x;
+
+      b.AgentX[w] = x;
+    }
+}
+
+
+
+#ifdef __SSE2__
+
+// The same three stages, four worlds at a time, for as many whole
+// fours as there are. Masks stand in for the scalar versions' ?:
+// so every lane gets exactly the arithmetic its world would have
+// had on its own. Each returns how many worlds it did.
+
+// Lanes of a where mask is set, of b where it isn't
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i SelectInt(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+
+static int AnimateBoxesSse2(WorldBatch& b, int count, int* ended)
+{
+  int	  w;
+  __m128i active, blue, caught, landed, events, done;
+  __m128  x, y, activeF, caughtF, landedF;
+  __m128i zero	   = _mm_setzero_si128();
+  __m128  absolute = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+  for(w=0; w+4<=count; w+=4)
+    {
+      active  = _mm_cmpgt_epi32(_mm_loadu_si128((__m128i*) &b.BoxActive[w]), zero);
+      blue    = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i*) &b.Color[w]), _mm_set1_epi32(BLUE));
+      activeF = _mm_castsi128_ps(active);
+
+      y = _mm_sub_ps(_mm_loadu_ps(&b.BoxY[w]), _mm_set1_ps(1.0f));
+      x = _mm_add_ps(_mm_loadu_ps(&b.BoxX[w]), _mm_loadu_ps(&b.WindFactor[w]));
+      x = _mm_max_ps(x, _mm_set1_ps(3.0f));
+      x = _mm_min_ps(x, _mm_set1_ps(197.0f));
+
+      caughtF = _mm_and_ps(activeF, _mm_cmple_ps(_mm_sub_ps(y, _mm_set1_ps(3.0f)), _mm_set1_ps(8.0f)));
+      caughtF = _mm_and_ps(caughtF, _mm_cmpgt_ps(y, _mm_setzero_ps()));
+      caughtF = _mm_and_ps(caughtF, _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(x, _mm_loadu_ps(&b.AgentX[w])), absolute),
+						 _mm_set1_ps(11.0f)));
+      landedF = _mm_and_ps(activeF, _mm_cmple_ps(y, _mm_setzero_ps()));
+      caught  = _mm_castps_si128(caughtF);
+      landed  = _mm_castps_si128(landedF);
+      done    = _mm_or_si128(caught, landed);
+
+      y = Select(landedF, _mm_setzero_ps(), y);
+      _mm_storeu_ps(&b.BoxY[w], Select(activeF, y, _mm_loadu_ps(&b.BoxY[w])));
+      _mm_storeu_ps(&b.BoxX[w], Select(activeF, x, _mm_loadu_ps(&b.BoxX[w])));
+      _mm_storeu_si128((__m128i*) &b.BoxActive[w], _mm_and_si128(_mm_andnot_si128(done, active), _mm_set1_epi32(1)));
+
+      events = SelectInt(blue, _mm_set1_epi32(WORLD_BLUE_MISSED), _mm_set1_epi32(WORLD_RED_DODGED));
+      events = _mm_and_si128(landed, events);
+      events = SelectInt(caught, SelectInt(blue, _mm_set1_epi32(WORLD_BLUE_CAUGHT), _mm_set1_epi32(WORLD_RED_HIT)),
+			 events);
+      _mm_storeu_si128((__m128i*) &b.Events[w], events);
+
+      // The masks are all ones, -1, where they're set
+      _mm_storeu_si128((__m128i*) &b.NumBluesCaught[w],
+		       _mm_sub_epi32(_mm_loadu_si128((__m128i*) &b.NumBluesCaught[w]), _mm_and_si128(caught, blue)));
+      _mm_storeu_si128((__m128i*) &b.NumRedsHitBy[w],
+		       _mm_sub_epi32(_mm_loadu_si128((__m128i*) &b.NumRedsHitBy[w]), _mm_andnot_si128(blue, caught)));
+      _mm_storeu_si128((__m128i*) &b.NumBluesMissed[w],
+		       _mm_sub_epi32(_mm_loadu_si128((__m128i*) &b.NumBluesMissed[w]), _mm_and_si128(landed, blue)));
+      _mm_storeu_si128((__m128i*) &b.NumRedsDodged[w],
+		       _mm_sub_epi32(_mm_loadu_si128((__m128i*) &b.NumRedsDodged[w]), _mm_andnot_si128(blue, landed)));
+
+      *ended += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(done)));
+    }
+
+  return w;
+}
+
+
+static int FindBoxesSse2(WorldBatch& b, int count)
+{
+  int	  w;
+  __m128i active, left;
+  __m128  dx, y, agentX, boxX, magnitude, activeF;
+  __m128i zero = _mm_setzero_si128();
+
+  for(w=0; w+4<=count; w+=4)
+    {
+      agentX	= _mm_loadu_ps(&b.AgentX[w]);
+      boxX	= _mm_loadu_ps(&b.BoxX[w]);
+      dx	= _mm_sub_ps(boxX, agentX);
+      y		= _mm_loadu_ps(&b.BoxY[w]);
+      magnitude = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(y, y));
+      y		= Select(_mm_cmpeq_ps(magnitude, _mm_setzero_ps()), y,
+			 _mm_mul_ps(y, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(magnitude))));
+
+      active  = _mm_or_si128(_mm_cmpgt_epi32(_mm_loadu_si128((__m128i*) &b.BoxActive[w]), zero),
+			     _mm_xor_si128(_mm_cmpeq_epi32(_mm_loadu_si128((__m128i*) &b.Events[w]), zero),
+					   _mm_set1_epi32(-1)));
+      activeF = _mm_castsi128_ps(active);
+      left    = _mm_castps_si128(_mm_cmple_ps(boxX, agentX));
+
+      _mm_storeu_ps(&b.BoxAngle[w], Select(activeF, y, _mm_loadu_ps(&b.BoxAngle[w])));
+      _mm_storeu_si128((__m128i*) &b.Direction[w],
+		       SelectInt(active, SelectInt(left, _mm_set1_epi32(BOX_LEFT), _mm_set1_epi32(BOX_RIGHT)),
+				 _mm_loadu_si128((__m128i*) &b.Direction[w])));
+    }
+
+  return w;
+}
+
+
+// Only for brains with the one output
+static int MoveAgentsSse2(WorldBatch& b, int count)
+{
+  int	 w;
+  __m128 x;
+
+  for(w=0; w+4<=count; w+=4)
+    {
+      x = _mm_sub_ps(_mm_loadu_ps(&b.Outputs[w]), _mm_set1_ps(0.5f));
+      x = _mm_add_ps(_mm_loadu_ps(&b.AgentX[w]), _mm_mul_ps(x, _mm_set1_ps(5.0f)));
+      x = _mm_max_ps(x, _mm_set1_ps(8.0f));
+      x = _mm_min_ps(x, _mm_set1_ps(192.0f));
+
+      _mm_storeu_ps(&b.AgentX[w], x);
+    }
+
+  return w;
+}
+
+#endif   // __SSE2__
+
+
+
+
+// Advances every world by one tick with no brain, so the agents
+// stay where they are. Events says what happened in each world, and
+// the number of worlds whose box came down is returned.
+int WorldBatch::Step(void)
+{
+  int	w;
+  int	done	  = 0;
+  int	ended	  = 0;
+  int	numWorlds = NumberOfWorlds;
+  float angle;
+
+#ifdef __SSE2__
+  done = AnimateBoxesSse2(*this, numWorlds, &ended);
+#endif
+  ended += AnimateBoxes(*this, done, numWorlds);
+
+#ifdef __SSE2__
+  done = FindBoxesSse2(*this, numWorlds);
+#endif
+  FindBoxes(*this, done, numWorlds);
+
+  // acosf is a library call, so it gets a pass of its own
+  for(w=0; w<numWorlds; w++)
+    {
+      if(BoxActive[w] | (Events[w] != WORLD_NO_EVENT))
+	{
+	  angle	      = acosf(BoxAngle[w]);
+	  BoxAngle[w] = angle * RAD2DEG;
+	}
+    }
+
+  return ended;
+}
+
+
+
+// Advances every world by one tick, as Step(void) does, and then
+// has brain (a network with WORLD_INPUTS inputs) move every agent.
+// The brain is only read.
+int WorldBatch::Step(const NeuralNetworkF& brain)
+{
+  int	 w, done, nOutputs;
+  int	 ended	   = Step();
+  int	 numWorlds = NumberOfWorlds;
+  float	 angle;
+  float* inputs;
+
+  // Every world's inputs, as World::GetInputs
+  // scales them, one row of the input matrix each
+  for(w=0; w<numWorlds; w++)
+    {
+      inputs = &Inputs[(size_t) w * WORLD_INPUTS];
+
+      angle = BoxAngle[w] / 92.0f;
+
+      inputs[0] = (AgentX[w] - 100.0f) / 92.0f;
+      inputs[1] = (Color[w] == RED) ? -1.0f + ColorShiftFactor[w] : 1.0f - ColorShiftFactor[w];
+      inputs[2] = (Direction[w] == BOX_LEFT) ? -angle : angle;
+      inputs[3] = BoxActive[w] ? 1.0f : -1.0f;
+    }
+
+  // One forward pass for the lot
+  nOutputs = brain.Layers[brain.NumberOfLayers-1].NumberOfNodes;
+  Outputs.resize((size_t) numWorlds * nOutputs);
+  Scratch.resize(brain.TileScratchSize);
+  brain.FeedForwardBatch(&Inputs[0], numWorlds, &Outputs[0], &Scratch[0]);
+
+  // And move each agent by its output
+  done = 0;
+#ifdef __SSE2__
+  if(nOutputs == 1)
+    {
+      done = MoveAgentsSse2(*this, numWorlds);
+    }
+#endif
+  MoveAgents(*this, done, numWorlds, nOutputs);
+
+  return ended;
+}
+
+
+
+void WorldBatch::GetWorld(int world, World& copy) const
+{
+  copy.AgentX		= AgentX[world];
+  copy.Motion		= STOP;
+  copy.BoxX		= BoxX[world];
+  copy.BoxY		= BoxY[world];
+  copy.Color		= (BoxColor) Color[world];
+  copy.BoxActive	= BoxActive[world];
+  copy.BoxAngle		= BoxAngle[world];
+  copy.Direction	= (BoxDirection) Direction[world];
+  copy.WindFactor	= WindFactor[world];
+  copy.ColorShiftFactor = ColorShiftFactor[world];
+  copy.NumBluesCaught	= NumBluesCaught[world];
+  copy.NumBluesMissed	= NumBluesMissed[world];
+  copy.NumRedsHitBy	= NumRedsHitBy[world];
+  copy.NumRedsDodged	= NumRedsDodged[world];
+}
+
+
+
+// Sets one world from a World
+void WorldBatch::SetWorld(int world, const World& copy)
+{
+  AgentX[world]		  = copy.AgentX;
+  BoxX[world]		  = copy.BoxX;
+  BoxY[world]		  = copy.BoxY;
+  Color[world]		  = copy.Color;
+  BoxActive[world]	  = copy.BoxActive;
+  BoxAngle[world]	  = copy.BoxAngle;
+  Direction[world]	  = copy.Direction;
+  WindFactor[world]	  = copy.WindFactor;
+  ColorShiftFactor[world] = copy.ColorShiftFactor;
+  NumBluesCaught[world]	  = copy.NumBluesCaught;
+  NumBluesMissed[world]	  = copy.NumBluesMissed;
+  NumRedsHitBy[world]	  = copy.NumRedsHitBy;
+  NumRedsDodged[world]	  = copy.NumRedsDodged;
+}
@@ -0,0 +1,78 @@
+//---------------------------------------------------------------------------
+/*
+  Thousands of Worlds stepped in lockstep. Each field of a World is
+  an array here, with one entry per world (struct of arrays), so
+  every part of a step is one branch-free pass over contiguous
+  floats that the compiler can vectorize. All the worlds' inputs are
+  gathered into one matrix and run through the brain with a single
+  FeedForwardBatch, instead of one FeedForward per agent.
+
+  A step does exactly what World::Step does to every world, one
+  world's inputs never touch another's, and a world with no box
+  still runs its brain, as the simulator's agent does. Each batch
+  has its own tile scratch for the forward pass and only reads the
+  brain, so one brain can step any number of batches at once, on
+  any threads.
+*/
+//---------------------------------------------------------------------------
+
+#ifndef WORLDBATCH_H
+#define WORLDBATCH_H
+
+#include <vector>
+using namespace std;
+
+#include "neuralNet.h"
+#include "world.h"
+
+
+class WorldBatch
+{
+ public:
+  int		NumberOfWorlds;
+
+  // World's fields, one entry per world. Color,
+  // BoxActive and Direction hold the enum or bool
+  // as an int, the width of the floats beside them.
+  vector<float>	AgentX;
+  vector<float>	BoxX;
+  vector<float>	BoxY;
+  vector<int>	Color;
+  vector<int>	BoxActive;
+  vector<float>	BoxAngle;
+  vector<int>	Direction;
+  vector<float>	WindFactor;
+  vector<float>	ColorShiftFactor;
+
+  vector<int>	NumBluesCaught;
+  vector<int>	NumBluesMissed;
+  vector<int>	NumRedsHitBy;
+  vector<int>	NumRedsDodged;
+
+  // What happened in each world on the last Step
+  vector<int>	Events;
+
+  // The last Step's brain inputs, WORLD_INPUTS
+  // a world, and its outputs, one row a world
+  vector<float>	Inputs;
+  vector<float>	Outputs;
+
+  // The forward pass's tile buffer (see
+  // NeuralNetworkT::FeedForwardBatch)
+  vector<float>	Scratch;
+
+  WorldBatch();
+
+  void	Initialize(int numWorlds);
+  void	CleanUp(void);
+  void	Reset(void);
+  bool	DropBox(int world, BoxColor color, float x, float y);
+  void	StartDrop(int world, const DropScenario& scenario);
+  int	Step(void);
+  int	Step(const NeuralNetworkF& brain);
+  void	GetWorld(int world, World& copy) const;
+  void	SetWorld(int world, const World& copy);
+};
+
+
+#endif   // WORLDBATCH_H
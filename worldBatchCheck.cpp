@@ -0,0 +1,156 @@
+/*******************************************************************
+World batch check
+
+Checks WorldBatch steps its worlds exactly as World does. A batch of
+1001 worlds, not a multiple of four so the scalar loops finish off
+what the SSE2 ones leave, plays random drops with the simulator's
+brain for 5000 steps, and 1001 separate Worlds play the same drops
+side by side, each with a context of its own. After every step each
+world in the batch has to match its World field for field, bit for
+bit, and have had the same event. The same goes for a few hundred
+steps with no brain at all. Prints what went wrong and exits with 1
+if anything did.
+*******************************************************************/
+
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "neuralNet.h"
+#include "world.h"
+#include "worldBatch.h"
+
+
+
+
+#define CHECK_WORLDS	     1001
+#define CHECK_STEPS	     5000
+#define CHECK_NO_BRAIN_STEPS 500
+
+// The brain the simulator plays with
+#define CHECK_BRAIN "./brains/neuralNetwork.brain"
+
+// Stop listing differences after this many
+#define MAX_REPORTED 10
+
+
+int failures = 0;
+
+
+
+
+// Compares two floats bit for bit
+bool same(float a, float b)
+{
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+
+
+
+// Checks world w of the batch against world, after step number step
+void compare(WorldBatch& batch, int w, const World& world, WorldEvent event, int step)
+{
+  World copy;
+
+  batch.GetWorld(w, copy);
+
+  if (!same(copy.AgentX, world.AgentX) || !same(copy.BoxX, world.BoxX) ||
+      !same(copy.BoxY, world.BoxY) || !same(copy.BoxAngle, world.BoxAngle) ||
+      !same(copy.WindFactor, world.WindFactor) ||
+      !same(copy.ColorShiftFactor, world.ColorShiftFactor) ||
+      (copy.Color != world.Color) || (copy.BoxActive != world.BoxActive) ||
+      (copy.Direction != world.Direction) ||
+      (copy.NumBluesCaught != world.NumBluesCaught) || (copy.NumBluesMissed != world.NumBluesMissed) ||
+      (copy.NumRedsHitBy != world.NumRedsHitBy) || (copy.NumRedsDodged != world.NumRedsDodged) ||
+      (batch.Events[w] != event))
+    {
+      failures++;
+
+      if (failures <= MAX_REPORTED)
+	{
+	  cout<<"Error, world "<<w<<" differs from its World after step "<<step<<endl;
+	}
+    }
+}
+
+
+
+
+// Starts the next drop in world w of the batch and in world
+void startDrop(WorldBatch& batch, int w, World& world, unsigned long long& drop)
+{
+  DropScenario scenario = RandomDrop(1, drop++, 1.5f, 1.0f);
+
+  batch.StartDrop(w, scenario);
+  world.StartDrop(scenario);
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+  NeuralNetworkF	brain;
+  NeuralNetworkContextF context;
+  WorldBatch		batch;
+  vector<World>		worlds(CHECK_WORLDS);
+  WorldEvent		event;
+  unsigned long long	drop = 0;
+  int			w, step;
+
+  brain.ReadData(CHECK_BRAIN);
+  context.Initialize(brain);
+  batch.Initialize(CHECK_WORLDS);
+
+  for (w = 0; w < CHECK_WORLDS; w++)
+    startDrop(batch, w, worlds[w], drop);
+
+  // With the brain, a new drop as soon as a box comes down
+  for (step = 0; step < CHECK_STEPS; step++)
+    {
+      batch.Step(brain);
+
+      for (w = 0; w < CHECK_WORLDS; w++)
+	{
+	  event = worlds[w].Step(&context);
+	  compare(batch, w, worlds[w], event, step);
+
+	  if (event != WORLD_NO_EVENT)
+	    startDrop(batch, w, worlds[w], drop);
+	}
+    }
+
+  // And without, the agents staying put
+  for (step = 0; step < CHECK_NO_BRAIN_STEPS; step++)
+    {
+      batch.Step();
+
+      for (w = 0; w < CHECK_WORLDS; w++)
+	{
+	  event = worlds[w].Step(NULL);
+	  compare(batch, w, worlds[w], event, CHECK_STEPS + step);
+
+	  if (event != WORLD_NO_EVENT)
+	    startDrop(batch, w, worlds[w], drop);
+	}
+    }
+
+  batch.CleanUp();
+  context.CleanUp();
+  brain.CleanUp();
+
+  if (failures > 0)
+    {
+      cout<<failures<<" world batch checks failed"<<endl;
+      exit(1);
+    }
+
+  cout<<"World batch checks passed, "<<drop<<" drops played"<<endl;
+  return 0;
+}